@@ -0,0 +1,196 @@
+#include "./bcache.h"
+#include "./fs.h"
+
+/**
+ * Allocates an empty cache of size blocs
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (out of memory)
+ */
+int bcache_init(struct bcache *c, size_t size) {
+	memset(c, 0, sizeof(struct bcache));
+
+	if (size == 0)
+		size = 1;
+
+	c->entries = (struct bcache_entry *) calloc(size, sizeof(struct bcache_entry));
+	if (c->entries == NULL) return EXIT_FAILURE;
+
+	c->size = size;
+	idmap_init(&c->ids);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Releases the memory of the cache, dirty blocs are lost (see bcache_flush)
+ */
+void bcache_free(struct bcache *c) {
+	free(c->entries);
+	idmap_free(&c->ids);
+	memset(c, 0, sizeof(struct bcache));
+}
+
+/*
+ * Forgets every bloc, dirty blocs are lost (see bcache_flush)
+ */
+void bcache_invalidate(struct bcache *c) {
+	if (c->entries != NULL)
+		memset(c->entries, 0, c->size * sizeof(struct bcache_entry));
+
+	idmap_clear(&c->ids);
+	c->hand = 0;
+}
+
+/**
+ * Looks up a bloc by its id
+ *
+ * on success : returns the cached bloc, valid until the next insertion
+ * on failure : returns NULL (not cached)
+ */
+struct bloc *bcache_lookup(struct bcache *c, unsigned int id) {
+	long z;
+
+	if (c->entries == NULL || !idmap_get(&c->ids, id, &z)) {
+		c->misses++;
+		return NULL;
+	}
+
+	c->hits++;
+	c->entries[z].referenced = 1;
+
+	return &c->entries[z].bloc;
+}
+
+/*
+ * Writes a dirty entry back to the disk
+ */
+static int write_back(struct fs *fs, struct bcache_entry *e) {
+	if (!e->dirty) return EXIT_SUCCESS;
+
+	bloc_seal(&e->bloc);
+	if (disk_write(fs, e->offset, &e->bloc, sizeof(struct bloc)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	e->dirty = 0;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Chooses the entry to reuse: an empty one, or the first one not
+ * referenced since the last sweep of the hand
+ * A dirty entry that can't be written back is kept, the hand moves on.
+ *
+ * on failure : returns NULL (no entry could be written back)
+ */
+static struct bcache_entry *victim(struct fs *fs) {
+	struct bcache *c;
+	struct bcache_entry *e;
+	size_t z;
+
+	c = &fs->bcache;
+	for (z = 0; z != 2 * c->size; z++) {
+		e = &c->entries[c->hand];
+		c->hand = (c->hand + 1) % c->size;
+
+		if (e->id == DELETED) return e;
+
+		if (e->referenced) {
+			e->referenced = 0;
+			continue;
+		}
+
+		if (write_back(fs, e) != EXIT_SUCCESS) continue;
+		idmap_remove(&c->ids, e->id);
+		e->id = DELETED;
+
+		return e;
+	}
+
+	return NULL;
+}
+
+/**
+ * Caches a bloc read or written at offset, evicts another one if needed
+ * (written back first if dirty)
+ *
+ * on success : returns the cached bloc
+ * on failure : returns NULL (no cache, no entry could be written back):
+ * a dirty bloc must be written by the caller then
+ */
+struct bloc *bcache_insert(struct fs *fs, long offset, const struct bloc *b, int dirty) {
+	struct bcache *c;
+	struct bcache_entry *e;
+	long z;
+
+	c = &fs->bcache;
+	if (c->entries == NULL || b->id == DELETED) return NULL;
+
+	if (idmap_get(&c->ids, b->id, &z)) {
+		e = &c->entries[z];
+	} else {
+		e = victim(fs);
+		if (e == NULL) return NULL;
+		idmap_put(&c->ids, b->id, e - c->entries);
+	}
+
+	e->id = b->id;
+	e->offset = offset;
+	e->dirty = e->dirty || dirty;
+	e->referenced = 1;
+	e->bloc = *b;
+
+	return &e->bloc;
+}
+
+/**
+ * Updates a cached bloc, it's written back later
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (not cached)
+ */
+int bcache_update(struct bcache *c, struct bloc *b) {
+	long z;
+
+	if (c->entries == NULL || !idmap_get(&c->ids, b->id, &z)) return EXIT_FAILURE;
+
+	c->entries[z].bloc = *b;
+	c->entries[z].dirty = 1;
+	c->entries[z].referenced = 1;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Forgets a bloc without writing it back (the bloc got deleted)
+ */
+void bcache_drop(struct bcache *c, unsigned int id) {
+	long z;
+
+	if (c->entries == NULL || !idmap_get(&c->ids, id, &z)) return;
+
+	c->entries[z].id = DELETED;
+	c->entries[z].dirty = 0;
+	idmap_remove(&c->ids, id);
+}
+
+/**
+ * Writes every dirty bloc back to the disk
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int bcache_flush(struct fs *fs) {
+	struct bcache *c;
+	size_t z;
+	int rst;
+
+	c = &fs->bcache;
+	rst = EXIT_SUCCESS;
+	for (z = 0; z < c->size; z++) {
+		if (c->entries[z].id != DELETED && write_back(fs, &c->entries[z]) != EXIT_SUCCESS)
+			rst = EXIT_FAILURE;
+	}
+
+	return rst;
+}
@@ -0,0 +1,50 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "./bloc.h"
+#include "./idmap.h"
+
+#define DEFAULT_BCACHE_SIZE (64)
+
+/*
+ * A cached bloc
+ * offset is where the bloc is written back when it's dirty
+ */
+struct bcache_entry {
+	unsigned int id;
+	long offset;
+	int dirty;
+	int referenced;
+	struct bloc bloc;
+};
+
+/*
+ * Bounded cache of the blocs of a mounted disk (CLOCK eviction)
+ *
+ * Updates stay in the cache (dirty) until the bloc is evicted or the
+ * cache is flushed (bcache_flush, unmount_disk, refresh_disk).
+ */
+struct bcache {
+	struct bcache_entry *entries;
+	size_t size;
+	size_t hand;
+	struct idmap ids;
+
+	unsigned long hits;
+	unsigned long misses;
+};
+
+struct fs;
+
+int bcache_flush(struct fs *fs);
+int bcache_init(struct bcache *c, size_t size);
+int bcache_update(struct bcache *c, struct bloc *b);
+struct bloc *bcache_insert(struct fs *fs, long offset, const struct bloc *b, int dirty);
+struct bloc *bcache_lookup(struct bcache *c, unsigned int id);
+void bcache_drop(struct bcache *c, unsigned int id);
+void bcache_free(struct bcache *c);
+void bcache_invalidate(struct bcache *c);
+
+#endif
@@ -0,0 +1,165 @@
+#include "fileio/fileio.h"
+#include <stddef.h>
+#include "fs/fs.h"
+
+#define BENCH_DISK "rsc/bench_disk"
+#define BENCH_FILES (200)
+#define BENCH_APPENDS (8)
+
+/*
+ * Throughput of each durability (see durability.c): every file is created,
+ * then appended to a line at a time
+ */
+
+/*
+ * Seconds of a monotonic clock
+ */
+static double now_s() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int bench_durability(const char *options) {
+	struct fs fs;
+	struct inode root;
+	struct file f;
+	char name[32];
+	char line[64];
+	double start, elapsed;
+	unsigned long syncs;
+	size_t bytes;
+	int z, k;
+
+	setenv(MOUNT_OPTIONS_ENV, options, 1);
+	if (format_disk(BENCH_DISK, DEFAULT_INODE_COUNT, DEFAULT_BLOC_COUNT) != EXIT_SUCCESS
+			|| mount_disk(&fs, BENCH_DISK) != EXIT_SUCCESS) {
+		unsetenv(MOUNT_OPTIONS_ENV);
+		perror("bench_durability() failed");
+		return EXIT_FAILURE;
+	}
+	unsetenv(MOUNT_OPTIONS_ENV);
+	root = create_root(&fs);
+
+	memset(line, 'x', sizeof(line) - 1);
+	line[sizeof(line) - 1] = '\n';
+
+	bytes = 0;
+	start = now_s();
+	for (z = 0; z != BENCH_FILES; z++) {
+		sprintf(name, "file%d", z);
+		f = create_regularfile(&fs, &root, name, "", O_RDWR | O_APPEND);
+		for (k = 0; k != BENCH_APPENDS; k++) {
+			iwrite(&fs, &f, line, sizeof(line));
+			bytes += sizeof(line);
+		}
+	}
+	flush_disk(&fs);
+	elapsed = now_s() - start;
+
+	syncs = fs.durability.syncs + fs.journal.syncs;
+	printf("%-9s %9.0f calls/s %8.2f MB/s %7lu syncs\n", durability_name(fs.durability.mode),
+			BENCH_FILES * (1 + BENCH_APPENDS) / elapsed, bytes / elapsed / (1 << 20), syncs);
+
+	unmount_disk(&fs);
+	remove(BENCH_DISK);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Cost of the checksum of a bloc with each CRC32C kernel (see crc32c.c),
+ * against the cost of a read of a bloc (from the page cache: the cheapest
+ * read there is)
+ */
+#define BENCH_CHECKSUM_BLOCS (4096)
+#define BENCH_CHECKSUM_ROUNDS (16)
+
+static volatile unsigned int bench_sink;
+
+static double bench_kernel(const char *name, unsigned int (*kernel)(unsigned int, const void *, size_t),
+		struct bloc *blocs, double read_ns) {
+	double start, ns;
+	unsigned int crc;
+	int z, r;
+
+	crc = 0;
+	start = now_s();
+	for (r = 0; r != BENCH_CHECKSUM_ROUNDS; r++) {
+		for (z = 0; z != BENCH_CHECKSUM_BLOCS; z++)
+			crc ^= kernel(0, &blocs[z].length, offsetof(struct bloc, checksum) - offsetof(struct bloc, length));
+	}
+	ns = (now_s() - start) * 1e9 / (BENCH_CHECKSUM_ROUNDS * BENCH_CHECKSUM_BLOCS);
+	bench_sink = crc;
+
+	printf("%-13s %8.1f ns/bloc %8.0f MB/s %6.1f%% of a read\n", name, ns,
+			sizeof(struct bloc) / ns * 1e9 / (1 << 20), ns * 100 / read_ns);
+
+	return ns;
+}
+
+int bench_checksum() {
+	struct bloc *blocs;
+	double start, read_ns, soft_ns;
+	int fd, z, r;
+
+	blocs = (struct bloc *) malloc(BENCH_CHECKSUM_BLOCS * sizeof(struct bloc));
+	fd = open(BENCH_DISK, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (blocs == NULL || fd < 0) {
+		free(blocs);
+		perror("bench_checksum() failed");
+		return EXIT_FAILURE;
+	}
+
+	srand(1);
+	for (z = 0; z != BENCH_CHECKSUM_BLOCS; z++) {
+		blocs[z].id = z + 1;
+		blocs[z].length = BLOC_SIZE;
+		for (r = 0; r != BLOC_SIZE; r++)
+			blocs[z].content[r] = (char) rand();
+		bloc_seal(&blocs[z]);
+	}
+	if (pwrite(fd, blocs, BENCH_CHECKSUM_BLOCS * sizeof(struct bloc), 0)
+			!= (ssize_t) (BENCH_CHECKSUM_BLOCS * sizeof(struct bloc)))
+		perror("bench_checksum() failed");
+
+	/* a bloc a read, as a cache miss does */
+	start = now_s();
+	for (r = 0; r != BENCH_CHECKSUM_ROUNDS; r++) {
+		for (z = 0; z != BENCH_CHECKSUM_BLOCS; z++) {
+			if (pread(fd, &blocs[z], sizeof(struct bloc), (off_t) z * sizeof(struct bloc)) != sizeof(struct bloc))
+				break;
+		}
+	}
+	read_ns = (now_s() - start) * 1e9 / (BENCH_CHECKSUM_ROUNDS * BENCH_CHECKSUM_BLOCS);
+	printf("%-13s %8.1f ns/bloc\n", "pread", read_ns);
+
+	bench_kernel("bytewise", crc32c_bytewise, blocs, read_ns);
+	soft_ns = bench_kernel("slicing-by-8", crc32c_slicing, blocs, read_ns) / DEFAULT_VERIFY_EVERY_SOFT;
+	/* without SSE4.2 one bloc read in DEFAULT_VERIFY_EVERY_SOFT is checked */
+	printf("%-13s %8.1f ns/read %26.1f%% of a read\n", "sampled", soft_ns, soft_ns * 100 / read_ns);
+	if (crc32c_has_hw())
+		bench_kernel("sse4.2", crc32c_hw, blocs, read_ns);
+
+	close(fd);
+	remove(BENCH_DISK);
+	free(blocs);
+
+	return EXIT_SUCCESS;
+}
+
+int main() {
+
+	strcpy(g_username, "Paul");
+
+	bench_durability("durability=none");
+	bench_durability("");
+	bench_durability("durability=periodic,flush_interval=10");
+	bench_durability("durability=sync");
+
+	bench_checksum();
+
+	return EXIT_SUCCESS;
+}
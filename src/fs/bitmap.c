@@ -0,0 +1,283 @@
+#include "./bitmap.h"
+#include "./fs.h"
+
+/*
+ * Number of words to store a bitmap of bits
+ */
+unsigned int bitmap_words(unsigned int bits) {
+	return (bits + BITMAP_WORD_BITS - 1) / BITMAP_WORD_BITS;
+}
+
+/*
+ * The bitmap (in memory and on the disk) and its next-fit hint (a word
+ * index) for the inodes or the blocs
+ */
+static bitmap_word *bitmap_of(struct fs *fs, int flag, long *offset, unsigned int *words, unsigned int **hint) {
+	if (flag == INODE_FLAG) {
+		*offset = fs->sb.inode_bitmap;
+		*words = bitmap_words(fs->sb.inode_count);
+		*hint = &fs->sb.inode_hint;
+		return fs->inode_bitmap;
+	}
+
+	*offset = fs->sb.bloc_bitmap;
+	*words = bitmap_words(fs->sb.bloc_count);
+	*hint = &fs->sb.bloc_hint;
+	return fs->bloc_bitmap;
+}
+
+/**
+ * Writes an empty bitmap of bits
+ * The padding bits of the last word are set so they're never allocated
+ */
+int init_bitmap(int fd, long offset, unsigned int bits) {
+	bitmap_word w;
+	unsigned int words;
+
+	words = bitmap_words(bits);
+	if (bits % BITMAP_WORD_BITS == 0) return EXIT_SUCCESS;
+
+	w = ~0ULL << (bits % BITMAP_WORD_BITS);
+	if (pwrite(fd, &w, sizeof(bitmap_word), offset + (long) (words - 1) * sizeof(bitmap_word)) != sizeof(bitmap_word))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Marks count slots from slot as used or free, the words touched are
+ * written with one write
+ * The words change in memory once they're written, a failed write leaves
+ * the bitmap as it was. The hint and the highs change in the superblock
+ * in memory only, it's written at the commit or the flush (see
+ * write_superblock).
+ */
+static int mark_slots(struct fs *fs, int flag, unsigned int slot, unsigned int count, int used) {
+	bitmap_word *bitmap, *changed;
+	long offset;
+	unsigned int words, *hint;
+	unsigned int z, first, last;
+
+	bitmap = bitmap_of(fs, flag, &offset, &words, &hint);
+	first = slot / BITMAP_WORD_BITS;
+	last = (slot + count - 1) / BITMAP_WORD_BITS;
+	if (count == 0 || last >= words) return EXIT_FAILURE;
+
+	changed = (bitmap_word *) malloc((last - first + 1) * sizeof(bitmap_word));
+	if (changed == NULL) return EXIT_FAILURE;
+
+	memcpy(changed, &bitmap[first], (last - first + 1) * sizeof(bitmap_word));
+	for (z = slot; z != slot + count; z++) {
+		if (used)
+			changed[z / BITMAP_WORD_BITS - first] |= 1ULL << (z % BITMAP_WORD_BITS);
+		else
+			changed[z / BITMAP_WORD_BITS - first] &= ~(1ULL << (z % BITMAP_WORD_BITS));
+	}
+	if (disk_write(fs, offset + (long) first * sizeof(bitmap_word), changed, (last - first + 1) * sizeof(bitmap_word)) != EXIT_SUCCESS) {
+		free(changed);
+		return EXIT_FAILURE;
+	}
+	memcpy(&bitmap[first], changed, (last - first + 1) * sizeof(bitmap_word));
+	free(changed);
+
+	if (used) {
+		*hint = first;
+		if (flag == INODE_FLAG && slot + count > fs->sb.inode_high)
+			fs->sb.inode_high = slot + count;
+		if (flag == BLOC_FLAG && slot + count > fs->sb.bloc_high)
+			fs->sb.bloc_high = slot + count;
+	} else if (first < *hint) {
+		/* the hint moves back so low slots are reused first */
+		*hint = first;
+	}
+	fs->sb_dirty = 1;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Finds the first free slot, the words are scanned from the hint so it
+ * looks at one word in the common case
+ *
+ * success : 1
+ * failure : 0 (no slot left)
+ */
+static int first_free(struct fs *fs, int flag, unsigned int *slot) {
+	bitmap_word *bitmap;
+	long offset;
+	unsigned int words, *hint;
+	unsigned int z, word;
+
+	bitmap = bitmap_of(fs, flag, &offset, &words, &hint);
+	if (*hint >= words)
+		*hint = 0;
+
+	for (z = 0; z != words; z++) {
+		word = (*hint + z) % words;
+		if (bitmap[word] == ~0ULL) continue;
+
+		*slot = word * BITMAP_WORD_BITS + __builtin_ctzll(~bitmap[word]);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Allocates a free slot of the inode table (INODE_FLAG) or of the
+ * bloc region (BLOC_FLAG)
+ * The bitmap word is written, the superblock at the commit or the flush.
+ *
+ * on success : returns EXIT_SUCCESS and stores the slot
+ * on failure : returns EXIT_FAILURE (no slot left)
+ */
+int alloc_slot(struct fs *fs, int flag, unsigned int *slot) {
+	unsigned int got;
+
+	return alloc_run(fs, flag, NO_GOAL, 1, slot, &got);
+}
+
+/**
+ * Allocates a run of up to want contiguous free slots. The run starts at
+ * the goal slot when it's free (a file grows in place), else at the
+ * first free slot, and stops at the first slot in use.
+ *
+ * on success : returns EXIT_SUCCESS, stores the first slot and the length
+ * of the run (at least 1)
+ * on failure : returns EXIT_FAILURE (no slot left)
+ */
+int alloc_run(struct fs *fs, int flag, unsigned int goal, unsigned int want, unsigned int *slot, unsigned int *got) {
+	long offset;
+	unsigned int words, *hint;
+
+	bitmap_of(fs, flag, &offset, &words, &hint);
+
+	if (goal / BITMAP_WORD_BITS < words && !slot_in_use(fs, flag, goal))
+		*slot = goal;
+	else if (!first_free(fs, flag, slot))
+		return EXIT_FAILURE;
+
+	/* the padding bits of the last word are in use, the run stops there */
+	for (*got = 1; *got < want && (*slot + *got) / BITMAP_WORD_BITS < words
+			&& !slot_in_use(fs, flag, *slot + *got); (*got)++);
+
+	return mark_slots(fs, flag, *slot, *got, 1);
+}
+
+/**
+ * Marks a slot as free
+ */
+int free_slot(struct fs *fs, int flag, unsigned int slot) {
+	return free_run(fs, flag, slot, 1);
+}
+
+/**
+ * Marks count slots from slot as free
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (out of the bitmap)
+ */
+int free_run(struct fs *fs, int flag, unsigned int slot, unsigned int count) {
+	return mark_slots(fs, flag, slot, count, 0);
+}
+
+/**
+ * Checks if a slot is allocated
+ *
+ * success : 1
+ * failure : 0
+ */
+int slot_in_use(struct fs *fs, int flag, unsigned int slot) {
+	bitmap_word *bitmap;
+	long offset;
+	unsigned int words, *hint;
+
+	bitmap = bitmap_of(fs, flag, &offset, &words, &hint);
+	if (slot / BITMAP_WORD_BITS >= words) return 0;
+
+	return (bitmap[slot / BITMAP_WORD_BITS] >> (slot % BITMAP_WORD_BITS)) & 1;
+}
+
+/**
+ * Finds the lowest run of want free slots which starts below limit
+ * The slots are not allocated (see alloc_run with the slot as the goal).
+ *
+ * success : 1, the first slot of the run is stored
+ * failure : 0 (no such run)
+ */
+int lowest_free_run(struct fs *fs, int flag, unsigned int want, unsigned int limit, unsigned int *slot) {
+	bitmap_word *bitmap;
+	long offset;
+	unsigned int words, *hint;
+	unsigned int z, run;
+
+	bitmap = bitmap_of(fs, flag, &offset, &words, &hint);
+	if (want == 0) return 0;
+
+	run = 0;
+	for (z = 0; z < words * BITMAP_WORD_BITS && z - run < limit; z++) {
+		/* a word in use skips at once */
+		if (z % BITMAP_WORD_BITS == 0 && bitmap[z / BITMAP_WORD_BITS] == ~0ULL) {
+			run = 0;
+			z += BITMAP_WORD_BITS - 1;
+			continue;
+		}
+
+		if ((bitmap[z / BITMAP_WORD_BITS] >> (z % BITMAP_WORD_BITS)) & 1) {
+			run = 0;
+			continue;
+		}
+
+		if (++run == want) {
+			*slot = z + 1 - want;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * The number of slots up to the last one in use (0 when all are free)
+ */
+unsigned int used_slots(struct fs *fs, int flag) {
+	bitmap_word *bitmap;
+	long offset;
+	unsigned int words, *hint;
+	unsigned int bits;
+
+	bitmap = bitmap_of(fs, flag, &offset, &words, &hint);
+	bits = flag == INODE_FLAG ? fs->sb.inode_count : fs->sb.bloc_count;
+
+	/* from below the padding bits, a free word skips at once */
+	while (bits > 0) {
+		if (bits % BITMAP_WORD_BITS == 0 && bitmap[bits / BITMAP_WORD_BITS - 1] == 0) {
+			bits -= BITMAP_WORD_BITS;
+			continue;
+		}
+
+		if (slot_in_use(fs, flag, bits - 1))
+			return bits;
+		bits--;
+	}
+
+	return 0;
+}
+
+/**
+ * Counts the free slots of a bitmap (a popcount per word)
+ */
+unsigned int count_free_slots(struct fs *fs, int flag) {
+	bitmap_word *bitmap;
+	long offset;
+	unsigned int words, *hint;
+	unsigned int z, used;
+
+	bitmap = bitmap_of(fs, flag, &offset, &words, &hint);
+
+	used = 0;
+	for (z = 0; z != words; z++)
+		used += __builtin_popcountll(bitmap[z]);
+
+	return words * BITMAP_WORD_BITS - used;
+}
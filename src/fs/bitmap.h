@@ -0,0 +1,26 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BITMAP_WORD_BITS (64)
+/* no slot to start a run from (see alloc_run) */
+#define NO_GOAL ((unsigned int) -1)
+
+typedef unsigned long long bitmap_word;
+
+struct fs;
+
+int alloc_run(struct fs *fs, int flag, unsigned int goal, unsigned int want, unsigned int *slot, unsigned int *got);
+int alloc_slot(struct fs *fs, int flag, unsigned int *slot);
+int free_run(struct fs *fs, int flag, unsigned int slot, unsigned int count);
+int free_slot(struct fs *fs, int flag, unsigned int slot);
+int init_bitmap(int fd, long offset, unsigned int bits);
+int lowest_free_run(struct fs *fs, int flag, unsigned int want, unsigned int limit, unsigned int *slot);
+int slot_in_use(struct fs *fs, int flag, unsigned int slot);
+unsigned int count_free_slots(struct fs *fs, int flag);
+unsigned int used_slots(struct fs *fs, int flag);
+unsigned int bitmap_words(unsigned int bits);
+
+#endif
@@ -1,20 +1,20 @@
 #include "./bloc.h"
+#include "./extent.h"
 
 /**
- * Adds a bloc id to an inode
+ * Adds a written bloc at the end of the blocs of an inode (see
+ * extent_append)
  * TODO add return code
  * on success : returns 1
  * on failure : returns 0
  */
-int add_bloc(struct inode *i, struct bloc *b) {
-	if (i->bloc_count == BLOC_IDS_COUNT) {
+int add_bloc(struct fs *fs, struct inode *i, struct bloc *b) {
+	if (extent_append(fs, i, b->id, 1) != EXIT_SUCCESS) {
 		perror("Can't add anymore blocs to the inode !");
 		return 0;
-	} else {
-		i->bloc_ids[i->bloc_count] = b->id;
-		i->bloc_count++;
-		return 1;
 	}
+
+	return 1;
 }
 
 /**
@@ -27,12 +27,12 @@ struct bloc new_bloc(const char *content) {
 	struct bloc b;
 
 	memset(&b, 0, sizeof(struct bloc));
-	b.id = rand();
+	/* the id is given by write_bloc */
+	b.id = DELETED;
 
-	if (content == NULL) {
-		strcpy(b.content, "");
-	} else {
-		strcpy(b.content, content);
+	if (content != NULL) {
+		b.length = strnlen(content, BLOC_SIZE);
+		memcpy(b.content, content, b.length);
 	}
 
 	return b;
@@ -49,7 +49,8 @@ struct bloc empty_bloc() {
  */
 void print_bloc(struct bloc *b) {
 	printf("<BLOC> id:%d", b->id);
-	printf(" content:%s", b->content);
+	printf(" length:%u", b->length);
+	printf(" content:%.*s", (int) (b->length < BLOC_SIZE ? b->length : BLOC_SIZE), b->content);
 	puts("");
 }
 
@@ -6,13 +6,25 @@
 #define BLOC_SIZE (512)
 #define FILENAME_COUNT (sizeof(char)*15)
 
+/*
+ * The content of a bloc of a file is its length first bytes, all of
+ * BLOC_SIZE can be used (no terminating '\0'). Directory and extent blocs
+ * have a layout of their own (see dir.c and extent.c).
+ * checksum is the one of length and content, stored as the bloc is written
+ * (see checksum.c).
+ */
 struct bloc {
 	unsigned int id;
+	unsigned int length;
 
 	char content[BLOC_SIZE];
+
+	unsigned int checksum;
 };
 
-int add_bloc(struct inode *i, struct bloc *b);
+struct fs;
+
+int add_bloc(struct fs *fs, struct inode *i, struct bloc *b);
 struct bloc empty_bloc();
 struct bloc new_bloc(const char *content);
 void print_bloc(struct bloc *b);
@@ -0,0 +1,201 @@
+#include <pthread.h>
+#include <stddef.h>
+#include "./checksum.h"
+#include "./fs.h"
+
+/*
+ * Every bloc written carries the CRC32C of its length and its content
+ * (see bloc_seal): the id is where the bloc lies, a copy of it elsewhere
+ * (a snapshot) stays valid. A checksum of 0 is none (a bloc written
+ * before the checksums), never checked.
+ *
+ * The blocs are checked as they're read from the disk, not from the bloc
+ * cache: once each time they enter it (see checksum_check). A scrub
+ * checks every bloc in use (see scrub_disk).
+ */
+
+/**
+ * The checksum of a bloc, never 0
+ */
+unsigned int bloc_checksum(const struct bloc *b) {
+	unsigned int crc;
+
+	crc = crc32c(0, &b->length, offsetof(struct bloc, checksum) - offsetof(struct bloc, length));
+
+	return crc != 0 ? crc : 1;
+}
+
+/*
+ * Stores the checksum of a bloc about to be written
+ */
+void bloc_seal(struct bloc *b) {
+	b->checksum = bloc_checksum(b);
+}
+
+/**
+ * Reads the checks of the mount options ("verify=N"), one bloc read
+ * from the disk in DEFAULT_VERIFY_EVERY by default (DEFAULT_VERIFY_EVERY_SOFT
+ * without SSE4.2), "verify=0" checks none
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (a negative count)
+ */
+int checksum_init(struct fs *fs) {
+	memset(&fs->checksums, 0, sizeof(struct checksums));
+	fs->checksums.every = mount_option_value("verify",
+			crc32c_has_hw() ? DEFAULT_VERIFY_EVERY : DEFAULT_VERIFY_EVERY_SOFT);
+
+	return fs->checksums.every >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Checks a bloc just read from the disk against its checksum, one bloc in
+ * "verify=N" only
+ *
+ * success : 1 (sound, or not checked)
+ * failure : 0 (corrupted)
+ */
+int checksum_check(struct fs *fs, const struct bloc *b) {
+	if (fs->checksums.every == 0 || b->checksum == 0
+			|| fs->checksums.reads++ % fs->checksums.every != 0)
+		return 1;
+
+	fs->checksums.verified++;
+	if (bloc_checksum(b) == b->checksum)
+		return 1;
+
+	fs->checksums.errors++;
+	fprintf(stderr, "Bloc %u is corrupted %d\n", b->id, __LINE__);
+
+	return 0;
+}
+
+/*
+ * The share of a scrub of one thread: the slots first to last
+ */
+struct scrub_job {
+	struct fs *fs;
+	unsigned int first;
+	unsigned int last;
+	struct scrub_stats stats;
+	scrub_report report;
+	pthread_mutex_t *lock;
+};
+
+/*
+ * Checks the blocs in use of a share, EXTENT_IO_BLOCS read at a time
+ * past the caches (the disk as it is)
+ */
+static void *scrub_run(void *arg) {
+	struct scrub_job *job;
+	struct bloc *run;
+	unsigned int slot, count, j;
+	ssize_t size;
+
+	job = (struct scrub_job *) arg;
+	run = (struct bloc *) malloc(EXTENT_IO_BLOCS * sizeof(struct bloc));
+	if (run == NULL) return NULL;
+
+	for (slot = job->first; slot < job->last; slot += count) {
+		count = job->last - slot < EXTENT_IO_BLOCS ? job->last - slot : EXTENT_IO_BLOCS;
+		size = pread(job->fs->fd, run, count * sizeof(struct bloc), bloc_offset(&job->fs->sb, slot));
+		if (size < 0) size = 0;
+
+		for (j = 0; j != count; j++) {
+			if (!slot_in_use(job->fs, BLOC_FLAG, slot + j)) continue;
+
+			job->stats.checked++;
+			/* past the end of the file: a hole, as if zeroed */
+			if ((size_t) size < (j + 1) * sizeof(struct bloc) || run[j].checksum == 0) {
+				job->stats.unsealed++;
+				continue;
+			}
+			if (bloc_checksum(&run[j]) == run[j].checksum) continue;
+
+			job->stats.corrupted++;
+			if (job->report != NULL) {
+				pthread_mutex_lock(job->lock);
+				job->report(slot + j + 1);
+				pthread_mutex_unlock(job->lock);
+			}
+		}
+	}
+	free(run);
+
+	return NULL;
+}
+
+/**
+ * Checks every bloc in use against its checksum, threads at once (the
+ * number of processors with 0), each one a share of the bloc region
+ * The disk is read as it is on the device, the caches must be flushed.
+ *
+ * on success : returns EXIT_SUCCESS, the stats are stored (the disk is
+ * sound when corrupted is 0)
+ * on failure : returns EXIT_FAILURE (not mounted, no thread)
+ */
+int scrub_disk(struct fs *fs, unsigned int threads, struct scrub_stats *stats, scrub_report report) {
+	struct scrub_job *jobs;
+	pthread_t *ids;
+	pthread_mutex_t lock;
+	unsigned int z, share, started;
+	long cpus;
+
+	if (!fs->mounted) return EXIT_FAILURE;
+
+	/* the tables are built before the threads start */
+	crc32c_kernel();
+	if (threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (unsigned int) cpus : 1;
+	}
+	if (threads > SCRUB_THREADS_MAX)
+		threads = SCRUB_THREADS_MAX;
+
+	jobs = (struct scrub_job *) calloc(threads, sizeof(struct scrub_job));
+	ids = (pthread_t *) calloc(threads, sizeof(pthread_t));
+	if (jobs == NULL || ids == NULL) {
+		free(jobs);
+		free(ids);
+		return EXIT_FAILURE;
+	}
+	pthread_mutex_init(&lock, NULL);
+
+	/* shares of whole runs of the reads */
+	share = (fs->sb.bloc_high + threads - 1) / threads;
+	share = (share + EXTENT_IO_BLOCS - 1) / EXTENT_IO_BLOCS * EXTENT_IO_BLOCS;
+	for (z = 0; z != threads; z++) {
+		jobs[z].fs = fs;
+		jobs[z].first = z * share < fs->sb.bloc_high ? z * share : fs->sb.bloc_high;
+		jobs[z].last = jobs[z].first + share < fs->sb.bloc_high ? jobs[z].first + share : fs->sb.bloc_high;
+		jobs[z].report = report;
+		jobs[z].lock = &lock;
+	}
+
+	for (started = 0; started != threads; started++) {
+		if (pthread_create(&ids[started], NULL, scrub_run, &jobs[started]) != 0)
+			break;
+	}
+
+	memset(stats, 0, sizeof(struct scrub_stats));
+	stats->threads = started;
+	for (z = 0; z != started; z++) {
+		pthread_join(ids[z], NULL);
+		stats->checked += jobs[z].stats.checked;
+		stats->unsealed += jobs[z].stats.unsealed;
+		stats->corrupted += jobs[z].stats.corrupted;
+	}
+	/* the share of a thread not started is checked here */
+	for (z = started; z != threads; z++) {
+		scrub_run(&jobs[z]);
+		stats->checked += jobs[z].stats.checked;
+		stats->unsealed += jobs[z].stats.unsealed;
+		stats->corrupted += jobs[z].stats.corrupted;
+	}
+
+	pthread_mutex_destroy(&lock);
+	free(jobs);
+	free(ids);
+
+	return EXIT_SUCCESS;
+}
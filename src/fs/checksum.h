@@ -0,0 +1,50 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdlib.h>
+#include "./bloc.h"
+#include "./crc32c.h"
+
+/* one bloc read from the disk in N is checked, see "verify=N" */
+#define DEFAULT_VERIFY_EVERY (1)
+/* the same without SSE4.2, where a check costs more than the read itself */
+#define DEFAULT_VERIFY_EVERY_SOFT (8)
+/* most threads of a scrub */
+#define SCRUB_THREADS_MAX (64)
+
+/*
+ * The checks of the blocs read by a mounted disk (see checksum_check)
+ *
+ * every is "verify=N": one bloc read from the disk in every is checked,
+ * none with 0. errors counts the blocs found corrupted.
+ */
+struct checksums {
+	long every;
+	unsigned long reads;
+	unsigned long verified;
+	unsigned long errors;
+};
+
+/*
+ * What a scrub found: the blocs in use checked, the ones without a
+ * checksum (written by no version with checksums), the corrupted ones
+ */
+struct scrub_stats {
+	unsigned int threads;
+	unsigned int checked;
+	unsigned int unsealed;
+	unsigned int corrupted;
+};
+
+/* called for each corrupted bloc found, one call at a time */
+typedef void (*scrub_report)(unsigned int id);
+
+struct fs;
+
+int checksum_check(struct fs *fs, const struct bloc *b);
+int checksum_init(struct fs *fs);
+int scrub_disk(struct fs *fs, unsigned int threads, struct scrub_stats *stats, scrub_report report);
+unsigned int bloc_checksum(const struct bloc *b);
+void bloc_seal(struct bloc *b);
+
+#endif
@@ -0,0 +1,153 @@
+#include "./compact.h"
+#include "./fs.h"
+
+/*
+ * Microseconds of a monotonic clock
+ */
+static long now_us() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+/**
+ * Reads the blocs a tick moves of the mount options ("compact=N"),
+ * DEFAULT_COMPACT_BLOCS by default, "compact=0" turns compaction off
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (a negative count)
+ */
+int compact_init(struct fs *fs) {
+	long blocs;
+
+	memset(&fs->compact, 0, sizeof(struct compact));
+
+	blocs = mount_option_value("compact", DEFAULT_COMPACT_BLOCS);
+	fs->compact.blocs = blocs > 0 ? (unsigned int) blocs : 0;
+
+	return blocs >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Lowers the highs to the last slots in use, the disk file shrinks with
+ * the bloc region when it isn't mapped (the mapping would lose its end)
+ */
+static int lower_highs(struct fs *fs) {
+	unsigned int inode_high, bloc_high;
+
+	inode_high = used_slots(fs, INODE_FLAG);
+	bloc_high = used_slots(fs, BLOC_FLAG);
+	if (inode_high >= fs->sb.inode_high && bloc_high >= fs->sb.bloc_high)
+		return EXIT_SUCCESS;
+
+	if (inode_high < fs->sb.inode_high)
+		fs->sb.inode_high = inode_high;
+	if (bloc_high < fs->sb.bloc_high)
+		fs->sb.bloc_high = bloc_high;
+
+	return write_superblock(fs);
+}
+
+/*
+ * Undoes a tick that failed: its writes are dropped and the mounted disk
+ * is loaded again as the commits before it left it (the caches were
+ * written back before the tick), compaction waits for the disk to change
+ */
+static void undo_tick(struct fs *fs) {
+	if (fs->txn.depth > 0)
+		txn_abort(fs);
+	else
+		txn_discard(&fs->txn);
+
+	bcache_invalidate(&fs->bcache);
+	icache_invalidate(&fs->icache);
+	if (journal_sync(fs) == EXIT_SUCCESS)
+		refresh_disk(fs);
+	fs->compact.settled = 1;
+}
+
+/**
+ * Moves up to "compact=N" blocs of the files down to the lowest free
+ * runs (see extent_move), for COMPACT_TICK_MS at most, so the highs and
+ * the disk file come down as the files are removed and written again
+ * The inodes stay where they are: the directories hold their ids. A pass
+ * moving nothing lowers the highs, the next ticks do nothing until the
+ * disk changes (see refresh_disk). Nothing moves while there are
+ * snapshots (each bloc moved would be a copy more) or one is mounted.
+ * The blocs of a tick move in one transaction. A tick that fails is
+ * undone: the files map the blocs of before, none of them freed.
+ *
+ * on success : returns 1 (more to do)
+ * on failure : returns 0 (nothing left to move, turned off)
+ */
+int compact_tick(struct fs *fs) {
+	struct compact *c;
+	struct inode i;
+	unsigned int slot, budget, moved;
+	long deadline;
+	off_t size;
+	int rst;
+
+	c = &fs->compact;
+	if (!fs->mounted || c->blocs == 0 || c->settled || fs->snapshots.count > 0 || fs->txn.depth > 0)
+		return 0;
+
+	/* only the changes of the tick are in the caches, an undo drops them */
+	if (icache_flush(fs) != EXIT_SUCCESS || bcache_flush(fs) != EXIT_SUCCESS)
+		return 0;
+
+	deadline = now_us() + COMPACT_TICK_MS * 1000L;
+	budget = c->blocs;
+	rst = EXIT_SUCCESS;
+
+	txn_begin(fs);
+	while (budget > 0 && now_us() < deadline) {
+		if (c->cursor >= fs->sb.inode_high) {
+			/* a pass is over */
+			c->passes++;
+			if (c->pass_moved == 0) {
+				lower_highs(fs);
+				c->settled = 1;
+				break;
+			}
+
+			c->cursor = 0;
+			c->pass_moved = 0;
+			continue;
+		}
+
+		slot = c->cursor++;
+		if (!slot_in_use(fs, INODE_FLAG, slot)) continue;
+
+		i = get_inode_by_id(fs, slot + 1);
+		if (i.id == DELETED || extent_move(fs, &i, budget, &moved) != EXIT_SUCCESS || moved == 0)
+			continue;
+
+		/* the old blocs are free: the inode must map the new ones */
+		rst = update_inode(fs, &i);
+		if (rst != EXIT_SUCCESS) break;
+		c->pass_moved += moved;
+		c->moved += moved;
+
+		/* the rest of the file is for the next tick */
+		if (moved == budget)
+			c->cursor--;
+		budget -= moved;
+	}
+	if (rst != EXIT_SUCCESS || txn_commit(fs) != EXIT_SUCCESS) {
+		fprintf(stderr, "Compaction undone %d\n", __LINE__);
+		undo_tick(fs);
+		return 0;
+	}
+	c->ticks++;
+
+	/* the bloc region ends at the high */
+	size = bloc_offset(&fs->sb, fs->sb.bloc_high);
+	if (c->settled && fs->map == NULL && lseek(fs->fd, 0, SEEK_END) > size
+			&& ftruncate(fs->fd, size) != 0)
+		fprintf(stderr, "Can't shrink the disk %d\n", __LINE__);
+
+	return !c->settled;
+}
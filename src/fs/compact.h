@@ -0,0 +1,38 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stdlib.h>
+#include <time.h>
+
+/* blocs moved a tick at most, see "compact=N" (0 turns it off) */
+#define DEFAULT_COMPACT_BLOCS (32)
+/* ms a tick may run */
+#define COMPACT_TICK_MS (2)
+/* ms the shell waits for a key between two ticks */
+#define COMPACT_IDLE_MS (10)
+
+/*
+ * The compaction of a mounted disk, a few blocs at a time (see
+ * compact_tick)
+ *
+ * A pass walks the inodes from cursor, the blocs of each file move down
+ * to the lowest free runs. settled is set by a pass which moved nothing:
+ * the highs came down, there's nothing to do until the disk changes.
+ */
+struct compact {
+	unsigned int blocs;
+	unsigned int cursor;
+	unsigned int pass_moved;
+	int settled;
+
+	unsigned long ticks;
+	unsigned long moved;
+	unsigned long passes;
+};
+
+struct fs;
+
+int compact_init(struct fs *fs);
+int compact_tick(struct fs *fs);
+
+#endif
@@ -0,0 +1,192 @@
+#include <pthread.h>
+#include <string.h>
+#include "./crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86
+#endif
+
+/*
+ * CRC32C (Castagnoli) of the blocs (see checksum.c)
+ *
+ * Three kernels give the same result: the SSE4.2 crc32 instruction, 8
+ * bytes a step, when the processor has it; slicing by 8 with 8 tables of
+ * 256 entries otherwise; a byte a step as the scalar baseline (see
+ * bench_fs.c). crc32c picks the fastest one on its first call.
+ *
+ * A crc32 instruction waits for the one before, so the SSE4.2 kernel runs
+ * three lanes of CRC32C_LANE bytes at once and joins them: the crc of a
+ * lane is shifted over the next one (CRC32C_LANE zero bytes appended,
+ * with the tables of zeros) and xored with it.
+ */
+
+/* bytes of a lane, a bloc (its length and its content) is three of them */
+#define CRC32C_LANE (168)
+
+static unsigned int tables[8][256];
+static unsigned int zeros[4][256];
+static unsigned int (*kernel)(unsigned int, const void *, size_t);
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static void init_tables() {
+	unsigned int crc;
+	int z, k, n;
+
+	for (z = 0; z != 256; z++) {
+		crc = z;
+		for (k = 0; k != 8; k++)
+			crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		tables[0][z] = crc;
+	}
+
+	/* tables[k][z]: the byte z followed by k zero bytes */
+	for (z = 0; z != 256; z++) {
+		for (k = 1; k != 8; k++)
+			tables[k][z] = (tables[k - 1][z] >> 8) ^ tables[0][tables[k - 1][z] & 0xff];
+	}
+
+	/* zeros[k][z]: the byte z at k, then CRC32C_LANE zero bytes */
+	for (z = 0; z != 256; z++) {
+		for (k = 0; k != 4; k++) {
+			crc = (unsigned int) z << (8 * k);
+			for (n = 0; n != CRC32C_LANE; n++)
+				crc = (crc >> 8) ^ tables[0][crc & 0xff];
+			zeros[k][z] = crc;
+		}
+	}
+
+	kernel = crc32c_has_hw() ? crc32c_hw : crc32c_slicing;
+}
+
+/**
+ * Checks if the processor has the crc32 instruction (SSE4.2)
+ *
+ * success : 1
+ * failure : 0
+ */
+int crc32c_has_hw() {
+#ifdef CRC32C_X86
+	return __builtin_cpu_supports("sse4.2");
+#else
+	return 0;
+#endif
+}
+
+/*
+ * The name of the kernel crc32c uses
+ */
+const char *crc32c_kernel() {
+	pthread_once(&once, init_tables);
+
+	return kernel == crc32c_hw ? "sse4.2" : "slicing-by-8";
+}
+
+/**
+ * The CRC32C of size bytes, crc is the one of the bytes before (0 for
+ * none)
+ */
+unsigned int crc32c(unsigned int crc, const void *buf, size_t size) {
+	pthread_once(&once, init_tables);
+
+	return kernel(crc, buf, size);
+}
+
+/*
+ * A byte a step, the scalar baseline
+ */
+unsigned int crc32c_bytewise(unsigned int crc, const void *buf, size_t size) {
+	const unsigned char *p;
+
+	pthread_once(&once, init_tables);
+
+	p = (const unsigned char *) buf;
+	crc = ~crc;
+	while (size-- > 0)
+		crc = (crc >> 8) ^ tables[0][(crc ^ *p++) & 0xff];
+
+	return ~crc;
+}
+
+/*
+ * 8 bytes a step, a table lookup for each of them
+ */
+unsigned int crc32c_slicing(unsigned int crc, const void *buf, size_t size) {
+	const unsigned char *p;
+	unsigned int low, high;
+
+	pthread_once(&once, init_tables);
+
+	p = (const unsigned char *) buf;
+	crc = ~crc;
+	for (; size >= 8; size -= 8, p += 8) {
+		/* the bytes in the order of the stream, whatever the endianness */
+		low = crc ^ ((unsigned int) p[0] | (unsigned int) p[1] << 8 | (unsigned int) p[2] << 16
+				| (unsigned int) p[3] << 24);
+		high = (unsigned int) p[4] | (unsigned int) p[5] << 8 | (unsigned int) p[6] << 16
+				| (unsigned int) p[7] << 24;
+
+		crc = tables[7][low & 0xff] ^ tables[6][(low >> 8) & 0xff]
+				^ tables[5][(low >> 16) & 0xff] ^ tables[4][low >> 24]
+				^ tables[3][high & 0xff] ^ tables[2][(high >> 8) & 0xff]
+				^ tables[1][(high >> 16) & 0xff] ^ tables[0][high >> 24];
+	}
+
+	while (size-- > 0)
+		crc = (crc >> 8) ^ tables[0][(crc ^ *p++) & 0xff];
+
+	return ~crc;
+}
+
+#ifdef CRC32C_X86
+/*
+ * A crc with CRC32C_LANE zero bytes appended
+ */
+static unsigned int shift_lane(unsigned int crc) {
+	return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^ zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+/*
+ * 8 bytes a step with the crc32 instruction, three lanes at once, the
+ * processor must have it (see crc32c_has_hw)
+ */
+__attribute__((target("sse4.2")))
+unsigned int crc32c_hw(unsigned int crc, const void *buf, size_t size) {
+	const unsigned char *p;
+	unsigned long long word, c, c1, c2;
+	size_t k;
+
+	pthread_once(&once, init_tables);
+
+	p = (const unsigned char *) buf;
+	c = ~crc;
+#ifdef __x86_64__
+	for (; size >= 3 * CRC32C_LANE; size -= 3 * CRC32C_LANE, p += 3 * CRC32C_LANE) {
+		c1 = 0;
+		c2 = 0;
+		for (k = 0; k != CRC32C_LANE; k += 8) {
+			memcpy(&word, p + k, sizeof(word));
+			c = _mm_crc32_u64(c, word);
+			memcpy(&word, p + CRC32C_LANE + k, sizeof(word));
+			c1 = _mm_crc32_u64(c1, word);
+			memcpy(&word, p + 2 * CRC32C_LANE + k, sizeof(word));
+			c2 = _mm_crc32_u64(c2, word);
+		}
+		c = shift_lane(shift_lane((unsigned int) c) ^ (unsigned int) c1) ^ (unsigned int) c2;
+	}
+
+	for (; size >= 8; size -= 8, p += 8) {
+		memcpy(&word, p, sizeof(word));
+		c = _mm_crc32_u64(c, word);
+	}
+#endif
+	while (size-- > 0)
+		c = _mm_crc32_u8((unsigned int) c, *p++);
+
+	return ~(unsigned int) c;
+}
+#else
+unsigned int crc32c_hw(unsigned int crc, const void *buf, size_t size) {
+	return crc32c_slicing(crc, buf, size);
+}
+#endif
@@ -0,0 +1,16 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdlib.h>
+
+/* reflected Castagnoli polynomial */
+#define CRC32C_POLY (0x82f63b78u)
+
+unsigned int crc32c(unsigned int crc, const void *buf, size_t size);
+unsigned int crc32c_bytewise(unsigned int crc, const void *buf, size_t size);
+unsigned int crc32c_hw(unsigned int crc, const void *buf, size_t size);
+unsigned int crc32c_slicing(unsigned int crc, const void *buf, size_t size);
+const char *crc32c_kernel();
+int crc32c_has_hw();
+
+#endif
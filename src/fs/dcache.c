@@ -0,0 +1,167 @@
+#include "./dcache.h"
+#include "./fs.h"
+
+/**
+ * Allocates an empty cache of size entries
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (out of memory)
+ */
+int dcache_init(struct dcache *c, size_t size) {
+	memset(c, 0, sizeof(struct dcache));
+
+	if (size == 0)
+		size = 1;
+
+	c->entries = (struct dcache_entry *) calloc(size, sizeof(struct dcache_entry));
+	c->names = (struct dcache_name *) calloc(size, sizeof(struct dcache_name));
+	if (c->entries == NULL || c->names == NULL) {
+		dcache_free(c);
+		return EXIT_FAILURE;
+	}
+
+	c->size = size;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Releases the memory of the cache
+ */
+void dcache_free(struct dcache *c) {
+	free(c->entries);
+	free(c->names);
+	memset(c, 0, sizeof(struct dcache));
+}
+
+/*
+ * Forgets every lookup
+ */
+void dcache_invalidate(struct dcache *c) {
+	if (c->entries == NULL) return;
+
+	memset(c->entries, 0, c->size * sizeof(struct dcache_entry));
+	memset(c->names, 0, c->size * sizeof(struct dcache_name));
+}
+
+/*
+ * The entry of a key
+ */
+static struct dcache_entry *entry_of(struct dcache *c, unsigned int parent, const char *name) {
+	return &c->entries[(dir_hash(name) ^ (parent * 2654435761u)) % c->size];
+}
+
+/**
+ * Looks up a name under a directory
+ *
+ * on success : returns 1 and stores the id, DELETED for a missing name
+ * on failure : returns 0 (not cached)
+ */
+int dcache_lookup(struct dcache *c, unsigned int parent, const char *name, unsigned int *id) {
+	struct dcache_entry *e;
+
+	if (c->entries == NULL || parent == DELETED) return 0;
+
+	e = entry_of(c, parent, name);
+	if (e->parent != parent || strcmp(e->name, name) != 0) {
+		c->misses++;
+		return 0;
+	}
+
+	c->hits++;
+	*id = e->id;
+
+	return 1;
+}
+
+/*
+ * Caches the result of a lookup, DELETED for a missing name
+ */
+void dcache_insert(struct dcache *c, unsigned int parent, const char *name, unsigned int id) {
+	struct dcache_entry *e;
+
+	if (c->entries == NULL || parent == DELETED || strlen(name) > DCACHE_NAME_MAX) return;
+
+	e = entry_of(c, parent, name);
+	e->parent = parent;
+	e->id = id;
+	strcpy(e->name, name);
+}
+
+/*
+ * Forgets the lookup of a name (it's added or removed)
+ */
+void dcache_drop(struct dcache *c, unsigned int parent, const char *name) {
+	struct dcache_entry *e;
+
+	if (c->entries == NULL || parent == DELETED) return;
+
+	e = entry_of(c, parent, name);
+	if (e->parent == parent && strcmp(e->name, name) == 0)
+		e->parent = DELETED;
+}
+
+/*
+ * Forgets every lookup under a directory and its reverse lookups (it's
+ * deleted, its id can be given again)
+ */
+void dcache_purge(struct dcache *c, unsigned int parent) {
+	size_t z;
+
+	if (c->entries == NULL) return;
+
+	for (z = 0; z != c->size; z++) {
+		if (c->entries[z].parent == parent)
+			c->entries[z].parent = DELETED;
+		if (c->names[z].id == parent || c->names[z].parent == parent)
+			c->names[z].id = DELETED;
+	}
+}
+
+/**
+ * Looks up the name of an inode and the directory it's in
+ *
+ * on success : returns 1, stores the parent and the name
+ * on failure : returns 0 (not cached)
+ */
+int dcache_name_lookup(struct dcache *c, unsigned int id, unsigned int *parent, char *name) {
+	struct dcache_name *e;
+
+	if (c->names == NULL || id == DELETED) return 0;
+
+	e = &c->names[id % c->size];
+	if (e->id != id) {
+		c->misses++;
+		return 0;
+	}
+
+	c->hits++;
+	*parent = e->parent;
+	strcpy(name, e->name);
+
+	return 1;
+}
+
+/*
+ * Caches the name of an inode in a directory
+ */
+void dcache_name_insert(struct dcache *c, unsigned int id, unsigned int parent, const char *name) {
+	struct dcache_name *e;
+
+	if (c->names == NULL || id == DELETED || strlen(name) > DCACHE_NAME_MAX) return;
+
+	e = &c->names[id % c->size];
+	e->id = id;
+	e->parent = parent;
+	strcpy(e->name, name);
+}
+
+/*
+ * Forgets the name of an inode (it's removed from its directory)
+ */
+void dcache_name_drop(struct dcache *c, unsigned int id) {
+	if (c->names == NULL || id == DELETED) return;
+
+	if (c->names[id % c->size].id == id)
+		c->names[id % c->size].id = DELETED;
+}
@@ -0,0 +1,60 @@
+#ifndef DCACHE_H
+#define DCACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_DCACHE_SIZE (256)
+/* longer names are not cached */
+#define DCACHE_NAME_MAX (31)
+
+/*
+ * A cached name lookup: the id of name under the directory parent, or
+ * DELETED when the name is known to be missing (a negative entry)
+ * An empty entry has parent == DELETED.
+ */
+struct dcache_entry {
+	unsigned int parent;
+	unsigned int id;
+	char name[DCACHE_NAME_MAX + 1];
+};
+
+/*
+ * A cached reverse lookup: the inode id is named name in the directory
+ * parent (see inode_path)
+ */
+struct dcache_name {
+	unsigned int id;
+	unsigned int parent;
+	char name[DCACHE_NAME_MAX + 1];
+};
+
+/*
+ * Cache of the name lookups of a mounted disk, keyed by (parent, name),
+ * and of the reverse lookups, keyed by id
+ *
+ * Direct mapped: a key has one entry, the last lookup of a key sharing
+ * it takes it over. The entries of a directory are dropped when a name is
+ * added to or removed from it, all of them when the directory is deleted.
+ */
+struct dcache {
+	struct dcache_entry *entries;
+	struct dcache_name *names;
+	size_t size;
+
+	unsigned long hits;
+	unsigned long misses;
+};
+
+int dcache_init(struct dcache *c, size_t size);
+int dcache_lookup(struct dcache *c, unsigned int parent, const char *name, unsigned int *id);
+int dcache_name_lookup(struct dcache *c, unsigned int id, unsigned int *parent, char *name);
+void dcache_name_drop(struct dcache *c, unsigned int id);
+void dcache_name_insert(struct dcache *c, unsigned int id, unsigned int parent, const char *name);
+void dcache_drop(struct dcache *c, unsigned int parent, const char *name);
+void dcache_free(struct dcache *c);
+void dcache_insert(struct dcache *c, unsigned int parent, const char *name, unsigned int id);
+void dcache_invalidate(struct dcache *c);
+void dcache_purge(struct dcache *c, unsigned int parent);
+
+#endif
@@ -0,0 +1,267 @@
+#include "./defrag.h"
+#include "./fs.h"
+
+/*
+ * Offline compaction of a disk: the files reachable from the root are
+ * rewritten to a new image, which then replaces the disk
+ *
+ * The inodes are numbered in tree order, the entries of a directory
+ * together, then the tree of each of its subdirectories. The blocs follow
+ * the inodes: the buckets of a directory, then the blocs of each file,
+ * one run each. Free slots, orphans and the share table are left behind:
+ * the highs and the file shrink to what is in use. Shared blocs stay
+ * shared (see share.c), the table is written again at the end.
+ */
+
+/*
+ * The inodes to rewrite in their order, the new id of an inode is its
+ * index + 1 (ids holds old id -> new id)
+ */
+struct plan {
+	unsigned int *order;
+	unsigned int count;
+	unsigned int size;
+	struct idmap ids;
+};
+
+static int plan_add(struct plan *p, unsigned int id) {
+	unsigned int *order;
+
+	if (p->count == p->size) {
+		p->size = p->size ? p->size * 2 : 64;
+		order = (unsigned int *) realloc(p->order, p->size * sizeof(unsigned int));
+		if (order == NULL) return EXIT_FAILURE;
+		p->order = order;
+	}
+
+	p->order[p->count++] = id;
+
+	return idmap_put(&p->ids, id, p->count);
+}
+
+/*
+ * Numbers the entries of a directory, then the trees of its
+ * subdirectories (an inode of several entries once)
+ */
+static int plan_tree(struct fs *fs, struct plan *p, struct inode *dir) {
+	struct dir_iter it;
+	struct inode i;
+	unsigned int first, last, k;
+	long known;
+	int rst;
+
+	rst = EXIT_SUCCESS;
+	first = p->count;
+	dir_iter_init(fs, &it, dir);
+	while (rst == EXIT_SUCCESS && dir_iter_next(&it)) {
+		if (strcmp(it.name, ".") == 0 || strcmp(it.name, "..") == 0 || idmap_get(&p->ids, it.id, &known))
+			continue;
+
+		if (get_inode_by_id(fs, it.id).id != DELETED)
+			rst = plan_add(p, it.id);
+	}
+
+	/* the subtrees go after every entry */
+	last = p->count;
+	for (k = first; rst == EXIT_SUCCESS && k != last; k++) {
+		i = get_inode_by_id(fs, p->order[k]);
+		if (i.type == DIRECTORY)
+			rst = plan_tree(fs, p, &i);
+	}
+
+	return rst;
+}
+
+/*
+ * Rewrites the nth inode of the plan and its blocs to the new disk
+ * A directory keeps its buckets, with the new ids of its entries. A bloc
+ * already rewritten for another file stays shared (shares holds new bloc
+ * id -> shares to add).
+ */
+static int copy_inode(struct fs *from, struct fs *to, struct plan *p, struct idmap *blocs, struct idmap *shares,
+		unsigned int n) {
+	struct inode i, copy;
+	struct extent *extents;
+	struct bloc b;
+	struct dir_iter it;
+	unsigned int id, nth;
+	long known, count;
+	int z, rst;
+
+	i = get_inode_by_id(from, p->order[n]);
+	copy = i;
+	copy.id = DELETED;
+	copy.extent_count = 0;
+	copy.overflow = DELETED;
+	copy.bloc_count = 0;
+
+	rst = EXIT_SUCCESS;
+	nth = 0;
+	extents = get_extents(from, &i);
+	for (z = 0; rst == EXIT_SUCCESS && extents != NULL && z != i.extent_count; z++) {
+		for (id = extents[z].start; rst == EXIT_SUCCESS && id != extents[z].start + extents[z].length; id++, nth++) {
+			if (idmap_get(blocs, id, &known)) {
+				count = 0;
+				idmap_get(shares, known, &count);
+				rst = idmap_put(shares, known, count + 1);
+				if (rst == EXIT_SUCCESS)
+					rst = extent_append(to, &copy, known, 1);
+				continue;
+			}
+
+			if (i.type == DIRECTORY) {
+				/* the same bucket, the entries of the files rewritten */
+				b = new_bloc("");
+				dir_iter_init(from, &it, &i);
+				it.bucket = nth - 1;
+				it.last_bucket = nth;
+				while (dir_iter_next(&it)) {
+					if (idmap_get(&p->ids, it.id, &known))
+						dirent_add(&b, known, it.type, it.name);
+				}
+			} else {
+				b = get_bloc_by_id(from, id);
+				if (b.id == DELETED) rst = EXIT_FAILURE;
+			}
+
+			if (rst == EXIT_SUCCESS)
+				rst = write_bloc(to, &b);
+			if (rst == EXIT_SUCCESS)
+				rst = idmap_put(blocs, id, b.id);
+			if (rst == EXIT_SUCCESS)
+				rst = extent_append(to, &copy, b.id, 1);
+		}
+	}
+	free(extents);
+
+	/* the fresh disk hands out the inode slots in order */
+	if (rst != EXIT_SUCCESS || write_inode(to, &copy) != EXIT_SUCCESS || copy.id != n + 1) {
+		fprintf(stderr, "Can't rewrite inode %u %d\n", p->order[n], __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Reads the shape of a mounted disk (see struct defrag_stats)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int defrag_stats(struct fs *fs, struct defrag_stats *stats) {
+	struct stat st;
+	struct inode i;
+	unsigned int slot;
+
+	if (flush_disk(fs) != EXIT_SUCCESS || fstat(fs->fd, &st) != 0)
+		return EXIT_FAILURE;
+
+	memset(stats, 0, sizeof(struct defrag_stats));
+	stats->size = st.st_size;
+	stats->inode_high = fs->sb.inode_high;
+	stats->bloc_high = fs->sb.bloc_high;
+
+	for (slot = 0; slot != fs->sb.inode_high; slot++) {
+		if (!slot_in_use(fs, INODE_FLAG, slot)) continue;
+
+		stats->inodes++;
+		i = get_inode_by_id(fs, slot + 1);
+		if (i.id != DELETED)
+			stats->extents += i.extent_count;
+	}
+
+	for (slot = 0; slot != fs->sb.bloc_high; slot++) {
+		if (slot_in_use(fs, BLOC_FLAG, slot))
+			stats->blocs++;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Rewrites the disk at path without its free slots, its files contiguous
+ * in tree order (see above). The new image is written next to it, then
+ * replaces it: the disk is left as it was on a failure.
+ * pwd is an inode id of the disk, it's given its new id (the root when
+ * it's gone). progress may be NULL.
+ * Offline: nothing else may write the disk meanwhile.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (snapshots to drop first, no disk,
+ * write error)
+ */
+int defrag_disk(const char *path, unsigned int *pwd, struct defrag_stats *before, struct defrag_stats *after,
+		defrag_progress progress) {
+	struct fs from, to;
+	struct plan p;
+	struct idmap blocs, shares;
+	struct inode root;
+	char *tmp_path;
+	unsigned int k;
+	long known;
+	int rst;
+
+	if (mount_disk(&from, path) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	/* the snapshots hold records by slot, a rewrite would break them */
+	if (from.snapshots.count > 0) {
+		fprintf(stderr, "Drop the snapshots first %d\n", __LINE__);
+		unmount_disk(&from);
+		return EXIT_FAILURE;
+	}
+
+	memset(&p, 0, sizeof(struct plan));
+	idmap_init(&p.ids);
+	idmap_init(&blocs);
+	idmap_init(&shares);
+
+	rst = defrag_stats(&from, before);
+	root = get_inode_by_id(&from, ROOT_ID);
+	if (rst == EXIT_SUCCESS)
+		rst = root.id == ROOT_ID ? plan_add(&p, ROOT_ID) : EXIT_FAILURE;
+	if (rst == EXIT_SUCCESS)
+		rst = plan_tree(&from, &p, &root);
+
+	tmp_path = (char *) calloc(strlen(path) + 5, sizeof(char));
+	sprintf(tmp_path, "%s.new", path);
+
+	if (rst == EXIT_SUCCESS && format_disk(tmp_path, from.sb.inode_count, from.sb.bloc_count) == EXIT_SUCCESS
+			&& mount_disk(&to, tmp_path) == EXIT_SUCCESS) {
+		for (k = 0; rst == EXIT_SUCCESS && k != p.count; k++) {
+			rst = copy_inode(&from, &to, &p, &blocs, &shares, k);
+			if (progress != NULL)
+				progress(k + 1, p.count);
+		}
+
+		for (k = 0; rst == EXIT_SUCCESS && k != shares.capacity; k++) {
+			if (shares.keys[k] != IDMAP_EMPTY)
+				rst = share_add(&to, shares.keys[k], 1, (int) shares.values[k]);
+		}
+
+		if (rst == EXIT_SUCCESS)
+			rst = defrag_stats(&to, after);
+		if (rst == EXIT_SUCCESS)
+			rst = disk_sync(&to);
+		unmount_disk(&to);
+	} else {
+		rst = EXIT_FAILURE;
+	}
+	unmount_disk(&from);
+
+	if (rst == EXIT_SUCCESS)
+		rst = rename(tmp_path, path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	else
+		remove(tmp_path);
+
+	if (rst == EXIT_SUCCESS && pwd != NULL)
+		*pwd = idmap_get(&p.ids, *pwd, &known) ? (unsigned int) known : ROOT_ID;
+
+	free(p.order);
+	idmap_free(&p.ids);
+	idmap_free(&blocs);
+	idmap_free(&shares);
+	free(tmp_path);
+	return rst;
+}
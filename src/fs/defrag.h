@@ -0,0 +1,33 @@
+#ifndef DEFRAG_H
+#define DEFRAG_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * The shape of a disk, shown before and after defrag_disk
+ *
+ * extents counts the extents of every inode: one an inode when each file
+ * is contiguous. The highs bound every scan of the inode table and of the
+ * bloc region.
+ */
+struct defrag_stats {
+	size_t size;
+	unsigned int inodes;
+	unsigned int blocs;
+	unsigned int inode_high;
+	unsigned int bloc_high;
+	unsigned int extents;
+};
+
+/* called after each inode rewritten, done out of total */
+typedef void (*defrag_progress)(unsigned int done, unsigned int total);
+
+struct fs;
+
+int defrag_disk(const char *path, unsigned int *pwd, struct defrag_stats *before, struct defrag_stats *after,
+		defrag_progress progress);
+int defrag_stats(struct fs *fs, struct defrag_stats *stats);
+
+#endif
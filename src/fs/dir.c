@@ -0,0 +1,247 @@
+#include "./dir.h"
+#include "./fs.h"
+
+/*
+ * Directories are hash tables of filenames, one bloc a bucket, grown by
+ * linear hashing: with n buckets and low the highest power of 2 <= n, a
+ * name goes to hash % low, or to hash % (2 * low) when hash % low is below
+ * the split point n - low. Adding a bucket splits the bucket at the split
+ * point, so the number of blocs of a directory is all its state.
+ *
+ * A bucket holds packed entries:
+ * [id: unsigned int][name length: 1 byte][type hint: 1 byte][name]
+ * and ends at the end of the bloc or at a name length of 0 (the rest of
+ * the bloc is zeroed).
+ */
+
+/*
+ * FNV-1a hash of a filename
+ */
+unsigned int dir_hash(const char *name) {
+	unsigned int h;
+
+	h = 2166136261u;
+	while (*name != '\0') {
+		h ^= (unsigned char) *name++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/**
+ * Returns the bucket (the nth bloc) of a filename in a directory
+ */
+int dir_bucket(struct inode *dir, const char *name) {
+	unsigned int h, low, count;
+
+	count = dir->bloc_count > 0 ? dir->bloc_count : 1;
+	for (low = 1; low * 2 <= count; low *= 2);
+
+	h = dir_hash(name);
+	if (h % low < count - low)
+		return h % (2 * low);
+
+	return h % low;
+}
+
+/*
+ * The directory as it is on the disk: a copy kept by the caller may miss
+ * the buckets added since it was read (see dir_split)
+ */
+struct inode current_dir(struct fs *fs, struct inode *dir) {
+	struct inode d;
+
+	d = get_inode_by_id(fs, dir->id);
+	if (d.id == DELETED)
+		return *dir;
+
+	return d;
+}
+
+/*
+ * The number of bytes used by the entries of a bucket
+ */
+static int dirent_used(const struct bloc *b) {
+	int offset;
+
+	offset = 0;
+	while (offset + (int) DIRENT_HEADER_SIZE <= BLOC_SIZE
+			&& b->content[offset + sizeof(unsigned int)] != 0)
+		offset += DIRENT_HEADER_SIZE + (unsigned char) b->content[offset + sizeof(unsigned int)];
+
+	return offset;
+}
+
+/**
+ * Finds the entry of a name in a bucket
+ *
+ * on success : returns the offset of the entry
+ * on failure : returns -1 (not in the bucket)
+ */
+int dirent_find(const struct bloc *b, const char *name) {
+	int offset, len;
+	size_t name_len;
+
+	name_len = strlen(name);
+	offset = 0;
+	while (offset + (int) DIRENT_HEADER_SIZE <= BLOC_SIZE
+			&& (len = (unsigned char) b->content[offset + sizeof(unsigned int)]) != 0) {
+		if ((size_t) len == name_len && memcmp(b->content + offset + DIRENT_HEADER_SIZE, name, len) == 0)
+			return offset;
+		offset += DIRENT_HEADER_SIZE + len;
+	}
+
+	return -1;
+}
+
+/**
+ * Appends an entry to a bucket
+ * A name is in a directory once: its entry can only be in the bucket of
+ * the name (see dir_bucket), it's refused when it's there already.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (empty name, longer than
+ * DIRENT_NAME_MAX, taken, the bucket is full)
+ */
+int dirent_add(struct bloc *b, unsigned int id, enum filetype type, const char *name) {
+	int offset;
+	size_t len;
+
+	len = strlen(name);
+	if (len == 0 || len > DIRENT_NAME_MAX || dirent_find(b, name) >= 0)
+		return EXIT_FAILURE;
+
+	offset = dirent_used(b);
+	if (offset + DIRENT_HEADER_SIZE + len > BLOC_SIZE)
+		return EXIT_FAILURE;
+
+	memcpy(b->content + offset, &id, sizeof(unsigned int));
+	b->content[offset + sizeof(unsigned int)] = (char) len;
+	b->content[offset + sizeof(unsigned int) + 1] = (char) type;
+	memcpy(b->content + offset + DIRENT_HEADER_SIZE, name, len);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Removes the entry at offset from a bucket, the next ones move back
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no entry there)
+ */
+int dirent_remove(struct bloc *b, int offset) {
+	int used, len;
+
+	used = dirent_used(b);
+	if (offset < 0 || offset >= used)
+		return EXIT_FAILURE;
+
+	len = DIRENT_HEADER_SIZE + (unsigned char) b->content[offset + sizeof(unsigned int)];
+	memmove(b->content + offset, b->content + offset + len, used - offset - len);
+	memset(b->content + used - len, 0, len);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Walks every entry of a directory
+ */
+void dir_iter_init(struct fs *fs, struct dir_iter *it, struct inode *dir) {
+	it->fs = fs;
+	it->dir = current_dir(fs, dir);
+	it->bucket = -1;
+	it->last_bucket = it->dir.bloc_count - 1;
+	it->next = BLOC_SIZE;
+	it->b = empty_bloc();
+}
+
+/*
+ * Walks the entries of the bucket of a name only (the name may be in it)
+ */
+void dir_iter_bucket(struct fs *fs, struct dir_iter *it, struct inode *dir, const char *name) {
+	dir_iter_init(fs, it, dir);
+	it->bucket = dir_bucket(&it->dir, name) - 1;
+	it->last_bucket = it->bucket + 1;
+}
+
+/**
+ * Moves to the next entry
+ *
+ * on success : returns 1, the entry is in it
+ * on failure : returns 0 (no entry left)
+ */
+int dir_iter_next(struct dir_iter *it) {
+	unsigned char len;
+
+	for (;;) {
+		if (it->next + (int) DIRENT_HEADER_SIZE <= BLOC_SIZE) {
+			len = (unsigned char) it->b.content[it->next + sizeof(unsigned int)];
+			if (len != 0)
+				break;
+		}
+
+		/* the next bucket */
+		if (it->bucket >= it->last_bucket)
+			return 0;
+
+		it->bucket++;
+		it->b = get_bloc_by_id(it->fs, bmap(it->fs, &it->dir, it->bucket));
+		it->next = 0;
+	}
+
+	it->offset = it->next;
+	memcpy(&it->id, it->b.content + it->offset, sizeof(unsigned int));
+	it->type = (enum filetype) it->b.content[it->offset + sizeof(unsigned int) + 1];
+	it->next = it->offset + DIRENT_HEADER_SIZE + len;
+
+	/* a longer entry (a damaged bucket) is cut */
+	if (len > DIRENT_NAME_MAX)
+		len = DIRENT_NAME_MAX;
+	it->name_len = len;
+	memcpy(it->name, it->b.content + it->offset + DIRENT_HEADER_SIZE, len);
+	it->name[len] = '\0';
+
+	return 1;
+}
+
+/**
+ * Adds a bucket to a directory, the entries of the bucket at the split
+ * point are shared between it and the new one
+ * The blocs are updated, the inode is not written.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no bloc left)
+ */
+int dir_split(struct fs *fs, struct inode *dir) {
+	struct dir_iter it;
+	struct bloc kept, added;
+	unsigned int low, split;
+
+	for (low = 1; low * 2 <= (unsigned int) dir->bloc_count; low *= 2);
+	split = dir->bloc_count - low;
+
+	/* the entries of the bucket at the split point, before it grows */
+	dir_iter_init(fs, &it, dir);
+	it.dir = *dir;
+	it.bucket = split - 1;
+	it.last_bucket = split;
+
+	added = new_bloc("");
+	if (write_bloc(fs, &added) != EXIT_SUCCESS || !add_bloc(fs, dir, &added))
+		return EXIT_FAILURE;
+
+	kept = get_bloc_by_id(fs, bmap(fs, dir, split));
+	memset(kept.content, 0, BLOC_SIZE);
+
+	while (dir_iter_next(&it)) {
+		if ((unsigned int) dir_bucket(dir, it.name) == split)
+			dirent_add(&kept, it.id, it.type, it.name);
+		else
+			dirent_add(&added, it.id, it.type, it.name);
+	}
+
+	update_bloc(fs, &kept);
+
+	return update_bloc(fs, &added);
+}
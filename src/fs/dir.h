@@ -0,0 +1,50 @@
+#ifndef DIR_H
+#define DIR_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "./inode.h"
+#include "./bloc.h"
+
+/* id, name length, type hint */
+#define DIRENT_HEADER_SIZE (sizeof(unsigned int) + 2)
+/* a name and its '\0' fit the path and listing buffers (FILENAME_COUNT) */
+#define DIRENT_NAME_MAX (FILENAME_COUNT - 1)
+
+struct fs;
+
+/*
+ * Walks the entries of a directory, of every bucket or of the bucket of
+ * one name (see dir_iter_init and dir_iter_bucket)
+ *
+ * The current entry is id, type and name. The bucket is copied in b,
+ * offset is where the current entry starts in it (see dirent_remove).
+ */
+struct dir_iter {
+	struct fs *fs;
+	struct inode dir;
+	int bucket;
+	int last_bucket;
+
+	struct bloc b;
+	int offset;
+	int next;
+
+	unsigned int id;
+	enum filetype type;
+	int name_len;
+	char name[DIRENT_NAME_MAX + 1];
+};
+
+int dir_bucket(struct inode *dir, const char *name);
+int dir_iter_next(struct dir_iter *it);
+int dir_split(struct fs *fs, struct inode *dir);
+int dirent_add(struct bloc *b, unsigned int id, enum filetype type, const char *name);
+int dirent_find(const struct bloc *b, const char *name);
+int dirent_remove(struct bloc *b, int offset);
+struct inode current_dir(struct fs *fs, struct inode *dir);
+unsigned int dir_hash(const char *name);
+void dir_iter_bucket(struct fs *fs, struct dir_iter *it, struct inode *dir, const char *name);
+void dir_iter_init(struct fs *fs, struct dir_iter *it, struct inode *dir);
+
+#endif
@@ -0,0 +1,844 @@
+#include "./disk.h"
+#include "./bitmap.h"
+#include "./fs.h"
+
+/*
+ * Offset of the inode slot in the disk
+ */
+long inode_offset(struct superblock *sb, unsigned int slot) {
+	return sb->inode_table + (long) slot * sizeof(struct inode);
+}
+
+/*
+ * Offset of the bloc slot in the disk
+ */
+long bloc_offset(struct superblock *sb, unsigned int slot) {
+	return sb->bloc_region + (long) slot * sizeof(struct bloc);
+}
+
+/**
+ * Checks if an option is in the mount options (MOUNT_OPTIONS_ENV)
+ *
+ * success : 1
+ * failure : 0
+ */
+int mount_option(const char *name) {
+	const char *options;
+	size_t len;
+
+	options = getenv(MOUNT_OPTIONS_ENV);
+	if (options == NULL) return 0;
+
+	len = strlen(name);
+	while (*options != '\0') {
+		if (strncmp(options, name, len) == 0 && (options[len] == ',' || options[len] == '\0'))
+			return 1;
+
+		options = strchr(options, ',');
+		if (options == NULL) return 0;
+		options++;
+	}
+
+	return 0;
+}
+
+/**
+ * Value of a "name=value" mount option
+ *
+ * on success : returns the value
+ * on failure : returns default_value (option missing or not a number)
+ */
+long mount_option_value(const char *name, long default_value) {
+	const char *options;
+	char *end;
+	size_t len;
+	long value;
+
+	options = getenv(MOUNT_OPTIONS_ENV);
+	if (options == NULL) return default_value;
+
+	len = strlen(name);
+	while (*options != '\0') {
+		if (strncmp(options, name, len) == 0 && options[len] == '=') {
+			value = strtol(options + len + 1, &end, 10);
+			if (end != options + len + 1 && (*end == ',' || *end == '\0'))
+				return value;
+		}
+
+		options = strchr(options, ',');
+		if (options == NULL) break;
+		options++;
+	}
+
+	return default_value;
+}
+
+/**
+ * Value of a "name=value" mount option, copied in value (size bytes with
+ * the terminating '\0' at most)
+ *
+ * success : 1
+ * failure : 0 (option missing)
+ */
+int mount_option_text(const char *name, char *value, size_t size) {
+	const char *options, *end;
+	size_t len;
+
+	options = getenv(MOUNT_OPTIONS_ENV);
+	if (options == NULL || size == 0) return 0;
+
+	len = strlen(name);
+	while (*options != '\0') {
+		end = strchr(options, ',');
+		if (end == NULL)
+			end = options + strlen(options);
+
+		if (strncmp(options, name, len) == 0 && options[len] == '=') {
+			snprintf(value, size, "%.*s", (int) (end - options - len - 1), options + len + 1);
+			return 1;
+		}
+
+		if (*end == '\0') break;
+		options = end + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Adds an option to the mount options, the commands started afterwards
+ * inherit it
+ */
+int add_mount_option(const char *name) {
+	const char *options;
+	char *joined;
+	int rst;
+
+	if (mount_option(name)) return EXIT_SUCCESS;
+
+	options = getenv(MOUNT_OPTIONS_ENV);
+	if (options == NULL || *options == '\0')
+		return setenv(MOUNT_OPTIONS_ENV, name, 1) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	joined = (char *) calloc(strlen(options) + strlen(name) + 2, sizeof(char));
+	sprintf(joined, "%s,%s", options, name);
+	rst = setenv(MOUNT_OPTIONS_ENV, joined, 1) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	free(joined);
+
+	return rst;
+}
+
+/*
+ * Maps the disk up to end at least
+ * With extend the file grows (by MAP_GROW steps) to cover end, otherwise
+ * the mapping only follows the file, grown by another process
+ */
+static int remap_disk(struct fs *fs, size_t end, int extend) {
+	struct stat st;
+	size_t size;
+	char *map;
+
+	if (fstat(fs->fd, &st) != 0) return EXIT_FAILURE;
+
+	size = st.st_size;
+	if (extend && size < end) {
+		size = (end + MAP_GROW - 1) / MAP_GROW * MAP_GROW;
+		if (ftruncate(fs->fd, size) != 0) return EXIT_FAILURE;
+	}
+
+	if (size <= fs->map_size) return EXIT_SUCCESS;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fs->fd, 0);
+	if (map == MAP_FAILED) return EXIT_FAILURE;
+
+	if (fs->map != NULL)
+		munmap(fs->map, fs->map_size);
+	fs->map = map;
+	fs->map_size = size;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Pointer to size bytes at an offset of the mapped disk
+ * Valid until the next write grows the mapping
+ *
+ * on success : returns the pointer
+ * on failure : returns NULL (disk not mapped, past the end of the disk)
+ */
+void *disk_map(struct fs *fs, long offset, size_t size) {
+	/* the mapping misses the writes not applied yet there, and the snapshot */
+	if (fs->map == NULL || fs->snapshots.view != NULL || txn_overlaps(&fs->txn, offset, size)) return NULL;
+
+	if (offset + size > fs->map_size
+			&& (remap_disk(fs, offset + size, 0) != EXIT_SUCCESS || offset + size > fs->map_size))
+		return NULL;
+
+	return fs->map + offset;
+}
+
+/**
+ * Reads size bytes at an offset of the disk as they are in the file, past
+ * the transactions and the snapshot mounted
+ * What lies past the end of the file reads as zeros (slots never written)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int disk_read_through(struct fs *fs, long offset, void *buf, size_t size) {
+	ssize_t n;
+	size_t done;
+
+	if (fs->map != NULL && (offset + size <= fs->map_size
+			|| (remap_disk(fs, offset + size, 0) == EXIT_SUCCESS && offset + size <= fs->map_size))) {
+		memcpy(buf, fs->map + offset, size);
+		return EXIT_SUCCESS;
+	}
+
+	/* past the end of the file: pread zero fills */
+
+	done = 0;
+	while (done != size) {
+		n = pread(fs->fd, (char *) buf + done, size - done, offset + done);
+
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0) return EXIT_FAILURE;
+
+		if (n == 0) {
+			memset((char *) buf + done, 0, size - done);
+			break;
+		}
+		done += n;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Reads size bytes at an offset of the disk, with the writes of the
+ * transactions not applied yet, or as they were in the snapshot mounted
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int disk_read(struct fs *fs, long offset, void *buf, size_t size) {
+	if (disk_read_through(fs, offset, buf, size) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	txn_overlay(&fs->txn, offset, buf, size);
+	if (fs->snapshots.view != NULL)
+		snapshot_overlay(fs, offset, buf, size);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Writes size bytes at an offset of the disk in place, past the open
+ * transaction and the journal (see journal.c)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int disk_write_through(struct fs *fs, long offset, const void *buf, size_t size) {
+	ssize_t n;
+	size_t done;
+
+	if (fs->map != NULL) {
+		if (offset + size > fs->map_size && remap_disk(fs, offset + size, 1) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+
+		memcpy(fs->map + offset, buf, size);
+		return EXIT_SUCCESS;
+	}
+
+	done = 0;
+	while (done != size) {
+		n = pwrite(fs->fd, (const char *) buf + done, size - done, offset + done);
+
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return EXIT_FAILURE;
+
+		done += n;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Writes size bytes at an offset of the disk, logged until the commit
+ * when a transaction is open or when it overlaps a write of the journal
+ * not applied yet (so it lands after it)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int disk_write(struct fs *fs, long offset, const void *buf, size_t size) {
+	/* the snapshot mounted is read-only */
+	if (fs->snapshots.view != NULL)
+		return EXIT_FAILURE;
+
+	if (fs->txn.depth > 0 || txn_overlaps(&fs->txn, offset, size))
+		return txn_log(&fs->txn, offset, buf, size);
+
+	return disk_write_through(fs, offset, buf, size);
+}
+
+/**
+ * Writes size bytes of the blocs of a file in place, even when a
+ * transaction is open: only the metadata go through the journal, the
+ * blocs land before the commit that maps them. A write that overlaps a
+ * write of the journal not applied yet is logged (so it lands after it).
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int disk_write_data(struct fs *fs, long offset, const void *buf, size_t size) {
+	/* the snapshot mounted is read-only */
+	if (fs->snapshots.view != NULL)
+		return EXIT_FAILURE;
+
+	if (txn_overlaps(&fs->txn, offset, size))
+		return txn_log(&fs->txn, offset, buf, size);
+
+	return disk_write_through(fs, offset, buf, size);
+}
+
+/**
+ * Writes the dirty superblock, inodes and blocs of the caches back to the
+ * disk, and the transactions of the journal in place
+ * To call before another process (a command) reads the disk
+ */
+int flush_disk(struct fs *fs) {
+	int rst;
+
+	rst = icache_flush(fs);
+	if (bcache_flush(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+	if (fs->sb_dirty && write_superblock(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+	if (journal_sync(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+
+	return rst;
+}
+
+/**
+ * Waits for the written bytes of the disk to be on the device, msync for
+ * the mapped disk, fdatasync otherwise
+ */
+int disk_datasync(struct fs *fs) {
+	if (fs->map != NULL)
+		return msync(fs->map, fs->map_size, MS_SYNC) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	return fdatasync(fs->fd) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/**
+ * Flushes the writes of the session to the file: the caches (flush_disk),
+ * then msync for the mapped disk, fsync otherwise
+ */
+int disk_sync(struct fs *fs) {
+	if (flush_disk(fs) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	if (fs->map != NULL)
+		return msync(fs->map, fs->map_size, MS_SYNC) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	return fsync(fs->fd) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * Reads the superblock at the beginning of the disk
+ */
+static int read_superblock(struct fs *fs) {
+	if (disk_read(fs, 0, &fs->sb, sizeof(struct superblock)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	if (fs->sb.magic != DISK_MAGIC) {
+		fprintf(stderr, "Not a v%d disk, see convert_disk for a v1 one %d\n", DISK_VERSION, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	/* only v1 disks have an upgrade path, any other version is refused as it is */
+	if (fs->sb.version != DISK_VERSION) {
+		fprintf(stderr, "A v%u disk can't be mounted nor upgraded, only v%d disks can %d\n", fs->sb.version, DISK_VERSION, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Writes the superblock at the beginning of the disk
+ * The allocations only mark it dirty, it's written by the outermost
+ * txn_commit and by flush_disk then.
+ */
+int write_superblock(struct fs *fs) {
+	if (disk_write(fs, 0, &fs->sb, sizeof(struct superblock)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	fs->sb_dirty = 0;
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Loads both bitmaps in memory
+ */
+static int load_bitmaps(struct fs *fs) {
+	size_t inode_size, bloc_size;
+
+	free(fs->inode_bitmap);
+	free(fs->bloc_bitmap);
+
+	inode_size = bitmap_words(fs->sb.inode_count) * sizeof(bitmap_word);
+	bloc_size = bitmap_words(fs->sb.bloc_count) * sizeof(bitmap_word);
+	fs->inode_bitmap = (bitmap_word *) malloc(inode_size);
+	fs->bloc_bitmap = (bitmap_word *) malloc(bloc_size);
+
+	if (fs->inode_bitmap == NULL || fs->bloc_bitmap == NULL
+			|| disk_read(fs, fs->sb.inode_bitmap, fs->inode_bitmap, inode_size) != EXIT_SUCCESS
+			|| disk_read(fs, fs->sb.bloc_bitmap, fs->bloc_bitmap, bloc_size) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	/* a crash between an allocation and the superblock write leaves the highs behind */
+	if (used_slots(fs, INODE_FLAG) > fs->sb.inode_high)
+		fs->sb.inode_high = used_slots(fs, INODE_FLAG);
+	if (used_slots(fs, BLOC_FLAG) > fs->sb.bloc_high)
+		fs->sb.bloc_high = used_slots(fs, BLOC_FLAG);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Releases what the mounted disk keeps in memory
+ */
+static void release_disk(struct fs *fs) {
+	if (fs->map != NULL)
+		munmap(fs->map, fs->map_size);
+
+	bcache_free(&fs->bcache);
+	icache_free(&fs->icache);
+	dcache_free(&fs->dcache);
+	txn_free(&fs->txn);
+	snapshot_free(&fs->snapshots);
+	free(fs->inode_bitmap);
+	free(fs->bloc_bitmap);
+	free(fs->path);
+
+	fs->map = NULL;
+	fs->map_size = 0;
+	fs->inode_bitmap = NULL;
+	fs->bloc_bitmap = NULL;
+	fs->path = NULL;
+}
+
+/**
+ * Mounts the disk at path: opens it for the whole session and loads the
+ * superblock and the bitmaps
+ * With the "mmap" mount option the disk is mapped as well
+ * The bloc cache holds "cache=N" blocs (DEFAULT_BCACHE_SIZE by default),
+ * the inode cache "icache=N" inodes (DEFAULT_ICACHE_SIZE by default), the
+ * dentry cache "dcache=N" lookups (DEFAULT_DCACHE_SIZE by default)
+ * The transactions left in the journal by a crash are applied again (see
+ * journal_replay). The syncs follow the "durability=" option (see
+ * durability.c). With "snapshot=NAME" the snapshot is mounted read-only
+ * instead of the disk (see snapshot.c). The idle shell compacts the disk
+ * "compact=N" blocs at a time (see compact.c). One bloc read in
+ * "verify=N" is checked against its checksum (see checksum.c).
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (missing disk, wrong version)
+ */
+int mount_disk(struct fs *fs, const char *path) {
+	memset(fs, 0, sizeof(struct fs));
+
+	fs->fd = open(path, O_RDWR);
+	if (fs->fd < 0) {
+		perror(NO_FILE_ERROR_MESSAGE);
+		return EXIT_FAILURE;
+	}
+
+	if ((mount_option("mmap") && remap_disk(fs, 0, 0) != EXIT_SUCCESS)
+			|| read_superblock(fs) != EXIT_SUCCESS || durability_init(fs) != EXIT_SUCCESS
+			|| journal_replay(fs) != EXIT_SUCCESS
+			|| (fs->journal.replayed > 0 && read_superblock(fs) != EXIT_SUCCESS)
+			|| load_bitmaps(fs) != EXIT_SUCCESS
+			|| bcache_init(&fs->bcache, mount_option_value("cache", DEFAULT_BCACHE_SIZE)) != EXIT_SUCCESS
+			|| icache_init(&fs->icache, mount_option_value("icache", DEFAULT_ICACHE_SIZE)) != EXIT_SUCCESS
+			|| dcache_init(&fs->dcache, mount_option_value("dcache", DEFAULT_DCACHE_SIZE)) != EXIT_SUCCESS
+			|| snapshot_load(fs) != EXIT_SUCCESS || compact_init(fs) != EXIT_SUCCESS
+			|| checksum_init(fs) != EXIT_SUCCESS) {
+		close(fs->fd);
+		release_disk(fs);
+		return EXIT_FAILURE;
+	}
+
+	fs->path = strdup(path);
+	fs->mounted = 1;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Unmounts the disk, the caches are written back and a mapped disk is
+ * synced first
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (not mounted)
+ */
+int unmount_disk(struct fs *fs) {
+	int rst;
+
+	if (!fs->mounted) return EXIT_FAILURE;
+
+	flush_disk(fs);
+	if (fs->map != NULL)
+		disk_sync(fs);
+
+	rst = close(fs->fd) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	release_disk(fs);
+	fs->mounted = 0;
+
+	return rst;
+}
+
+/**
+ * Reloads the superblock, the journal, the bitmaps and the snapshots,
+ * forgets the cached inodes, blocs and lookups
+ * To call when another process (a command) may have written the disk, the
+ * caches must have been flushed before it ran (flush_disk)
+ * A disk replaced by a new image is mounted again.
+ */
+int refresh_disk(struct fs *fs) {
+	unsigned long replayed;
+	struct stat open_st, path_st;
+	char *path;
+	int rst;
+
+	if (!fs->mounted) return EXIT_FAILURE;
+
+	/* the command wrote a new image over the disk (see defrag_disk) */
+	if (fstat(fs->fd, &open_st) == 0 && stat(fs->path, &path_st) == 0
+			&& (open_st.st_ino != path_st.st_ino || open_st.st_dev != path_st.st_dev)) {
+		path = strdup(fs->path);
+		unmount_disk(fs);
+		rst = mount_disk(fs, path);
+		free(path);
+		return rst;
+	}
+
+	bcache_invalidate(&fs->bcache);
+	icache_invalidate(&fs->icache);
+	dcache_invalidate(&fs->dcache);
+	snapshot_free(&fs->snapshots);
+	/* the command may have freed blocs below the files */
+	fs->compact.settled = 0;
+
+	/* the command moved the journal on to another sequence */
+	replayed = fs->journal.replayed;
+	if (read_superblock(fs) != EXIT_SUCCESS || journal_replay(fs) != EXIT_SUCCESS
+			|| (fs->journal.replayed != replayed && read_superblock(fs) != EXIT_SUCCESS)
+			|| load_bitmaps(fs) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	return snapshot_load(fs);
+}
+
+/**
+ * Creates an empty disk (overwrites any file at path)
+ *
+ * The bitmaps, the journal and the inode table are allocated as a hole,
+ * they read as free slots, an empty journal and DELETED inodes
+ */
+int format_disk(const char *path, unsigned int inode_count, unsigned int bloc_count) {
+	struct superblock sb;
+	int fd;
+	int rst;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		perror(NO_FILE_ERROR_MESSAGE);
+		return EXIT_FAILURE;
+	}
+
+	memset(&sb, 0, sizeof(struct superblock));
+	sb.magic = DISK_MAGIC;
+	sb.version = DISK_VERSION;
+	sb.inode_count = inode_count;
+	sb.bloc_count = bloc_count;
+	sb.inode_bitmap = SUPERBLOCK_SIZE;
+	sb.bloc_bitmap = sb.inode_bitmap + bitmap_words(inode_count) * sizeof(bitmap_word);
+	sb.journal = sb.bloc_bitmap + bitmap_words(bloc_count) * sizeof(bitmap_word);
+	sb.journal_size = DEFAULT_JOURNAL_SIZE;
+	sb.inode_table = sb.journal + sb.journal_size;
+	sb.bloc_region = inode_offset(&sb, inode_count);
+
+	rst = EXIT_SUCCESS;
+	if (pwrite(fd, &sb, sizeof(struct superblock), 0) != sizeof(struct superblock)
+			|| init_bitmap(fd, sb.inode_bitmap, inode_count) != EXIT_SUCCESS
+			|| init_bitmap(fd, sb.bloc_bitmap, bloc_count) != EXIT_SUCCESS
+			|| ftruncate(fd, sb.bloc_region) != 0)
+		rst = EXIT_FAILURE;
+
+	close(fd);
+	return rst;
+}
+
+/**
+ * Returns the format version of a disk
+ *
+ * 0 : empty or missing disk
+ * 1 : log of INODE_FLAG/BLOC_FLAG records
+ * DISK_VERSION : current format
+ * -1 : unknown
+ */
+int disk_version(const char *path) {
+	FILE *f;
+	unsigned int header[2];
+	size_t size;
+
+	f = fopen(path, "rb");
+	if (f == NULL) return 0;
+
+	size = fread(header, sizeof(unsigned int), 2, f);
+	fclose(f);
+
+	if (size == 0) return 0;
+	if (size == 2 && header[0] == DISK_MAGIC) return header[1];
+	if (header[0] == (unsigned int) INODE_FLAG || header[0] == (unsigned int) BLOC_FLAG) return 1;
+
+	return -1;
+}
+
+/*
+ * The v1 records of a disk, read by convert_disk
+ */
+struct v1_records {
+	struct inode_v1 *inodes;
+	struct bloc *blocs;
+	unsigned int inode_count;
+	unsigned int bloc_count;
+
+	/* v1 id -> index in inodes or blocs */
+	struct idmap inode_ids;
+	struct idmap bloc_ids;
+};
+
+/*
+ * Reads the live records of a v1 disk, the first record of an id wins
+ * The root inode is moved first so it keeps ROOT_ID
+ */
+static int read_v1_records(FILE *old, struct v1_records *r) {
+	struct inode_v1 i;
+	struct bloc_v1 b;
+	long known;
+	unsigned int z;
+	int flag;
+
+	memset(r, 0, sizeof(struct v1_records));
+
+	/* an unknown flag ends the log: the rest of the file is garbage */
+	while (fread(&flag, sizeof(const int), 1, old) == 1 && (flag == INODE_FLAG || flag == BLOC_FLAG)) {
+		if (flag == INODE_FLAG && fread(&i, sizeof(struct inode_v1), 1, old) == 1) {
+			if (i.id == DELETED || idmap_get(&r->inode_ids, i.id, &known)) continue;
+
+			r->inodes = (struct inode_v1 *) realloc(r->inodes, (r->inode_count + 1) * sizeof(struct inode_v1));
+			r->inodes[r->inode_count] = i;
+			idmap_put(&r->inode_ids, i.id, r->inode_count++);
+		} else if (flag == BLOC_FLAG && fread(&b, sizeof(struct bloc_v1), 1, old) == 1) {
+			if (b.id == DELETED || idmap_get(&r->bloc_ids, b.id, &known)) continue;
+
+			r->blocs = (struct bloc *) realloc(r->blocs, (r->bloc_count + 1) * sizeof(struct bloc));
+			r->blocs[r->bloc_count].id = b.id;
+			r->blocs[r->bloc_count].length = strnlen(b.content, BLOC_SIZE);
+			memcpy(r->blocs[r->bloc_count].content, b.content, BLOC_SIZE);
+			idmap_put(&r->bloc_ids, b.id, r->bloc_count++);
+		} else {
+			perror("Houston there's a problem with the <disk>");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (idmap_get(&r->inode_ids, ROOT_ID, &known) && known != 0) {
+		i = r->inodes[0];
+		r->inodes[0] = r->inodes[known];
+		r->inodes[known] = i;
+	}
+
+	idmap_clear(&r->inode_ids);
+	for (z = 0; z != r->inode_count; z++)
+		idmap_put(&r->inode_ids, r->inodes[z].id, z);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Rewrites the "id:name," entries of a v1 directory bloc as entries of a
+ * bucket (see dir.c) with the new ids (index + 1), the entries of unknown
+ * inodes are dropped
+ */
+static void renumber_entries(struct v1_records *r, struct bloc *b) {
+	struct bloc bucket;
+	char name[BLOC_SIZE];
+	char *entry, *colon, *comma;
+	unsigned long id;
+	long index;
+
+	bucket = empty_bloc();
+	entry = b->content;
+
+	while ((colon = strchr(entry, ':')) != NULL && (comma = strchr(colon, ',')) != NULL) {
+		id = strtoul(entry, NULL, 10);
+		snprintf(name, BLOC_SIZE, "%.*s", (int) (comma - colon - 1), colon + 1);
+
+		if (idmap_get(&r->inode_ids, id, &index)
+				&& dirent_add(&bucket, index + 1, r->inodes[index].type, name) != EXIT_SUCCESS)
+			fprintf(stderr, "Directory's full, %s dropped %d\n", name, __LINE__);
+
+		entry = comma + 1;
+	}
+
+	memcpy(b->content, bucket.content, BLOC_SIZE);
+}
+
+/*
+ * Moves the bytes of the blocs of a v1 file (BLOC_SIZE - 1 a bloc at most)
+ * to the front, so every bloc but the last is full as iread_at expects.
+ * The file stops at its last bloc with data: the blocs emptied at the end
+ * are DELETED, write_v1_records drops them.
+ */
+static void repack_v1_file(struct v1_records *r, struct inode_v1 *i) {
+	char bytes[V1_BLOC_IDS_COUNT * BLOC_SIZE];
+	size_t size, pos, len;
+	unsigned int j, kept;
+	long index;
+
+	size = 0;
+	for (j = 0; j < (unsigned int) i->bloc_count && j != V1_BLOC_IDS_COUNT; j++) {
+		if (idmap_get(&r->bloc_ids, i->bloc_ids[j], &index)) {
+			memcpy(bytes + size, r->blocs[index].content, r->blocs[index].length);
+			size += r->blocs[index].length;
+		}
+	}
+
+	pos = 0;
+	kept = 0;
+	for (j = 0; j < (unsigned int) i->bloc_count && j != V1_BLOC_IDS_COUNT; j++) {
+		if (!idmap_get(&r->bloc_ids, i->bloc_ids[j], &index)) continue;
+
+		if (pos == size) {
+			r->blocs[index].id = DELETED;
+			continue;
+		}
+
+		len = size - pos < BLOC_SIZE ? size - pos : BLOC_SIZE;
+		memset(r->blocs[index].content, 0, BLOC_SIZE);
+		memcpy(r->blocs[index].content, bytes + pos, len);
+		r->blocs[index].length = len;
+		pos += len;
+		kept = j + 1;
+	}
+	i->bloc_count = (int) kept;
+}
+
+/*
+ * Writes the v1 records in a fresh disk, the blocs first so the inodes
+ * can point at their new ids, the ones DELETED by repack_v1_file are
+ * dropped
+ * A fresh disk gives the slots in order: the new id of an inode is its
+ * index + 1
+ */
+static int write_v1_records(struct fs *fs, struct v1_records *r) {
+	struct inode i;
+	unsigned int slot, z, j;
+	long index;
+
+	for (z = 0; z != r->inode_count; z++) {
+		if (r->inodes[z].type == DIRECTORY && r->inodes[z].bloc_count > 0
+				&& idmap_get(&r->bloc_ids, r->inodes[z].bloc_ids[0], &index))
+			renumber_entries(r, &r->blocs[index]);
+		else if (r->inodes[z].type != DIRECTORY)
+			repack_v1_file(r, &r->inodes[z]);
+	}
+
+	for (z = 0; z != r->bloc_count; z++) {
+		if (r->blocs[z].id == DELETED) continue;
+		if (alloc_slot(fs, BLOC_FLAG, &slot) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+		r->blocs[z].id = slot + 1;
+		bloc_seal(&r->blocs[z]);
+		if (disk_write(fs, bloc_offset(&fs->sb, slot), &r->blocs[z], sizeof(struct bloc)) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+	}
+
+	for (z = 0; z != r->inode_count; z++) {
+		/* the v1 times were pointers, not times: the inodes are created now */
+		i = new_inode(r->inodes[z].type, r->inodes[z].permissions, r->inodes[z].user_name, r->inodes[z].group_name);
+
+		for (j = 0; j < (unsigned int) r->inodes[z].bloc_count && j != V1_BLOC_IDS_COUNT; j++) {
+			if (idmap_get(&r->bloc_ids, r->inodes[z].bloc_ids[j], &index)) {
+				add_bloc(fs, &i, &r->blocs[index]);
+				if (i.type != DIRECTORY)
+					i.size += r->blocs[index].length;
+			}
+		}
+
+		if (alloc_slot(fs, INODE_FLAG, &slot) != EXIT_SUCCESS || slot != z) return EXIT_FAILURE;
+
+		i.id = slot + 1;
+		if (disk_write(fs, inode_offset(&fs->sb, slot), &i, sizeof(struct inode)) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Upgrades a v1 disk (log of records) to the current format
+ * Deleted records are dropped. The ids are given again (an id is its
+ * slot), the bloc lists of the inodes and the directory entries follow.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE, the v1 disk is left untouched
+ */
+int convert_disk(const char *path) {
+	FILE *old;
+	struct fs fs;
+	struct v1_records r;
+	char *tmp_path;
+	int rst;
+
+	if (disk_version(path) != 1) {
+		fprintf(stderr, "Not a v1 disk %d\n", __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	old = fopen(path, "rb");
+	if (old == NULL) return EXIT_FAILURE;
+
+	rst = read_v1_records(old, &r);
+	fclose(old);
+
+	tmp_path = (char *) calloc(strlen(path) + 5, sizeof(char));
+	sprintf(tmp_path, "%s.new", path);
+
+	if (rst == EXIT_SUCCESS && format_disk(tmp_path, DEFAULT_INODE_COUNT, DEFAULT_BLOC_COUNT) == EXIT_SUCCESS
+			&& mount_disk(&fs, tmp_path) == EXIT_SUCCESS) {
+		rst = write_v1_records(&fs, &r);
+		unmount_disk(&fs);
+	} else {
+		rst = EXIT_FAILURE;
+	}
+
+	if (rst == EXIT_SUCCESS)
+		rst = rename(tmp_path, path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	else
+		remove(tmp_path);
+
+	free(r.inodes);
+	free(r.blocs);
+	idmap_free(&r.inode_ids);
+	idmap_free(&r.bloc_ids);
+	free(tmp_path);
+	return rst;
+}
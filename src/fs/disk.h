@@ -0,0 +1,184 @@
+#ifndef DISK_H
+#define DISK_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "./inode.h"
+#include "./bloc.h"
+#include "./idmap.h"
+#include "./bitmap.h"
+#include "./bcache.h"
+#include "./icache.h"
+#include "./dcache.h"
+#include "./txn.h"
+#include "./journal.h"
+#include "./durability.h"
+#include "./compact.h"
+#include "./snapshot.h"
+#include "./checksum.h"
+
+#define DISK_MAGIC (0x44535953) /* "SYSD" */
+#define DISK_VERSION (12)
+#define SUPERBLOCK_SIZE (512)
+#define DEFAULT_INODE_COUNT (4096)
+#define DEFAULT_BLOC_COUNT (16384)
+
+/* comma separated mount options, inherited by the commands */
+#define MOUNT_OPTIONS_ENV "SYSD_MOUNT_OPTS"
+/* the mapped disk grows by this much at a time */
+#define MAP_GROW (1 << 20)
+/* bloc ids of a v1 inode */
+#define V1_BLOC_IDS_COUNT (10)
+
+/*
+ * Layout of the disk :
+ *
+ * [superblock][inode bitmap][bloc bitmap][journal: journal_size bytes]
+ * [inode table: inode_count inodes][bloc region: bloc_count blocs]
+ *
+ * Every slot has a fixed size, so the slot N of the inode table or of the
+ * bloc region is found by arithmetic. A bit set in a bitmap marks a slot
+ * in use (see bitmap.c). The file only grows as far as the highest slot
+ * used (the "high" marks).
+ *
+ * The id of an inode or of a bloc is its slot + 1 (0 is DELETED): ids are
+ * direct indexes, the bitmaps hand out the freed ids again before the
+ * ones above the high marks. Each bloc carries its checksum.
+ */
+struct superblock {
+	unsigned int magic;
+	unsigned int version;
+
+	unsigned int inode_count;
+	unsigned int bloc_count;
+
+	/* first slot never used */
+	unsigned int inode_high;
+	unsigned int bloc_high;
+
+	/* bitmap word where the next allocation starts looking */
+	unsigned int inode_hint;
+	unsigned int bloc_hint;
+
+	long inode_bitmap;
+	long bloc_bitmap;
+	long journal;
+	unsigned int journal_size;
+
+	/* head bloc of the last snapshot taken (see snapshot.c) */
+	unsigned int snapshots;
+	/* inode of the share table, DELETED until a copy (see share.c) */
+	unsigned int shares;
+	long inode_table;
+	long bloc_region;
+};
+
+/*
+ * An inode as written by the v1 disks (1 byte ids), see convert_disk
+ */
+struct inode_v1 {
+	unsigned char id;
+
+	enum filetype type;
+	mode_t permissions;
+
+	char user_name[USERNAME_COUNT];
+	char group_name[GROUPNAME_COUNT];
+
+	/* addresses in the process that wrote the disk, never to be read */
+	const struct tm *created_at;
+	struct tm *updated_at;
+
+	unsigned int bloc_ids[V1_BLOC_IDS_COUNT];
+	int bloc_count;
+};
+
+/*
+ * A bloc as written by the v1 disks (a '\0' terminated content)
+ */
+struct bloc_v1 {
+	unsigned int id;
+
+	char content[BLOC_SIZE];
+};
+
+/*
+ * A mounted disk
+ *
+ * Owns the file descriptor of the disk for the whole session, and what is
+ * kept in memory between two primitives: the superblock and the bitmaps.
+ * Every primitive of the file system takes it.
+ *
+ * With the "mmap" mount option the disk is mapped in memory: reads and
+ * writes become plain copies in the mapping, and blocs can be read in
+ * place (see bloc_ref).
+ *
+ * The blocs go through a cache of "cache=N" blocs (see bcache.c), the
+ * inodes through a cache of "icache=N" inodes (see icache.c), the name
+ * lookups through a cache of "dcache=N" lookups (see dcache.c).
+ *
+ * The writes of a metadata operation are grouped in a transaction (see
+ * txn.c), written ahead in the journal (see journal.c). When the writes
+ * reach the device is the durability (see durability.c).
+ *
+ * The snapshots of the disk are kept in memory, with "snapshot=NAME" one
+ * of them is mounted read-only instead of the disk (see snapshot.c).
+ *
+ * The blocs read from the disk are checked against their checksums, one
+ * in "verify=N" (see checksum.c).
+ */
+struct fs {
+	int mounted;
+	int fd;
+	char *path;
+
+	struct superblock sb;
+	/* the hints or the highs changed since the superblock was written */
+	int sb_dirty;
+	bitmap_word *inode_bitmap;
+	bitmap_word *bloc_bitmap;
+
+	char *map;
+	size_t map_size;
+
+	struct bcache bcache;
+	struct icache icache;
+	struct dcache dcache;
+	struct txn txn;
+	struct journal journal;
+	struct durability durability;
+	struct snapshots snapshots;
+	struct compact compact;
+	struct checksums checksums;
+};
+
+int add_mount_option(const char *name);
+int convert_disk(const char *path);
+int disk_datasync(struct fs *fs);
+int disk_read(struct fs *fs, long offset, void *buf, size_t size);
+int disk_read_through(struct fs *fs, long offset, void *buf, size_t size);
+int disk_sync(struct fs *fs);
+int disk_version(const char *path);
+int disk_write(struct fs *fs, long offset, const void *buf, size_t size);
+int disk_write_data(struct fs *fs, long offset, const void *buf, size_t size);
+int disk_write_through(struct fs *fs, long offset, const void *buf, size_t size);
+int flush_disk(struct fs *fs);
+int format_disk(const char *path, unsigned int inode_count, unsigned int bloc_count);
+int mount_disk(struct fs *fs, const char *path);
+int mount_option(const char *name);
+int mount_option_text(const char *name, char *value, size_t size);
+long mount_option_value(const char *name, long default_value);
+int refresh_disk(struct fs *fs);
+int unmount_disk(struct fs *fs);
+int write_superblock(struct fs *fs);
+long bloc_offset(struct superblock *sb, unsigned int slot);
+long inode_offset(struct superblock *sb, unsigned int slot);
+void *disk_map(struct fs *fs, long offset, size_t size);
+
+#endif
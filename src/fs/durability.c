@@ -0,0 +1,112 @@
+#include "./durability.h"
+#include "./fs.h"
+
+/*
+ * Milliseconds of a monotonic clock
+ */
+static long now_ms() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/**
+ * Reads the durability of the mount options, DURABILITY_JOURNAL by default
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (not a positive interval)
+ */
+int durability_init(struct fs *fs) {
+	memset(&fs->durability, 0, sizeof(struct durability));
+
+	fs->durability.mode = DURABILITY_JOURNAL;
+	if (mount_option("durability=none"))
+		fs->durability.mode = DURABILITY_NONE;
+	else if (mount_option("durability=periodic"))
+		fs->durability.mode = DURABILITY_PERIODIC;
+	else if (mount_option("durability=sync"))
+		fs->durability.mode = DURABILITY_SYNC;
+
+	fs->durability.interval = mount_option_value("flush_interval", DEFAULT_FLUSH_INTERVAL);
+	fs->durability.last = now_ms();
+
+	return fs->durability.interval > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * The name of a durability, as in the mount options
+ */
+const char *durability_name(enum durability_mode mode) {
+	switch (mode) {
+		case DURABILITY_NONE: return "none";
+		case DURABILITY_PERIODIC: return "periodic";
+		case DURABILITY_SYNC: return "sync";
+		default: return "journal";
+	}
+}
+
+/*
+ * Writes the dirty cached inodes and blocs back and syncs the disk
+ * The transactions of the journal are durable once it's synced, they are
+ * left to the next checkpoint.
+ */
+static int sync_now(struct fs *fs) {
+	int rst;
+
+	rst = icache_flush(fs);
+	if (bcache_flush(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+	if (disk_datasync(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+
+	fs->durability.syncs++;
+	fs->durability.last = now_ms();
+
+	return rst;
+}
+
+/*
+ * A call of the file system starts (see durable_end)
+ */
+void durable_begin(struct fs *fs) {
+	fs->durability.depth++;
+}
+
+/**
+ * Syncs the disk with "durability=periodic" once the interval went by
+ * To call between two calls of the file system (see the shell loop)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (write error)
+ */
+int durable_tick(struct fs *fs) {
+	if (fs->durability.mode != DURABILITY_PERIODIC || fs->durability.depth > 0
+			|| fs->txn.depth > 0 || now_ms() - fs->durability.last < fs->durability.interval)
+		return EXIT_SUCCESS;
+
+	return sync_now(fs);
+}
+
+/**
+ * A call of the file system ends with rst. The outermost one syncs the
+ * disk with "durability=sync", or when the interval went by with
+ * "durability=periodic".
+ *
+ * on success : returns rst
+ * on failure : returns EXIT_FAILURE (the sync failed)
+ */
+int durable_end(struct fs *fs, int rst) {
+	if (fs->durability.depth > 0)
+		fs->durability.depth--;
+	if (fs->durability.depth > 0 || fs->txn.depth > 0)
+		return rst;
+
+	if (fs->durability.mode == DURABILITY_SYNC && sync_now(fs) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	if (durable_tick(fs) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	return rst;
+}
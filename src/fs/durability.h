@@ -0,0 +1,50 @@
+#ifndef DURABILITY_H
+#define DURABILITY_H
+
+#include <stdlib.h>
+#include <time.h>
+
+/* ms between two syncs with "durability=periodic", see "flush_interval=N" */
+#define DEFAULT_FLUSH_INTERVAL (1000)
+
+/*
+ * When the writes of a mounted disk reach the device
+ *
+ * DURABILITY_NONE     "durability=none": never synced, not even by the
+ *                     checkpoints of the journal
+ * DURABILITY_JOURNAL  the default: only the checkpoints of the journal sync
+ * DURABILITY_PERIODIC "durability=periodic": a flush and a sync once
+ *                     "flush_interval=N" ms went by since the last one
+ * DURABILITY_SYNC     "durability=sync": a flush and a sync after each call
+ */
+enum durability_mode {
+	DURABILITY_NONE,
+	DURABILITY_JOURNAL,
+	DURABILITY_PERIODIC,
+	DURABILITY_SYNC
+};
+
+/*
+ * The durability of a mounted disk
+ *
+ * depth counts the calls in progress (see durable_begin), only the
+ * outermost one syncs. last is the time of the last sync in ms.
+ */
+struct durability {
+	enum durability_mode mode;
+	long interval;
+	long last;
+	int depth;
+
+	unsigned long syncs;
+};
+
+struct fs;
+
+const char *durability_name(enum durability_mode mode);
+int durability_init(struct fs *fs);
+int durable_end(struct fs *fs, int rst);
+int durable_tick(struct fs *fs);
+void durable_begin(struct fs *fs);
+
+#endif
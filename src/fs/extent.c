@@ -0,0 +1,637 @@
+#include "./extent.h"
+#include "./fs.h"
+
+/**
+ * Returns every extent of a file: the ones kept in the inode, then the
+ * ones of the chain of extent blocs
+ *
+ * note: don't forget to free the array
+ * on failure: returns NULL (no extent, broken chain)
+ */
+struct extent *get_extents(struct fs *fs, struct inode *i) {
+	struct extent *extents;
+	struct bloc tmp;
+	const struct bloc *b;
+	const struct extent_bloc *eb;
+	unsigned int id, count;
+	int z;
+
+	if (i->extent_count == 0) return NULL;
+
+	extents = (struct extent *) calloc(i->extent_count, sizeof(struct extent));
+	if (extents == NULL) return NULL;
+
+	for (z = 0; z != i->extent_count && z != EXTENT_COUNT; z++)
+		extents[z] = i->extents[z];
+
+	id = i->overflow;
+	while (z != i->extent_count && id != DELETED) {
+		b = bloc_ref(fs, id, &tmp);
+		if (b == NULL) break;
+
+		eb = (const struct extent_bloc *) b->content;
+		count = eb->count;
+		if (count > (unsigned int) (i->extent_count - z))
+			count = i->extent_count - z;
+
+		memcpy(extents + z, eb->extents, count * sizeof(struct extent));
+		z += count;
+		id = eb->next;
+	}
+
+	if (z != i->extent_count) {
+		fprintf(stderr, "Broken extent chain %d\n", __LINE__);
+		free(extents);
+		return NULL;
+	}
+
+	return extents;
+}
+
+/**
+ * Maps the nth bloc of a file to its bloc id
+ *
+ * on failure: returns DELETED (n is out of the file)
+ */
+unsigned int bmap(struct fs *fs, struct inode *i, int n) {
+	struct bloc tmp;
+	const struct bloc *b;
+	const struct extent_bloc *eb;
+	unsigned int id, k;
+	int z;
+
+	if (n < 0 || n >= i->bloc_count) return DELETED;
+
+	/* the first extents are in the inode, no bloc to read */
+	for (z = 0; z != i->extent_count && z != EXTENT_COUNT; z++) {
+		if ((unsigned int) n < i->extents[z].length)
+			return i->extents[z].start + n;
+		n -= i->extents[z].length;
+	}
+
+	/* the chain is walked in place up to the extent of the bloc, nothing copied */
+	id = i->overflow;
+	while (z != i->extent_count && id != DELETED) {
+		b = bloc_ref(fs, id, &tmp);
+		if (b == NULL) return DELETED;
+
+		eb = (const struct extent_bloc *) b->content;
+		for (k = 0; k != eb->count && z != i->extent_count; k++, z++) {
+			if ((unsigned int) n < eb->extents[k].length)
+				return eb->extents[k].start + n;
+			n -= eb->extents[k].length;
+		}
+		id = eb->next;
+	}
+
+	return DELETED;
+}
+
+/*
+ * The slot right after the last bloc of a file, where the file grows in
+ * place (see alloc_run)
+ */
+unsigned int extent_goal(struct fs *fs, struct inode *i) {
+	unsigned int last;
+
+	last = bmap(fs, i, i->bloc_count - 1);
+	if (last == DELETED)
+		return NO_GOAL;
+
+	/* the slot of an id is id - 1, the next one is id */
+	return last;
+}
+
+/**
+ * Appends a run of blocs to the mapping of a file, merged with the last
+ * extent when the run follows it
+ * The extents past the ones of the inode go in the last extent bloc, a
+ * new one is chained when it's full. The inode itself is not written.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no bloc left for an extent bloc)
+ */
+int extent_append(struct fs *fs, struct inode *i, unsigned int start, unsigned int length) {
+	struct bloc b, next;
+	struct extent_bloc *eb;
+	struct extent *last;
+	unsigned int id;
+
+	if (length == 0) return EXIT_SUCCESS;
+
+	if (i->extent_count > 0 && i->extent_count <= EXTENT_COUNT) {
+		last = &i->extents[i->extent_count - 1];
+		if (last->start + last->length == start) {
+			last->length += length;
+			i->bloc_count += length;
+			return EXIT_SUCCESS;
+		}
+	}
+
+	if (i->extent_count < EXTENT_COUNT) {
+		i->extents[i->extent_count].start = start;
+		i->extents[i->extent_count].length = length;
+		i->extent_count++;
+		i->bloc_count += length;
+		return EXIT_SUCCESS;
+	}
+
+	/* the last extent bloc of the chain */
+	b = empty_bloc();
+	eb = (struct extent_bloc *) b.content;
+	for (id = i->overflow; id != DELETED; id = eb->next) {
+		b = get_bloc_by_id(fs, id);
+		eb = (struct extent_bloc *) b.content;
+	}
+
+	if (b.id != DELETED && eb->count > 0) {
+		last = &eb->extents[eb->count - 1];
+		if (last->start + last->length == start) {
+			last->length += length;
+			i->bloc_count += length;
+			return update_bloc(fs, &b);
+		}
+	}
+
+	if (b.id == DELETED || eb->count == EXTENTS_PER_BLOC) {
+		next = new_bloc(NULL);
+		if (write_bloc(fs, &next) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+
+		if (b.id == DELETED) {
+			i->overflow = next.id;
+		} else {
+			eb->next = next.id;
+			update_bloc(fs, &b);
+		}
+
+		b = next;
+		eb = (struct extent_bloc *) b.content;
+	}
+
+	eb->extents[eb->count].start = start;
+	eb->extents[eb->count].length = length;
+	eb->count++;
+	i->extent_count++;
+	i->bloc_count += length;
+
+	return update_bloc(fs, &b);
+}
+
+/*
+ * Frees a run of blocs, their cached copies are dropped
+ * A bloc shared with another file loses a share instead (see copy_file).
+ */
+static int free_blocs(struct fs *fs, unsigned int start, unsigned int count) {
+	unsigned int j, from;
+	int rst;
+
+	rst = EXIT_SUCCESS;
+	for (j = 0, from = 0; j != count; j++) {
+		if (share_get(fs, start + j) == 0) {
+			bcache_drop(&fs->bcache, start + j);
+			continue;
+		}
+
+		if (j != from && free_run(fs, BLOC_FLAG, start + from - 1, j - from) != EXIT_SUCCESS)
+			rst = EXIT_FAILURE;
+		if (share_add(fs, start + j, 1, -1) != EXIT_SUCCESS)
+			rst = EXIT_FAILURE;
+		from = j + 1;
+	}
+
+	if (count != from && free_run(fs, BLOC_FLAG, start + from - 1, count - from) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+
+	return rst;
+}
+
+/*
+ * Deletes a chain of extent blocs
+ */
+static void free_chain(struct fs *fs, unsigned int id) {
+	struct bloc b;
+
+	while (id != DELETED) {
+		b = get_bloc_by_id(fs, id);
+		id = ((struct extent_bloc *) b.content)->next;
+		delete_bloc(fs, &b);
+	}
+}
+
+/*
+ * Maps a file to a list of extents again: the extents given are appended
+ * in a new chain of extent blocs, the old chain is freed once they all
+ * are (as extent_truncate does)
+ *
+ * on failure : the inode maps its old extents, nothing is freed
+ */
+static int remap(struct fs *fs, struct inode *i, struct extent *extents, int count) {
+	struct inode old;
+	int z;
+
+	old = *i;
+	i->extent_count = 0;
+	i->overflow = DELETED;
+	i->bloc_count = 0;
+
+	for (z = 0; z != count; z++) {
+		if (extent_append(fs, i, extents[z].start, extents[z].length) != EXIT_SUCCESS) {
+			fprintf(stderr, "No bloc left for the extents %d\n", __LINE__);
+			free_chain(fs, i->overflow);
+			*i = old;
+			return EXIT_FAILURE;
+		}
+	}
+
+	free_chain(fs, old.overflow);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Appends a run to a list of extents, the list grows as needed
+ */
+static int push_run(struct extent **list, int *len, int *size, unsigned int start, unsigned int length) {
+	struct extent *grown;
+
+	if (*len == *size) {
+		grown = (struct extent *) realloc(*list, *size * 2 * sizeof(struct extent));
+		if (grown == NULL) return EXIT_FAILURE;
+		*list = grown;
+		*size *= 2;
+	}
+
+	(*list)[*len].start = start;
+	(*list)[(*len)++].length = length;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Copies a run of shared blocs to new blocs, appended to list (runs of
+ * new blocs, as they can be allocated)
+ * The run keeps its share until the file maps the copies (see
+ * extent_unshare).
+ */
+static int unshare_run(struct fs *fs, unsigned int start, unsigned int count, struct extent **list, int *len, int *size) {
+	struct bloc *run;
+	const struct bloc *refs[EXTENT_IO_BLOCS];
+	unsigned int done, slot, got, j;
+	int rst;
+
+	run = (struct bloc *) malloc(EXTENT_IO_BLOCS * sizeof(struct bloc));
+	if (run == NULL) return EXIT_FAILURE;
+
+	rst = EXIT_SUCCESS;
+	for (done = 0; rst == EXIT_SUCCESS && done != count; done += got) {
+		got = count - done < EXTENT_IO_BLOCS ? count - done : EXTENT_IO_BLOCS;
+		if (alloc_run(fs, BLOC_FLAG, *len > 0 ? (*list)[*len - 1].start + (*list)[*len - 1].length - 1 : NO_GOAL,
+				got, &slot, &got) != EXIT_SUCCESS
+				|| read_extent(fs, start + done, got, run, refs) != EXIT_SUCCESS) {
+			fprintf(stderr, "No bloc left %d\n", __LINE__);
+			rst = EXIT_FAILURE;
+			break;
+		}
+
+		for (j = 0; j != got; j++) {
+			if (refs[j] != &run[j])
+				run[j] = *refs[j];
+		}
+
+		rst = write_extent(fs, slot + 1, run, got);
+		if (rst == EXIT_SUCCESS)
+			rst = push_run(list, len, size, slot + 1, got);
+	}
+	free(run);
+
+	return rst;
+}
+
+/**
+ * Gives a file blocs of its own for its blocs first to last (the nth ones)
+ * which are shared with other files: they are copied to new blocs, the
+ * shared ones lose a share. Nothing is done when no bloc was ever shared.
+ * The inode itself is not written.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no bloc left, broken chain)
+ */
+int extent_unshare(struct fs *fs, struct inode *i, unsigned int first, unsigned int last) {
+	struct extent *extents, *list, *shared, *copies;
+	unsigned int logical, j, from;
+	int z, len, size, shared_len, shared_size, copies_len, copies_size, before, changed, rst;
+
+	if (fs->sb.shares == DELETED || i->bloc_count == 0) return EXIT_SUCCESS;
+
+	extents = get_extents(fs, i);
+	if (extents == NULL) return EXIT_FAILURE;
+
+	size = i->extent_count + 2;
+	shared_size = 2;
+	copies_size = 2;
+	list = (struct extent *) malloc(size * sizeof(struct extent));
+	shared = (struct extent *) malloc(shared_size * sizeof(struct extent));
+	copies = (struct extent *) malloc(copies_size * sizeof(struct extent));
+	if (list == NULL || shared == NULL || copies == NULL) {
+		free(extents);
+		free(list);
+		free(shared);
+		free(copies);
+		return EXIT_FAILURE;
+	}
+
+	/* the runs kept as they are, the shared runs of the range copied */
+	rst = EXIT_SUCCESS;
+	len = 0;
+	shared_len = 0;
+	copies_len = 0;
+	changed = 0;
+	logical = 0;
+	for (z = 0; rst == EXIT_SUCCESS && z != i->extent_count; z++) {
+		for (j = 0; rst == EXIT_SUCCESS && j != extents[z].length;) {
+			from = j;
+			if (logical + j >= first && logical + j <= last && share_get(fs, extents[z].start + j) > 0) {
+				while (j != extents[z].length && logical + j <= last && share_get(fs, extents[z].start + j) > 0)
+					j++;
+				before = len;
+				rst = unshare_run(fs, extents[z].start + from, j - from, &list, &len, &size);
+				/* the copies made, kept apart to be freed if the file can't map them */
+				for (; before != len; before++) {
+					if (push_run(&copies, &copies_len, &copies_size, list[before].start, list[before].length) != EXIT_SUCCESS)
+						rst = EXIT_FAILURE;
+				}
+				if (rst == EXIT_SUCCESS)
+					rst = push_run(&shared, &shared_len, &shared_size, extents[z].start + from, j - from);
+				changed = 1;
+				continue;
+			}
+
+			while (j != extents[z].length && !(logical + j >= first && logical + j <= last
+					&& share_get(fs, extents[z].start + j) > 0))
+				j++;
+
+			rst = push_run(&list, &len, &size, extents[z].start + from, j - from);
+		}
+		logical += extents[z].length;
+	}
+	free(extents);
+
+	/* the shared runs lose a share once the file maps the copies */
+	if (rst == EXIT_SUCCESS && changed)
+		rst = remap(fs, i, list, len);
+	for (z = 0; rst == EXIT_SUCCESS && z != shared_len; z++)
+		rst = share_add(fs, shared[z].start, shared[z].length, -1);
+	for (z = 0; rst != EXIT_SUCCESS && z != copies_len; z++)
+		free_run(fs, BLOC_FLAG, copies[z].start - 1, copies[z].length);
+	free(list);
+	free(shared);
+	free(copies);
+
+	return rst;
+}
+
+/*
+ * The number of blocs from start, up to count, which no other file shares
+ */
+static unsigned int unshared_blocs(struct fs *fs, unsigned int start, unsigned int count) {
+	unsigned int j;
+
+	if (fs->sb.shares == DELETED) return count;
+
+	for (j = 0; j != count && share_get(fs, start + j) == 0; j++);
+
+	return j;
+}
+
+/**
+ * Moves the blocs of a file down to the lowest free runs below them, at
+ * most budget blocs, the number moved is stored
+ * A run moves to a free run of its length, or of EXTENT_MOVE_MIN blocs
+ * at least, so the file isn't cut in pieces. A shared bloc stays where
+ * the other files map it. The inode itself is not written.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (broken chain), nothing moved
+ */
+int extent_move(struct fs *fs, struct inode *i, unsigned int budget, unsigned int *moved) {
+	struct extent *extents, *list, *from, *to;
+	struct bloc *run;
+	const struct bloc *refs[EXTENT_IO_BLOCS];
+	unsigned int start, length, want, least, slot, got, j;
+	int z, len, size, count, rst;
+
+	*moved = 0;
+	if (i->bloc_count == 0 || budget == 0) return EXIT_SUCCESS;
+
+	extents = get_extents(fs, i);
+	if (extents == NULL) return EXIT_FAILURE;
+
+	size = i->extent_count + 2;
+	list = (struct extent *) malloc(size * sizeof(struct extent));
+	from = (struct extent *) malloc(budget * sizeof(struct extent));
+	to = (struct extent *) malloc(budget * sizeof(struct extent));
+	run = (struct bloc *) malloc(EXTENT_IO_BLOCS * sizeof(struct bloc));
+	if (list == NULL || from == NULL || to == NULL || run == NULL) {
+		free(extents);
+		free(list);
+		free(from);
+		free(to);
+		free(run);
+		return EXIT_FAILURE;
+	}
+
+	/* the runs kept and the runs moved, from where to where */
+	rst = EXIT_SUCCESS;
+	len = 0;
+	count = 0;
+	for (z = 0; rst == EXIT_SUCCESS && z != i->extent_count; z++) {
+		start = extents[z].start;
+		length = extents[z].length;
+		while (rst == EXIT_SUCCESS && length > 0) {
+			want = length < EXTENT_IO_BLOCS ? length : EXTENT_IO_BLOCS;
+			if (want > budget - *moved)
+				want = budget - *moved;
+			want = unshared_blocs(fs, start, want);
+
+			least = want < EXTENT_MOVE_MIN ? want : EXTENT_MOVE_MIN;
+			while (want > least && !lowest_free_run(fs, BLOC_FLAG, want, start - 1, &slot))
+				want = want / 2 > least ? want / 2 : least;
+
+			if (want == 0 || !lowest_free_run(fs, BLOC_FLAG, want, start - 1, &slot)) {
+				/* the bloc stays, or the rest of the extent */
+				got = want == 0 && *moved != budget ? 1 : length;
+				rst = push_run(&list, &len, &size, start, got);
+				start += got;
+				length -= got;
+				continue;
+			}
+
+			if (alloc_run(fs, BLOC_FLAG, slot, want, &slot, &got) != EXIT_SUCCESS
+					|| read_extent(fs, start, got, run, refs) != EXIT_SUCCESS) {
+				rst = EXIT_FAILURE;
+				break;
+			}
+
+			for (j = 0; j != got; j++) {
+				if (refs[j] != &run[j])
+					run[j] = *refs[j];
+			}
+
+			from[count].start = start;
+			from[count].length = got;
+			to[count].start = slot + 1;
+			to[count++].length = got;
+
+			rst = write_extent(fs, slot + 1, run, got);
+			if (rst == EXIT_SUCCESS)
+				rst = push_run(&list, &len, &size, slot + 1, got);
+			start += got;
+			length -= got;
+			*moved += got;
+		}
+	}
+	free(extents);
+	free(run);
+
+	/* the file maps the new runs before the old ones are freed */
+	if (rst == EXIT_SUCCESS && count > 0)
+		rst = remap(fs, i, list, len);
+	for (z = 0; rst == EXIT_SUCCESS && z != count; z++)
+		free_blocs(fs, from[z].start, from[z].length);
+
+	for (z = 0; rst != EXIT_SUCCESS && z != count; z++)
+		free_run(fs, BLOC_FLAG, to[z].start - 1, to[z].length);
+	if (rst != EXIT_SUCCESS)
+		*moved = 0;
+	free(from);
+	free(to);
+	free(list);
+
+	return rst;
+}
+
+/**
+ * Shrinks a file to bloc_count blocs
+ * The extents kept are mapped again (see remap), then the blocs past them
+ * are freed (one run per extent). The inode itself is not written.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (broken chain, no bloc left for the
+ * extents), nothing is freed
+ */
+int extent_truncate(struct fs *fs, struct inode *i, int bloc_count) {
+	struct extent *extents, *kept_extents;
+	unsigned int keep;
+	int z, count, kept, rst;
+
+	if (bloc_count >= i->bloc_count) return EXIT_SUCCESS;
+
+	count = i->extent_count;
+	extents = get_extents(fs, i);
+	if (extents == NULL) return EXIT_FAILURE;
+
+	kept_extents = (struct extent *) malloc(count * sizeof(struct extent));
+	if (kept_extents == NULL) {
+		free(extents);
+		return EXIT_FAILURE;
+	}
+
+	/* the extents kept, cut at bloc_count */
+	kept = 0;
+	for (z = 0; z != count && kept < bloc_count; z++) {
+		keep = extents[z].length < (unsigned int) (bloc_count - kept) ? extents[z].length : (unsigned int) (bloc_count - kept);
+		kept_extents[z].start = extents[z].start;
+		kept_extents[z].length = keep;
+		kept += keep;
+	}
+
+	rst = remap(fs, i, kept_extents, z);
+	free(kept_extents);
+
+	kept = 0;
+	for (z = 0; rst == EXIT_SUCCESS && z != count; z++) {
+		keep = 0;
+		if (kept < bloc_count)
+			keep = extents[z].length < (unsigned int) (bloc_count - kept) ? extents[z].length : (unsigned int) (bloc_count - kept);
+
+		if (keep != extents[z].length)
+			free_blocs(fs, extents[z].start + keep, extents[z].length - keep);
+		kept += keep;
+	}
+
+	free(extents);
+
+	return rst;
+}
+
+/**
+ * Reads count blocs of contiguous ids from start with one read (none when
+ * the disk is mapped), the blocs are not cached but checked (see
+ * checksum_check)
+ * refs[j] points at the bloc start + j: its cached copy when it's cached
+ * (it may be dirty), else in the mapping or in buf (count blocs)
+ * The pointers are valid until the next access to a bloc.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int read_extent(struct fs *fs, unsigned int start, unsigned int count, struct bloc *buf, const struct bloc **refs) {
+	const struct bloc *run;
+	unsigned int j;
+	long offset;
+
+	if (start == DELETED || count == 0) return EXIT_FAILURE;
+
+	offset = bloc_offset(&fs->sb, start - 1);
+	run = (const struct bloc *) disk_map(fs, offset, count * sizeof(struct bloc));
+	if (run == NULL) {
+		if (disk_read(fs, offset, buf, count * sizeof(struct bloc)) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+		run = buf;
+	}
+
+	for (j = 0; j != count; j++) {
+		refs[j] = bcache_lookup(&fs->bcache, start + j);
+		if (refs[j] == NULL && !checksum_check(fs, &run[j]))
+			return EXIT_FAILURE;
+		if (refs[j] == NULL)
+			refs[j] = &run[j];
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Writes count blocs to the contiguous ids from start with one write, the
+ * blocs get their ids and their checksums. The slots must be allocated
+ * (see alloc_run), the cached copies are dropped, the records of the
+ * snapshots copied first.
+ * The blocs are written in place, before the commit of the open
+ * transaction (see disk_write_data), unless a snapshot copy of one of
+ * them waits in it: they're logged after the copy then.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int write_extent(struct fs *fs, unsigned int start, struct bloc *blocs, unsigned int count) {
+	unsigned long preserved;
+	unsigned int j;
+
+	if (start == DELETED || count == 0) return EXIT_FAILURE;
+
+	preserved = fs->snapshots.preserved;
+	for (j = 0; j != count; j++) {
+		if (snapshot_preserve(fs, BLOC_FLAG, start + j - 1) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+
+		blocs[j].id = start + j;
+		bloc_seal(&blocs[j]);
+		bcache_drop(&fs->bcache, start + j);
+	}
+
+	if (fs->snapshots.preserved != preserved)
+		return disk_write(fs, bloc_offset(&fs->sb, start - 1), blocs, count * sizeof(struct bloc));
+
+	return disk_write_data(fs, bloc_offset(&fs->sb, start - 1), blocs, count * sizeof(struct bloc));
+}
@@ -0,0 +1,37 @@
+#ifndef EXTENT_H
+#define EXTENT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "./inode.h"
+#include "./bloc.h"
+
+#define EXTENTS_PER_BLOC ((BLOC_SIZE - 2 * sizeof(unsigned int)) / sizeof(struct extent))
+/* most blocs read with one read (see read_extent) */
+#define EXTENT_IO_BLOCS (64)
+/* shortest run a longer one is cut in to move down (see extent_move) */
+#define EXTENT_MOVE_MIN (8)
+
+/*
+ * The content of an extent bloc: the extents of a file past the ones of
+ * its inode, next is the id of the next extent bloc (DELETED if none)
+ */
+struct extent_bloc {
+	unsigned int next;
+	unsigned int count;
+	struct extent extents[EXTENTS_PER_BLOC];
+};
+
+struct fs;
+
+int extent_append(struct fs *fs, struct inode *i, unsigned int start, unsigned int length);
+int extent_move(struct fs *fs, struct inode *i, unsigned int budget, unsigned int *moved);
+int extent_truncate(struct fs *fs, struct inode *i, int bloc_count);
+int extent_unshare(struct fs *fs, struct inode *i, unsigned int first, unsigned int last);
+int read_extent(struct fs *fs, unsigned int start, unsigned int count, struct bloc *buf, const struct bloc **refs);
+int write_extent(struct fs *fs, unsigned int start, struct bloc *blocs, unsigned int count);
+struct extent *get_extents(struct fs *fs, struct inode *i);
+unsigned int bmap(struct fs *fs, struct inode *i, int n);
+unsigned int extent_goal(struct fs *fs, struct inode *i);
+
+#endif
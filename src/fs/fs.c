@@ -14,19 +14,51 @@ struct inode g_working_directory;
 
 void initFS(){
 	// init File System
-	init_id_generator();
 	strcpy(g_username, "user");
 }
 
+/*
+ * Finds the offset of the record of an id
+ * An id is its slot + 1 (DELETED is 0), so it's a direct index in the
+ * inode table or in the bloc region; the slot must be in use
+ *
+ * on success : returns 1 and stores the offset
+ * on failure : returns 0
+ */
+static int find_indexed(struct fs *fs, int flag, unsigned int id, long *offset) {
+	if (id == DELETED || !fs->mounted || !slot_in_use(fs, flag, id - 1)) return 0;
+
+	if (flag == INODE_FLAG)
+		*offset = inode_offset(&fs->sb, id - 1);
+	else
+		*offset = bloc_offset(&fs->sb, id - 1);
+
+	return 1;
+}
+
+/*
+ * Reads the record of an id with a single positioned read
+ *
+ * on success : returns 1, the record and its offset are stored
+ * on failure : returns 0
+ */
+static int read_indexed(struct fs *fs, int flag, unsigned int id, void *record, long *offset) {
+	size_t size;
+
+	size = flag == INODE_FLAG ? sizeof(struct inode) : sizeof(struct bloc);
+
+	return find_indexed(fs, flag, id, offset) && disk_read(fs, *offset, record, size) == EXIT_SUCCESS;
+}
+
 /*
  * Gets the name of a directory by the inode id
  */
-char *get_dirname_by_id(unsigned int id) {
+char *get_dirname_by_id(struct fs *fs, unsigned int id) {
 	struct inode i;
 
-	i = get_inode_by_id(id);
+	i = get_inode_by_id(fs, id);
 
-	return get_dirname(&i);
+	return get_dirname(fs, &i);
 }
 
 /*
@@ -35,17 +67,13 @@ char *get_dirname_by_id(unsigned int id) {
  * note: Root folder doesn't have a name
  * appends / to the name
  */
-char *get_dirname(struct inode *dir) {
+char *get_dirname(struct fs *fs, struct inode *dir) {
 	char *name;
-	struct inode parent_inode;
+	unsigned int parent;
 
-	name = (char *) calloc(FILENAME_COUNT, sizeof(char));
-	parent_inode = get_inode_by_filename(dir, "..");
-	if (parent_inode.id == DELETED) {
-		strcpy(name, "");
-	} else {
-		name = get_filename_for_inode(&parent_inode, dir);
-	}
+	/* the name and "/" */
+	name = (char *) calloc(FILENAME_COUNT + 1, sizeof(char));
+	inode_parent(fs, dir->id, &parent, name);
 
 	strcat(name, "/");
 	return name;
@@ -57,41 +85,21 @@ char *get_dirname(struct inode *dir) {
  *
  * note: don't forget to free the char*
  */
-char *get_filename_for_inode(struct inode *under_dir, struct inode *i) {
-	struct bloc b;
-	int linkcount;
-	int found;
-	unsigned int inode_id;
+char *get_filename_for_inode(struct fs *fs, struct inode *under_dir, struct inode *i) {
+	struct dir_iter it;
 	char *name;
-	int offset;
-	int z;
-	char *c;
+	int found;
 
 	name = (char *) calloc(FILENAME_COUNT, sizeof(char));
 
+	/* the id is not hashed, every bucket is looked at */
 	found = 0;
-	b = get_bloc_by_id(under_dir->bloc_ids[0]);
-	linkcount = ocr(b.content, ',');
-	offset = 0;
-	z = 0;
-
-	while (!found && z != linkcount) {
-
-		c = strchr(b.content + sizeof(char)*offset, ':');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%u", &inode_id);
-		*c = ':';
-		offset += get_index(b.content + offset, ':') + 1;
-		c = strchr(b.content + sizeof(char)*offset, ',');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%s", name);
-		*c = ',';
-		offset += get_index(b.content + offset, ',') + 1;
-
-		if (i->id == inode_id) {
+	dir_iter_init(fs, &it, under_dir);
+	while (!found && dir_iter_next(&it)) {
+		if (it.id == i->id) {
+			strncpy(name, it.name, FILENAME_COUNT - 1);
 			found = 1;
 		}
-		z++;
 	}
 
 	return name;
@@ -103,60 +111,68 @@ char *get_filename_for_inode(struct inode *under_dir, struct inode *i) {
  *
  * Returns the inode created
  */
-struct inode create_root() {
+struct inode create_root(struct fs *fs) {
 	struct inode i;
 	struct bloc b;
 
 	i = new_inode(DIRECTORY, ROOT_PERMISSIONS, ROOT, ROOT);
 	b = new_bloc("");
-	i.id = ROOT_ID;
 
-	add_bloc(&i, &b);
+	write_bloc(fs, &b);
+	add_bloc(fs, &i, &b);
 
-	write_inode(&i);
-	write_bloc(&b);
+	/* the first inode of the disk gets ROOT_ID */
+	write_inode(fs, &i);
 
 	return i;
 }
 
 /**
- * Writes an inode to the disk (by append)
+ * Writes a new inode to the disk, in a free slot of the inode table
+ * The inode gets its id: the slot + 1
  *
- * on failure: returns 0
- * on success: returns 1
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no inode left)
  */
-int write_inode(struct inode *i) {
-	FILE *f;
+int write_inode(struct fs *fs, struct inode *i) {
+	unsigned int slot;
+	long offset;
 
-	if (overwrite_inode(i, DELETED) == EXIT_SUCCESS) {
-		printf("Inode overwritten\n");
-		return EXIT_SUCCESS;
+	if (!fs->mounted || alloc_slot(fs, INODE_FLAG, &slot) != EXIT_SUCCESS) {
+		fprintf(stderr, "No inode left %d\n", __LINE__);
+		return EXIT_FAILURE;
 	}
 
-	f = fopen(DISK, "ab");
-
-	if (f == NULL) {
-		fprintf(stderr, "File's NULL %d", __LINE__);
+	/* the slot may hold an inode of a snapshot, freed since */
+	if (snapshot_preserve(fs, INODE_FLAG, slot) != EXIT_SUCCESS) {
+		free_slot(fs, INODE_FLAG, slot);
 		return EXIT_FAILURE;
 	}
 
-	fwrite(&INODE_FLAG, sizeof(INODE_FLAG), 1, f);
-	fwrite(i, sizeof(struct inode), 1, f);
+	durable_begin(fs);
+	i->id = slot + 1;
+	offset = inode_offset(&fs->sb, slot);
+	if (disk_write(fs, offset, i, sizeof(struct inode)) != EXIT_SUCCESS) {
+		/* the slot is given back, nothing was written in it */
+		free_slot(fs, INODE_FLAG, slot);
+		i->id = DELETED;
+		return durable_end(fs, EXIT_FAILURE);
+	}
+	icache_insert(fs, offset, i, 0);
 
-	fclose(f);
-	return EXIT_SUCCESS;
+	return durable_end(fs, EXIT_SUCCESS);
 }
 
 /*
  * Deletes a bloc
  */
-int delete_bloc(struct bloc *b) {
+int delete_bloc(struct fs *fs, struct bloc *b) {
 	struct bloc new_bloc;
 	int rst;
 
 	new_bloc = *b;
 	new_bloc.id = DELETED;
-	rst = overwrite_bloc(&new_bloc, b->id);
+	rst = overwrite_bloc(fs, &new_bloc, b->id);
 	b->id = DELETED;
 
 	return rst;
@@ -165,38 +181,40 @@ int delete_bloc(struct bloc *b) {
 /*
  * Deletes an inode
  */
-int delete_inode(struct inode *i) {
+int delete_inode(struct fs *fs, struct inode *i) {
 	struct inode new_inode;
 	int rst;
 
 	new_inode = *i;
 	new_inode.id = DELETED;
-	rst = overwrite_inode(&new_inode, i->id);
+	rst = overwrite_inode(fs, &new_inode, i->id);
 	i->id = DELETED;
 
 	return rst;
 }
 
 /**
- * Creates the root inode and write to a file
+ * Formats the disk, mounts it in fs and creates the root inode
  * Call only once
  */
-struct inode create_disk() {
-	FILE *f;
+struct inode create_disk(struct fs *fs) {
+	if (fs->mounted)
+		unmount_disk(fs);
 
-	f = fopen(DISK, "ab+");
-	fclose(f);
+	if (format_disk(DISK, DEFAULT_INODE_COUNT, DEFAULT_BLOC_COUNT) != EXIT_SUCCESS
+			|| mount_disk(fs, DISK) != EXIT_SUCCESS)
+		return empty_inode();
 
-	struct inode root;
-	root = create_root();
-
-	return root;
+	return create_root(fs);
 }
 
 /**
- * Removes the disk file
+ * Unmounts and removes the disk file
  */
-int clean_disk() {
+int clean_disk(struct fs *fs) {
+	if (fs->mounted)
+		unmount_disk(fs);
+
 	return remove(DISK);
 }
 
@@ -206,146 +224,126 @@ int clean_disk() {
  * available inodes
  * available memory (in bytes)
  */
-void disk_free(unsigned int *blocs_available, unsigned int *inodes_available, size_t *bytes_available) {
-	FILE *f;
-	int size;
-	int flag;
-	struct inode i;
-	struct bloc b;
-
-	size = 0;
+void disk_free(struct fs *fs, unsigned int *blocs_available, unsigned int *inodes_available, size_t *bytes_available) {
 	*inodes_available = 0;
 	*blocs_available = 0;
-	f = fopen(DISK, "rb");
-
-	do {
-		size = fread(&flag, sizeof(const int), 1, f);
-
-		if (flag == INODE_FLAG) {
-			fread(&i, sizeof(struct inode), 1, f);
-			if (i.id == DELETED)
-				*inodes_available = *inodes_available + 1;
-		} else if (flag == BLOC_FLAG) {
-			fread(&b, sizeof(struct bloc), 1, f);
-			if (b.id == DELETED)
-				*blocs_available = *blocs_available + 1;
-		} else {
-			perror("Houston there's a problem with the <disk>");
-		}
+	*bytes_available = 0;
 
-	} while (size != 0);
+	if (!fs->mounted) {
+		perror("Houston there's a problem with the <disk>");
+		return;
+	}
 
+	*inodes_available = count_free_slots(fs, INODE_FLAG);
+	*blocs_available = count_free_slots(fs, BLOC_FLAG);
 	*bytes_available = (sizeof(struct bloc) * *blocs_available)
 		+ (sizeof(struct inode) * *inodes_available);
-
-	fclose(f);
 }
 
-/**
- * Overwrite an inode by its id
- *
- * on success : returns 1
- * on failure : returns 0
+/*
+ * Replaces the inode of an id, in the cache or on the disk (see
+ * overwrite_inode)
  */
-int overwrite_inode(struct inode *new_inode, unsigned int id) {
-	FILE *f;
-	int size;
-	int flag;
-	int pos;
-	struct inode i;
-	int updated;
-	struct bloc b;
+static int replace_inode(struct fs *fs, struct inode *new_inode, unsigned int id) {
+	long offset;
 
-	size = 0;
-	updated = 0;
-	f = fopen(DISK, "r+b");
+	/* the id is the slot, a record can't be renumbered */
+	if (new_inode->id != id && new_inode->id != DELETED)
+		return EXIT_FAILURE;
 
-	if (f == NULL) {
-		fprintf(stderr, "File empty %d", __LINE__);
+	/* copied on write for the snapshots */
+	if (id == DELETED || snapshot_preserve(fs, INODE_FLAG, id - 1) != EXIT_SUCCESS)
 		return EXIT_FAILURE;
-	}
 
-	do {
-		/*
-		 * We determine if it's a bloc or an inode by the flag
-		 */
-		size = fread(&flag, sizeof(const int), 1, f);
-		pos = ftell(f);
+	/* an update stays in the cache until it's written back */
+	if (new_inode->id == id && icache_update(&fs->icache, new_inode) == EXIT_SUCCESS)
+		return EXIT_SUCCESS;
+
+	if (!find_indexed(fs, INODE_FLAG, id, &offset))
+		return EXIT_FAILURE;
 
-		if (size == 0) continue;
+	/* written through when the cache can't take it */
+	if (new_inode->id == id) {
+		if (icache_insert(fs, offset, new_inode, 1) != NULL)
+			return EXIT_SUCCESS;
+		return disk_write(fs, offset, new_inode, sizeof(struct inode));
+	}
 
-		if (flag == INODE_FLAG) {
-			fread(&i, sizeof(struct inode), 1, f);
+	icache_drop(&fs->icache, id);
+	/* the id can be given again, nothing is under it anymore */
+	dcache_purge(&fs->dcache, id);
 
-			if (i.id == id) {
-				fseek(f, pos, SEEK_SET);
-				fwrite(new_inode, sizeof(struct inode), 1, f);
-				updated = 1;
-			}
-		} else {
-			fread(&b, sizeof(struct bloc), 1, f);
-		}
+	if (disk_write(fs, offset, new_inode, sizeof(struct inode)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
 
-	} while (size != 0 && !updated);
+	free_slot(fs, INODE_FLAG, id - 1);
 
-	fclose(f);
+	return EXIT_SUCCESS;
+}
 
-	if (updated) {
-		return EXIT_SUCCESS;
-	} else {
-		return EXIT_FAILURE;
-	}
+/**
+ * Overwrite an inode by its id, through the inode cache
+ * Overwriting with a DELETED inode frees its slot
+ *
+ * on success : returns 1
+ * on failure : returns 0
+ */
+int overwrite_inode(struct fs *fs, struct inode *new_inode, unsigned int id) {
+	durable_begin(fs);
+
+	return durable_end(fs, replace_inode(fs, new_inode, id));
 }
 
 /*
- * Overwrites a bloc
- * exception: file not found
+ * Replaces the bloc of an id, in the cache or on the disk (see
+ * overwrite_bloc)
  */
-int overwrite_bloc(struct bloc *new_bloc, unsigned int id) {
-	FILE *f;
-	int size;
-	int flag;
-	int pos;
-	struct bloc i;
-	int updated;
-	struct bloc b;
+static int replace_bloc(struct fs *fs, struct bloc *new_bloc, unsigned int id) {
+	long offset;
 
-	size = 0;
-	updated = 0;
-	f = fopen(DISK, "r+b");
+	/* the id is the slot, a record can't be renumbered */
+	if (new_bloc->id != id && new_bloc->id != DELETED)
+		return EXIT_FAILURE;
 
-	if (f == NULL) {
-		fprintf(stderr, "File empty %d", __LINE__);
+	/* copied on write for the snapshots */
+	if (id == DELETED || snapshot_preserve(fs, BLOC_FLAG, id - 1) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	/* an update stays in the cache until it's written back */
+	if (new_bloc->id == id && bcache_update(&fs->bcache, new_bloc) == EXIT_SUCCESS)
+		return EXIT_SUCCESS;
+
+	if (!find_indexed(fs, BLOC_FLAG, id, &offset))
 		return EXIT_FAILURE;
-	}
 
-	do {
-		size = fread(&flag, sizeof(const int), 1, f);
-		pos = ftell(f);
+	/* written through when no entry of the cache can be freed */
+	if (new_bloc->id == id) {
+		if (bcache_insert(fs, offset, new_bloc, 1) != NULL)
+			return EXIT_SUCCESS;
+		bloc_seal(new_bloc);
+		return disk_write(fs, offset, new_bloc, sizeof(struct bloc));
+	}
 
-		if (size == 0) continue;
+	bcache_drop(&fs->bcache, id);
 
-		if (flag == BLOC_FLAG) {
-			fread(&b, sizeof(struct bloc), 1, f);
+	bloc_seal(new_bloc);
+	if (disk_write(fs, offset, new_bloc, sizeof(struct bloc)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
 
-			if (b.id == id) {
-				fseek(f, pos, SEEK_SET);
-				fwrite(new_bloc, sizeof(struct bloc), 1, f);
-				updated = 1;
-			}
-		} else {
-			fread(&i, sizeof(struct inode), 1, f);
-		}
+	free_slot(fs, BLOC_FLAG, id - 1);
 
-	} while (size != 0 && !updated);
+	return EXIT_SUCCESS;
+}
 
-	fclose(f);
+/*
+ * Overwrites a bloc, through the bloc cache
+ * Overwriting with a DELETED bloc frees its slot
+ * exception: file not found
+ */
+int overwrite_bloc(struct fs *fs, struct bloc *new_bloc, unsigned int id) {
+	durable_begin(fs);
 
-	if (updated) {
-		return EXIT_SUCCESS;
-	} else {
-		return EXIT_FAILURE;
-	}
+	return durable_end(fs, replace_bloc(fs, new_bloc, id));
 }
 
 /**
@@ -355,45 +353,70 @@ int overwrite_bloc(struct bloc *new_bloc, unsigned int id) {
  * on success : returns 1
  * on failure : returns 0
  */
-int update_inode(struct inode *new_inode) {
-	return overwrite_inode(new_inode, new_inode->id);
+int update_inode(struct fs *fs, struct inode *new_inode) {
+	return overwrite_inode(fs, new_inode, new_inode->id);
 }
 
 /**
  * TODO fix redundancy
  */
-int update_bloc(struct bloc *new_bloc) {
-	return overwrite_bloc(new_bloc, new_bloc->id);
+int update_bloc(struct fs *fs, struct bloc *new_bloc) {
+	return overwrite_bloc(fs, new_bloc, new_bloc->id);
 }
 
 /*
- * Creates a regular file under a directory
+ * Checks if a name can be given to a new entry of a directory: 1 to
+ * DIRENT_NAME_MAX chars, not taken
+ *
+ * success : 1
+ * failure : 0
  */
-struct file create_regularfile(struct inode *under_dir, char *filename, char *content, int flags) {
+static int name_available(struct fs *fs, struct inode *dir, char *name) {
+	size_t len;
+
+	len = strlen(name);
+	if (len == 0 || len > DIRENT_NAME_MAX) {
+		fprintf(stderr, "Invalid name %s %d\n", name, __LINE__);
+		return 0;
+	}
+	if (get_inode_by_filename(fs, dir, name).id != DELETED) {
+		fprintf(stderr, "%s exists already %d\n", name, __LINE__);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * Creates a regular file under a directory, content is written without
+ * its terminating '\0' (see iwrite)
+ * One transaction (see txn.c)
+ *
+ * on failure : returns a file of an empty inode (invalid or taken name)
+ */
+struct file create_regularfile(struct fs *fs, struct inode *under_dir, char *filename, char *content, int flags) {
 	struct inode i;
-	struct bloc b, to_update;
+	struct bloc to_update;
 	struct file f;
-	int z, len;
-	char **blocs_contents;
 
-	blocs_contents = NULL;
-	len = strncut(&blocs_contents, content, BLOC_SIZE);
+	if (!name_available(fs, under_dir, filename)) {
+		i = empty_inode();
+		return new_file(fs, &i, flags);
+	}
 
+	txn_begin(fs);
 	i = new_inode(REGULAR_FILE, DEFAULT_PERMISSIONS, g_username, g_username);
-	to_update = add_inode_to_inode(under_dir, &i, filename);
-
-	for (z = 0; z != len; z++) {
-		b = new_bloc(blocs_contents[z]);
-		add_bloc(&i, &b);
-		write_bloc(&b);
-	}
+	write_inode(fs, &i);
 
-	update_bloc(&to_update);
-	write_inode(&i);
+	f = new_file(fs, &i, O_RDWR);
+	iwrite(fs, &f, content, strlen(content));
+	i = f.inode;
 
-	free_str_array(blocs_contents, len);
+	to_update = add_inode_to_inode(fs, under_dir, &i, filename);
+	update_bloc(fs, &to_update);
+	txn_commit(fs);
 
-	f = new_file(&i, flags);
+	f = new_file(fs, &i, flags);
 
 	return f;
 }
@@ -401,78 +424,80 @@ struct file create_regularfile(struct inode *under_dir, char *filename, char *co
 /**
  * Prints the disk in the terminal, inodes and blocs alike
  *
- * Returns fclose return value
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (not mounted)
  */
-int print_disk() {
-	FILE *f;
-	int size;
-	int flag;
+int print_disk(struct fs *fs) {
+	unsigned int slot;
+	size_t z;
 	struct bloc b;
 	struct inode i;
 
-	size = 0;
-	f = fopen(DISK, "rb");
-	if (f == NULL) {
+	if (!fs->mounted) {
 		fprintf(stderr, "File's NULL %d\n", __LINE__);
 		return EXIT_FAILURE;
 	}
 
-	printf("<<<<<<<<<< DISK >>>>>>>>>>\n");
-
-	do {
-		/*
-		 * We determine if it's a bloc or an inode by the flag
-		 */
-		size = fread(&flag, sizeof(const int), 1, f);
-
-		if (size == 0) continue;
+	flush_disk(fs);
 
-		if (flag == BLOC_FLAG) {
-			fread(&b, sizeof(struct bloc), 1, f);
-			print_bloc(&b);
-
-		} else if (flag == INODE_FLAG) {
-			fread(&i, sizeof(struct inode), 1, f);
+	printf("<<<<<<<<<< DISK >>>>>>>>>>\n");
+	printf("<SUPERBLOCK> version:%u inodes:%u/%u blocs:%u/%u\n", fs->sb.version,
+			fs->sb.inode_high, fs->sb.inode_count, fs->sb.bloc_high, fs->sb.bloc_count);
+	printf("<CACHE> blocs:%lu hits:%lu misses:%lu\n", (unsigned long) fs->bcache.size,
+			fs->bcache.hits, fs->bcache.misses);
+	printf("<CACHE> inodes:%lu hits:%lu misses:%lu\n", (unsigned long) fs->icache.size,
+			fs->icache.hits, fs->icache.misses);
+	printf("<CACHE> dentries:%lu hits:%lu misses:%lu\n", (unsigned long) fs->dcache.size,
+			fs->dcache.hits, fs->dcache.misses);
+	printf("<TXN> commits:%lu logged:%lu writes:%lu\n", fs->txn.commits, fs->txn.logged, fs->txn.writes);
+	printf("<DURABILITY> mode:%s syncs:%lu\n", durability_name(fs->durability.mode), fs->durability.syncs);
+	printf("<JOURNAL> sequence:%u size:%u group:%d syncs:%lu replayed:%lu\n", fs->journal.sequence,
+			fs->sb.journal_size, fs->journal.group, fs->journal.syncs, fs->journal.replayed);
+	for (z = 0; z != fs->snapshots.count; z++)
+		printf("<SNAPSHOT> id:%u name:%s exceptions:%lu%s\n", fs->snapshots.list[z].id, fs->snapshots.list[z].head.name,
+				(unsigned long) fs->snapshots.list[z].exceptions.count,
+				fs->snapshots.view == &fs->snapshots.list[z] ? " (mounted)" : "");
+
+	for (slot = 0; slot != fs->sb.inode_high; slot++) {
+		if (slot_in_use(fs, INODE_FLAG, slot)
+				&& disk_read(fs, inode_offset(&fs->sb, slot), &i, sizeof(struct inode)) == EXIT_SUCCESS
+				&& i.id != DELETED)
 			print_inode(&i);
+	}
 
-		} else {
-			printf("?\n");
-		}
-
-	} while (size != 0);
+	for (slot = 0; slot != fs->sb.bloc_high; slot++) {
+		if (slot_in_use(fs, BLOC_FLAG, slot)
+				&& disk_read(fs, bloc_offset(&fs->sb, slot), &b, sizeof(struct bloc)) == EXIT_SUCCESS
+				&& b.id != DELETED)
+			print_bloc(&b);
+	}
 
 	printf("\n<<<<<<<<<<   EOF  >>>>>>>>>>\n");
 
-	return fclose(f);
+	return EXIT_SUCCESS;
 }
 
 
 /*
  * Remove an inode and his block
  */
-int remove_databloc(struct inode *from_dir, char *name) {
+int remove_databloc(struct fs *fs, struct inode *from_dir, char *name) {
 	struct inode i;
-	struct bloc b;
-	int z;
 
-	i = get_inode_by_filename(from_dir, name);
-	for (z = 0; z != i.bloc_count; z++) {
-		b = get_bloc_by_id(i.bloc_ids[z]);
-		delete_bloc(&b);
-	}
-
-	delete_inode(&i);
+	i = get_inode_by_filename(fs, from_dir, name);
+	if (extent_truncate(fs, &i, 0) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
 
-	return EXIT_SUCCESS;
+	return delete_inode(fs, &i);
 }
 
 /*
  * Removes a file, any kind
+ * One transaction (see txn.c)
  */
-int remove_file(struct inode *under_dir, char *filename, enum filetype ft) {
+int remove_file(struct fs *fs, struct inode *under_dir, char *filename, enum filetype ft) {
 	struct inode i;
 	struct bloc to_update;
-	unsigned int file_id;
 
 	if (under_dir->type != DIRECTORY) {
 		perror("Input is not a directory");
@@ -480,51 +505,61 @@ int remove_file(struct inode *under_dir, char *filename, enum filetype ft) {
 	}
 
 	/* first we remove the dir's inode and bloc */
-	i = get_inode_by_filename(under_dir, filename);
+	i = get_inode_by_filename(fs, under_dir, filename);
 
 	if (i.type != ft) {
 		perror("Wrong file type");
 		return EXIT_FAILURE;
 	}
 
-	file_id = i.id;
-
 	if (ft == DIRECTORY) {
 		/* A directory has at least the . and the .. directories */
-		if (get_filecount(&i) != 2) {
+		if (get_filecount(fs, &i) != 2) {
 			perror(DIRECTORY_NOT_EMPTY_MESSAGE);
 			return EXIT_FAILURE;
 		}
 	}
-	remove_databloc(under_dir, filename);
+	txn_begin(fs);
+	if (remove_databloc(fs, under_dir, filename) != EXIT_SUCCESS) {
+		txn_commit(fs);
+		return EXIT_FAILURE;
+	}
 
 	/* then we remove the inode from the content in under_dir's bloc */
-	to_update = remove_inode_from_directory(under_dir, file_id);
-	update_bloc(&to_update);
+	to_update = remove_inode_from_directory(fs, under_dir, filename);
+	update_bloc(fs, &to_update);
 
-	return EXIT_SUCCESS;
+	return txn_commit(fs);
 }
 
 /**
  * Creates a directory
+ * One transaction (see txn.c)
+ *
+ * on failure : returns an empty inode (invalid or taken name)
  */
-struct inode create_directory(struct inode *under_dir, char *dirname) {
+struct inode create_directory(struct fs *fs, struct inode *under_dir, char *dirname) {
 	struct inode i;
 	struct bloc b, to_update;
 
+	if (!name_available(fs, under_dir, dirname))
+		return empty_inode();
+
+	txn_begin(fs);
 	i = new_inode(DIRECTORY, DEFAULT_PERMISSIONS, g_username, g_username);
 	b = new_bloc("");
 
-	add_bloc(&i, &b);
-	to_update = add_inode_to_inode(under_dir, &i, dirname);
+	write_bloc(fs, &b);
+	add_bloc(fs, &i, &b);
+	write_inode(fs, &i);
 
-	write_inode(&i);
-	write_bloc(&b);
-	update_bloc(&to_update);
+	to_update = add_inode_to_inode(fs, under_dir, &i, dirname);
+	update_bloc(fs, &to_update);
 
 	/* we add the .. dir */
-	create_dot_dir(&i);
-	create_dotdot_dir(under_dir, &i);
+	create_dot_dir(fs, &i);
+	create_dotdot_dir(fs, under_dir, &i);
+	txn_commit(fs);
 
 	return i;
 }
@@ -534,153 +569,269 @@ struct inode create_directory(struct inode *under_dir, char *dirname) {
  * and returns the inode created
  *
  * filename must not be NULL
+ * One transaction (see txn.c)
+ *
+ * on failure : returns a file of an empty inode (invalid or taken name)
  */
-struct file create_emptyfile(struct inode *under_dir, char *filename, enum filetype type) {
+struct file create_emptyfile(struct fs *fs, struct inode *under_dir, char *filename, enum filetype type) {
 	struct bloc b, to_update;
 	struct inode i;
 	struct file f;
 
+	if (!name_available(fs, under_dir, filename)) {
+		i = empty_inode();
+		return new_file(fs, &i, O_CREAT | O_WRONLY | O_TRUNC);
+	}
+
+	txn_begin(fs);
 	b = new_bloc("");
 	i = new_inode(type, DEFAULT_PERMISSIONS, g_username, g_username);
 
-	add_bloc(&i, &b);
-	to_update = add_inode_to_inode(under_dir, &i, filename);
+	write_bloc(fs, &b);
+	add_bloc(fs, &i, &b);
+	write_inode(fs, &i);
 
-	write_inode(&i);
-	write_bloc(&b);
-	update_bloc(&to_update);
+	to_update = add_inode_to_inode(fs, under_dir, &i, filename);
+	update_bloc(fs, &to_update);
+	txn_commit(fs);
 
-	f = new_file(&i, O_CREAT | O_WRONLY | O_TRUNC);
+	f = new_file(fs, &i, O_CREAT | O_WRONLY | O_TRUNC);
 
 	return f;
 }
 
 /**
- * Writes a bloc to the disk (by append)
+ * Writes a new bloc to the disk, in a free slot of the bloc region
+ * The bloc gets its id: the slot + 1
  *
- * Returns fclose return value
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no bloc left)
+ */
+int write_bloc(struct fs *fs, struct bloc *b) {
+	unsigned int slot;
+	long offset;
+
+	if (!fs->mounted || alloc_slot(fs, BLOC_FLAG, &slot) != EXIT_SUCCESS) {
+		fprintf(stderr, "No bloc left %d\n", __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	/* the slot may hold a bloc of a snapshot, freed since */
+	if (snapshot_preserve(fs, BLOC_FLAG, slot) != EXIT_SUCCESS) {
+		free_slot(fs, BLOC_FLAG, slot);
+		return EXIT_FAILURE;
+	}
+
+	durable_begin(fs);
+	b->id = slot + 1;
+	bloc_seal(b);
+	offset = bloc_offset(&fs->sb, slot);
+	if (disk_write(fs, offset, b, sizeof(struct bloc)) != EXIT_SUCCESS) {
+		/* the slot is given back, nothing was written in it */
+		free_slot(fs, BLOC_FLAG, slot);
+		b->id = DELETED;
+		return durable_end(fs, EXIT_FAILURE);
+	}
+	bcache_insert(fs, offset, b, 0);
+
+	return durable_end(fs, EXIT_SUCCESS);
+}
+/*
+ * Returns the cache entry of an inode, read from the disk on a miss
  */
-int write_bloc(struct bloc *b) {
-	FILE *f;
+static struct icache_entry *cached_inode(struct fs *fs, unsigned int inode_id) {
+	struct icache_entry *e;
+	struct inode i;
+	long offset;
 
-	f = fopen(DISK, "ab");
+	e = icache_lookup(&fs->icache, inode_id);
+	if (e != NULL)
+		return e;
 
-	fwrite(&BLOC_FLAG, sizeof(const int), 1, f);
-	fwrite(b, sizeof(struct bloc), 1, f);
+	if (!read_indexed(fs, INODE_FLAG, inode_id, &i, &offset))
+		return NULL;
 
-	return fclose(f);
+	return icache_insert(fs, offset, &i, 0);
 }
+
 /**
  * Returns an inode by its id
+ *
+ * on failure: returns an empty inode
  */
-struct inode get_inode_by_id(unsigned int inode_id) {
-	FILE *f;
-	int size;
-	int flag;
-	struct bloc b;
-	struct inode i;
-	int match = 0;
+struct inode get_inode_by_id(struct fs *fs, unsigned int inode_id) {
+	struct icache_entry *e;
 
-	size = 0;
-	f = fopen(DISK, "rb");
+	e = cached_inode(fs, inode_id);
+	if (e == NULL)
+		return empty_inode();
 
-	if (f == NULL) {
-		perror(NO_FILE_ERROR_MESSAGE);
-		return i;
-	}
+	return e->inode;
+}
 
-	do {
-		size = fread(&flag, sizeof(const int), 1, f);
+/**
+ * Returns a pinned handle on the cached inode of an id, it stays cached
+ * until iput
+ * Changes made through the handle are kept with idirty
+ *
+ * on failure: returns NULL
+ */
+struct inode *iget(struct fs *fs, unsigned int inode_id) {
+	struct icache_entry *e;
 
-		if (size == 0) continue;
+	e = cached_inode(fs, inode_id);
+	if (e == NULL)
+		return NULL;
 
-		if (flag == INODE_FLAG) {
-			fread(&i, sizeof(struct inode), 1, f);
-			if (i.id == inode_id) {
-				match = !match;
-			}
-		} else {
-			fread(&b, sizeof(struct bloc), 1, f);
-		}
+	e->refcount++;
 
-	} while (size != 0 && !match);
+	return &e->inode;
+}
 
-	fclose(f);
+/*
+ * Unpins a handle given by iget
+ */
+void iput(struct fs *fs, struct inode *i) {
+	struct icache_entry *e;
 
-	return i;
+	if (i == NULL) return;
+
+	e = (struct icache_entry *) i;
+	if (e->refcount > 0)
+		e->refcount--;
 }
 
 /**
- * Returns a bloc by its id
+ * Keeps the changes made through a handle, the inode is written back later
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
  */
-struct bloc get_bloc_by_id(unsigned int bloc_id) {
-	FILE *f;
-	int size;
-	int flag;
-	struct bloc b;
-	struct inode i;
-	int match = 0;
+int idirty(struct fs *fs, struct inode *i) {
+	return overwrite_inode(fs, i, i->id);
+}
 
-	size = 0;
-	f = fopen(DISK, "rb");
+/*
+ * Returns a bloc by its id from the bloc cache, read from the disk on a
+ * miss (see bloc_ref)
+ */
+static const struct bloc *cached_bloc(struct fs *fs, unsigned int bloc_id, struct bloc *tmp) {
+	long offset;
+	const struct bloc *b;
 
-	if (f == NULL) {
-		perror(NO_FILE_ERROR_MESSAGE);
-		b = empty_bloc();
-		b.id = DELETED;
+	b = bcache_lookup(&fs->bcache, bloc_id);
+	if (b != NULL)
 		return b;
+
+	if (!find_indexed(fs, BLOC_FLAG, bloc_id, &offset)
+			|| disk_read(fs, offset, tmp, sizeof(struct bloc)) != EXIT_SUCCESS
+			|| !checksum_check(fs, tmp))
+		return NULL;
+
+	b = bcache_insert(fs, offset, tmp, 0);
+
+	return b != NULL ? b : tmp;
+}
+
+/**
+ * Returns a bloc by its id, checked against its checksum when it's read
+ * from the disk (see checksum_check)
+ *
+ * on failure: returns an empty bloc (id == DELETED)
+ */
+struct bloc get_bloc_by_id(struct fs *fs, unsigned int bloc_id) {
+	struct bloc tmp;
+	const struct bloc *b;
+
+	b = cached_bloc(fs, bloc_id, &tmp);
+	if (b == NULL) {
+		tmp = empty_bloc();
+		tmp.id = DELETED;
+		return tmp;
 	}
 
-	do {
-		size = fread(&flag, sizeof(const int), 1, f);
+	return *b;
+}
+
+/**
+ * Returns a bloc by its id without copying it: from the bloc cache, or
+ * from the mapping when the disk is mapped (not cached then)
+ * The pointer is valid until the next access to a bloc
+ * tmp is only used when the bloc can't be cached
+ *
+ * on failure: returns NULL (a corrupted bloc too, see checksum_check)
+ */
+const struct bloc *bloc_ref(struct fs *fs, unsigned int bloc_id, struct bloc *tmp) {
+	long offset;
+	const struct bloc *b;
 
-		if (size == 0) continue;
+	b = bcache_lookup(&fs->bcache, bloc_id);
+	if (b != NULL)
+		return b;
 
-		if (flag == BLOC_FLAG) {
-			fread(&b, sizeof(struct bloc), 1, f);
-			if (b.id == bloc_id) {
-				match = !match;
-			}
-		} else {
-			fread(&i, sizeof(struct inode), 1, f);
-		}
+	if (!find_indexed(fs, BLOC_FLAG, bloc_id, &offset))
+		return NULL;
 
-	} while (size != 0 && !match);
+	b = (const struct bloc *) disk_map(fs, offset, sizeof(struct bloc));
+	if (b != NULL)
+		return checksum_check(fs, b) ? b : NULL;
 
-	fclose(f);
+	if (disk_read(fs, offset, tmp, sizeof(struct bloc)) != EXIT_SUCCESS || !checksum_check(fs, tmp))
+		return NULL;
 
-	return b;
+	b = bcache_insert(fs, offset, tmp, 0);
+
+	return b != NULL ? b : tmp;
 }
 
 /**
  * Returns the number of files under a directory
  */
-unsigned int get_filecount(struct inode *dir) {
-	char str[BLOC_SIZE];
-	struct bloc b;
+unsigned int get_filecount(struct fs *fs, struct inode *dir) {
+	struct dir_iter it;
+	unsigned int count;
+
+	count = 0;
+	dir_iter_init(fs, &it, dir);
+	while (dir_iter_next(&it))
+		count++;
 
-	b = get_bloc_by_id(dir->bloc_ids[0]);
-	strcpy(str, b.content);
-	return ocr(str, ',');
+	return count;
 }
 
 /**
  * Link inode to other inode (directory)
- * Returns the bloc to update (in the disk)
+ * Returns the bloc to update (in the disk): the bucket of the name
+ *
+ * A full bucket gets split first (see dir_split), the directory inode is
+ * written then, and dir is updated. The name must be available (see
+ * name_available): an invalid or taken one leaves the bucket as it is.
  */
-struct bloc add_inode_to_inode(struct inode *dir, struct inode *i, char *name) {
-	/* TODO out of bound */
-	char str_id[15];
+struct bloc add_inode_to_inode(struct fs *fs, struct inode *dir, struct inode *i, char *name) {
+	struct inode d;
 	struct bloc b;
+	int splits;
 
+	dcache_drop(&fs->dcache, dir->id, name);
 
-	/* We assume a directory has only one bloc */
-	b = get_bloc_by_id(dir->bloc_ids[0]);
-	sprintf(str_id, "%d", i->id);
-	strcat(b.content, str_id);
-	strcat(b.content, ":");
-	strcat(b.content, name);
-	strcat(b.content, ",");
+	d = current_dir(fs, dir);
+	b = get_bloc_by_id(fs, bmap(fs, &d, dir_bucket(&d, name)));
+	if (strlen(name) == 0 || strlen(name) > DIRENT_NAME_MAX || dirent_find(&b, name) >= 0) {
+		fprintf(stderr, "Invalid or taken name %d\n", __LINE__);
+		return b;
+	}
+
+	/* a split halves the bucket of the name at most 2 rounds of splits later */
+	for (splits = 0; dirent_add(&b, i->id, i->type, name) != EXIT_SUCCESS; splits++) {
+		if (splits > 2 * d.bloc_count || dir_split(fs, &d) != EXIT_SUCCESS) {
+			fprintf(stderr, "Directory's full %d\n", __LINE__);
+			return b;
+		}
+
+		update_inode(fs, &d);
+		*dir = d;
+		b = get_bloc_by_id(fs, bmap(fs, &d, dir_bucket(&d, name)));
+	}
 
 	return b;
 }
@@ -689,16 +840,102 @@ struct bloc add_inode_to_inode(struct inode *dir, struct inode *i, char *name) {
 /* Primitives */
 
 /*
- * Write buf into an inode blocs
- * add new blocs if necessary
- * delete blocs if necessary
+ * A position in the bytes of an array of buffers, moved by iov_copy
  */
-int iwrite(struct file *f, char *buf, size_t n) {
+struct iov_cursor {
+	const struct iovec *iov;
+	int iovcnt;
+	int index;
+	size_t skip;
+};
+
+/*
+ * The number of bytes of an array of buffers
+ */
+static size_t iov_total(const struct iovec *iov, int iovcnt) {
+	size_t total;
 	int z;
-	int done;
-	int pos;
-	int new_bloc_count;
-	struct bloc b;
+
+	total = 0;
+	for (z = 0; z < iovcnt; z++)
+		total += iov[z].iov_len;
+
+	return total;
+}
+
+/*
+ * Copies len bytes from the position of the buffers to bytes, or from
+ * bytes to the buffers (into_iov), the position moves past them
+ */
+static void iov_copy(struct iov_cursor *c, char *bytes, size_t len, int into_iov) {
+	size_t part;
+	char *base;
+
+	while (len != 0 && c->index < c->iovcnt) {
+		base = (char *) c->iov[c->index].iov_base + c->skip;
+		part = c->iov[c->index].iov_len - c->skip;
+		if (part > len)
+			part = len;
+
+		if (into_iov)
+			memcpy(base, bytes, part);
+		else
+			memcpy(bytes, base, part);
+
+		bytes += part;
+		len -= part;
+		c->skip += part;
+		if (c->skip == c->iov[c->index].iov_len) {
+			c->index++;
+			c->skip = 0;
+		}
+	}
+}
+
+/*
+ * Fills the bytes of a bloc of a file in the written range [start, end),
+ * the first byte of the bloc is the byte bloc_start of the file
+ * The bytes before offset are a hole (zeros), the next ones come from the
+ * buffers.
+ */
+static void fill_bloc(struct bloc *b, size_t bloc_start, size_t start, size_t offset, struct iov_cursor *src, size_t end) {
+	size_t from, to, data;
+
+	from = start > bloc_start ? start - bloc_start : 0;
+	to = end - bloc_start < BLOC_SIZE ? end - bloc_start : BLOC_SIZE;
+	data = offset > bloc_start ? offset - bloc_start : 0;
+	if (data > to)
+		data = to;
+	if (data < from)
+		data = from;
+
+	memset(b->content + from, 0, data - from);
+	iov_copy(src, b->content + data, to - data, 0);
+	if (b->length < to)
+		b->length = to;
+}
+
+/*
+ * Writes the bytes of the buffers (any byte, '\0' too) at offset in a
+ * file, which grows when they go past its end (a hole up to offset is
+ * zeros)
+ * Every bloc but the last is full: byte k of the file is in its bloc
+ * k / BLOC_SIZE.
+ *
+ * Only the blocs of the range are touched: the ones the file has are
+ * read, patched and written back a run at a time (copied first when they
+ * are shared with a copy, see extent_unshare), the new ones are
+ * allocated as runs after the last bloc of the file. The inode is
+ * written once.
+ */
+static int write_at(struct fs *fs, struct file *f, size_t offset, const struct iovec *iov, int iovcnt) {
+	unsigned int k, z, j, count, first, last, logical, slot, got;
+	int rst;
+	size_t n, start, end, written;
+	struct iov_cursor src;
+	struct bloc *run;
+	const struct bloc *refs[EXTENT_IO_BLOCS];
+	struct extent *extents;
 	time_t t;
 	struct inode *i;
 
@@ -708,72 +945,208 @@ int iwrite(struct file *f, char *buf, size_t n) {
 		return EXIT_FAILURE;
 	}
 
+	n = iov_total(iov, iovcnt);
+	if (n == 0)
+		return EXIT_SUCCESS;
+
+	src.iov = iov;
+	src.iovcnt = iovcnt;
+	src.index = 0;
+	src.skip = 0;
+
 	i = &(f->inode);
 	t = time(NULL);
-	done = 0;
-	pos = 0;
-	z = 0;
 
-	while (!done && z != i->bloc_count) {
-		b = get_bloc_by_id(i->bloc_ids[z]);
+	start = offset < i->size ? offset : i->size;
+	end = offset + n;
+	first = start / BLOC_SIZE;
+	last = (end - 1) / BLOC_SIZE;
+	/* the end of the bytes written so far, the runs go in order */
+	written = start;
 
-		if (n > BLOC_SIZE - 1) {
-			strncpy(b.content, buf + pos, BLOC_SIZE - 1);
-			pos += BLOC_SIZE - 1;
-			n -= BLOC_SIZE - 1;
+	run = (struct bloc *) malloc(EXTENT_IO_BLOCS * sizeof(struct bloc));
+	if (run == NULL)
+		return EXIT_FAILURE;
+
+	/* the blocs shared with a copy are copied before they change */
+	rst = extent_unshare(fs, i, first, last);
+	extents = get_extents(fs, i);
+	logical = 0;
+	for (k = 0; rst == EXIT_SUCCESS && extents != NULL && k != (unsigned int) i->extent_count && logical <= last; k++) {
+		z = first > logical ? first - logical : 0;
+		for (; rst == EXIT_SUCCESS && z < extents[k].length && logical + z <= last; z += count) {
+			count = extents[k].length - z;
+			if (count > last - (logical + z) + 1)
+				count = last - (logical + z) + 1;
+			if (count > EXTENT_IO_BLOCS)
+				count = EXTENT_IO_BLOCS;
+
+			rst = read_extent(fs, extents[k].start + z, count, run, refs);
+			for (j = 0; rst == EXIT_SUCCESS && j != count; j++) {
+				if (refs[j] != &run[j])
+					run[j] = *refs[j];
+				fill_bloc(&run[j], (size_t) (logical + z + j) * BLOC_SIZE, start, offset, &src, end);
+			}
+
+			if (rst == EXIT_SUCCESS)
+				rst = write_extent(fs, extents[k].start + z, run, count);
+			if (rst == EXIT_SUCCESS)
+				written = (size_t) (logical + z + count) * BLOC_SIZE;
+		}
+		logical += extents[k].length;
+	}
+	free(extents);
+
+	for (z = i->bloc_count; rst == EXIT_SUCCESS && z <= last; z += got) {
+		count = last - z + 1 < EXTENT_IO_BLOCS ? last - z + 1 : EXTENT_IO_BLOCS;
+		if (alloc_run(fs, BLOC_FLAG, extent_goal(fs, i), count, &slot, &got) != EXIT_SUCCESS) {
+			fprintf(stderr, "No bloc left %d\n", __LINE__);
+			rst = EXIT_FAILURE;
+			got = 0;
 		} else {
-			strncpy(b.content, buf + pos, n - 1);
-			b.content[n] = '\0';
-			done = 1;
+			memset(run, 0, got * sizeof(struct bloc));
+			for (j = 0; j != got; j++)
+				fill_bloc(&run[j], (size_t) (z + j) * BLOC_SIZE, start, offset, &src, end);
+
+			/* the file maps the run once it's written, else it's given back */
+			rst = write_extent(fs, slot + 1, run, got);
+			if (rst == EXIT_SUCCESS)
+				rst = extent_append(fs, i, slot + 1, got);
+			if (rst == EXIT_SUCCESS)
+				written = (size_t) (z + got) * BLOC_SIZE;
+			else
+				free_run(fs, BLOC_FLAG, slot, got);
 		}
+	}
 
-		update_bloc(&b);
-		z++;
+	free(run);
+
+	/* on a failure the file only grows over the bytes written before it */
+	if (written < end)
+		end = written;
+	if (end > i->size)
+		i->size = end;
+	i->updated_at = (int64_t) t;
+	update_inode(fs, i);
+
+	return rst;
+}
+
+/*
+ * Writes the n bytes of buf at offset in a file (see write_at)
+ * One transaction (see txn.c)
+ */
+int iwrite_at(struct fs *fs, struct file *f, size_t offset, char *buf, size_t n) {
+	struct iovec iov;
+	int rst;
+
+	iov.iov_base = buf;
+	iov.iov_len = n;
+
+	txn_begin(fs);
+	rst = write_at(fs, f, offset, &iov, 1);
+	if (txn_commit(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+
+	return rst;
+}
+
+/*
+ * Writes the bytes of iovcnt buffers one after the other at the position
+ * of the file, at its end with O_APPEND; the position moves past them
+ * The blocs are filled from the buffers in one pass (see write_at).
+ * One transaction (see txn.c)
+ */
+int iwritev(struct fs *fs, struct file *f, const struct iovec *iov, int iovcnt) {
+	if (f->flags & O_APPEND)
+		f->current_pos = f->inode.size;
+
+	txn_begin(fs);
+	if (write_at(fs, f, f->current_pos, iov, iovcnt) != EXIT_SUCCESS) {
+		txn_commit(fs);
+		return EXIT_FAILURE;
 	}
+	if (txn_commit(fs) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
 
-	if (done) {
-		new_bloc_count = z;
+	f->current_pos += iov_total(iov, iovcnt);
 
-		for (; z != i->bloc_count; z++) {
-			b = get_bloc_by_id(i->bloc_ids[z]);
-			delete_bloc(&b);
-		}
+	return EXIT_SUCCESS;
+}
 
-		i->bloc_count = new_bloc_count;
-	} else {
-		while (!done) {
-			if (n > strlen(b.content)) {
-				b = new_bloc("");
-				strncpy(b.content, buf + pos, BLOC_SIZE - 1);
-				pos += BLOC_SIZE - 1;
-				n -= BLOC_SIZE - 1;
-			} else {
-				b = new_bloc("");
-				strncpy(b.content, buf + pos, n - 1);
-				b.content[n] = '\0';
-				done = 1;
-			}
+/*
+ * Writes the n bytes of buf at the position of the file (see iwritev)
+ */
+int iwrite(struct fs *fs, struct file *f, char *buf, size_t n) {
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len = n;
+
+	return iwritev(fs, f, &iov, 1);
+}
+
+/**
+ * Shrinks a file to size bytes, the blocs past it are freed a run at a
+ * time (see extent_truncate)
+ * One transaction (see txn.c)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (wrong mode, broken chain)
+ */
+int itruncate(struct fs *fs, struct file *f, size_t size) {
+	struct bloc b;
+	time_t t;
+	struct inode *i;
+
+	if (!((f->flags & O_WRONLY) | (f->flags & O_RDWR))) {
 
-			add_bloc(i, &b);
-			write_bloc(&b);
+		fprintf(stderr, "Access denied, wrong mode %d\n", __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	i = &(f->inode);
+	if (size >= i->size)
+		return EXIT_SUCCESS;
+
+	txn_begin(fs);
+	if (extent_truncate(fs, i, (size + BLOC_SIZE - 1) / BLOC_SIZE) != EXIT_SUCCESS) {
+		txn_commit(fs);
+		return EXIT_FAILURE;
+	}
+
+	/* the last bloc kept loses its end */
+	if (size % BLOC_SIZE != 0) {
+		if (extent_unshare(fs, i, i->bloc_count - 1, i->bloc_count - 1) != EXIT_SUCCESS) {
+			txn_commit(fs);
+			return EXIT_FAILURE;
 		}
+		b = get_bloc_by_id(fs, bmap(fs, i, i->bloc_count - 1));
+		b.length = size % BLOC_SIZE;
+		memset(b.content + b.length, 0, BLOC_SIZE - b.length);
+		update_bloc(fs, &b);
 	}
 
-	i->updated_at = localtime(&t);
-	update_inode(i);
+	i->size = size;
+	if ((size_t) f->current_pos > size)
+		f->current_pos = size;
 
-	return EXIT_SUCCESS;
+	t = time(NULL);
+	i->updated_at = (int64_t) t;
+	update_inode(fs, i);
+
+	return txn_commit(fs);
 }
 
 
 /*
  * Creates the . dir
  */
-int create_dot_dir(struct inode *dir) {
+int create_dot_dir(struct fs *fs, struct inode *dir) {
 	struct bloc to_update;
 
-	to_update = add_inode_to_inode(dir, dir, ".");
-	update_bloc(&to_update);
+	to_update = add_inode_to_inode(fs, dir, dir, ".");
+	update_bloc(fs, &to_update);
 
 	return EXIT_SUCCESS;
 }
@@ -781,17 +1154,43 @@ int create_dot_dir(struct inode *dir) {
 /*
  * Creates the .. dir
  */
-int create_dotdot_dir(struct inode *parent, struct inode *dir) {
+int create_dotdot_dir(struct fs *fs, struct inode *parent, struct inode *dir) {
 	struct bloc to_update;
 
-	to_update = add_inode_to_inode(dir, parent, "..");
-	update_bloc(&to_update);
+	to_update = add_inode_to_inode(fs, dir, parent, "..");
+	update_bloc(fs, &to_update);
 
 	return EXIT_SUCCESS;
 }
 
 
 
+/*
+ * Looks up the id of a filename under a directory, in the dentry cache or
+ * in the bucket of the name only
+ *
+ * on failure: returns DELETED
+ */
+static unsigned int find_filename(struct fs *fs, struct inode *under_dir, char *filename) {
+	struct dir_iter it;
+	unsigned int id;
+
+	if (dcache_lookup(&fs->dcache, under_dir->id, filename, &id))
+		return id;
+
+	id = DELETED;
+	dir_iter_bucket(fs, &it, under_dir, filename);
+	while (id == DELETED && dir_iter_next(&it)) {
+		if (strcmp(it.name, filename) == 0)
+			id = it.id;
+	}
+
+	/* a missing name is cached too */
+	dcache_insert(&fs->dcache, under_dir->id, filename, id);
+
+	return id;
+}
+
 /*
  * Returns an inode matching the filename
  *
@@ -799,110 +1198,177 @@ int create_dotdot_dir(struct inode *parent, struct inode *dir) {
  * on failure: returns an empty inode
  * on success: returns the inode found
  */
-struct inode get_inode_by_filename(struct inode *under_dir, char *filename) {
-	struct inode i;
-	struct bloc b;
-	int linkcount;
-	int found;
-	unsigned int inode_id;
-	char name[FILENAME_COUNT];
-	int offset;
-	int z;
-	char *c;
-
-	found = 0;
-	i = empty_inode();
-	b = get_bloc_by_id(under_dir->bloc_ids[0]);
-	linkcount = ocr(b.content, ',');
-	offset = 0;
-	z = 0;
-
-	while (!found && z != linkcount) {
-
-		c = strchr(b.content + sizeof(char)*offset, ':');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%u", &inode_id);
-		*c = ':';
-		offset += get_index(b.content + offset, ':') + 1;
-		c = strchr(b.content + sizeof(char)*offset, ',');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%s", name);
-		*c = ',';
-		offset += get_index(b.content + offset, ',') + 1;
-
-		if (strcmp(name, filename) == 0) {
-			i = get_inode_by_id(inode_id);
-			found = 1;
-		}
-		z++;
-	}
+struct inode get_inode_by_filename(struct fs *fs, struct inode *under_dir, char *filename) {
+	return get_inode_by_id(fs, find_filename(fs, under_dir, filename));
+}
 
-	return i;
+/**
+ * Returns a pinned handle on the inode matching the filename (see iget)
+ *
+ * on failure: returns NULL
+ */
+struct inode *iget_by_filename(struct fs *fs, struct inode *under_dir, char *filename) {
+	return iget(fs, find_filename(fs, under_dir, filename));
 }
 
 /*
- * Returns a file
+ * Returns a file, created with O_CREAT, emptied with O_TRUNC
  *
  * success : returns the inode
  */
-struct file iopen(struct inode *under_dir, char *filename, int flags) {
+struct file iopen(struct fs *fs, struct inode *under_dir, char *filename, int flags) {
 	struct file f;
 	struct inode i;
 
-	i = get_inode_by_filename(under_dir, filename);
+	i = get_inode_by_filename(fs, under_dir, filename);
 
 	if (i.id == DELETED && (flags & O_CREAT) != 0) {
-		f = create_emptyfile(under_dir, filename, REGULAR_FILE);
+		f = create_emptyfile(fs, under_dir, filename, REGULAR_FILE);
 		f.flags = flags;
 	} else {
-		f = new_file(&i, flags);
+		f = new_file(fs, &i, flags);
+		if ((flags & O_TRUNC) != 0 && i.id != DELETED)
+			itruncate(fs, &f, 0);
 	}
 
 	return f;
 }
 
 /*
- * Reads n bytes of files pointed by inode i; the content
- * is stored in buf
+ * Reads the bytes of files pointed by inode i from offset into the
+ * buffers, one after the other; got is the number of bytes read
+ * The read stops at the end of the file.
+ *
+ * Byte k of a file is in its bloc k / BLOC_SIZE (see write_at): only the
+ * blocs of the range are read, with one read per extent (see read_extent).
  */
-int iread(struct file *f, char *buf, size_t n) {
-	int z;
-	int done;
-	struct bloc b;
-	int pos;
+static int read_at(struct fs *fs, struct file *f, size_t offset, const struct iovec *iov, int iovcnt, size_t *got) {
+	unsigned int k, z, j, count, first, last, logical;
+	int rst;
+	struct bloc *run;
+	const struct bloc *refs[EXTENT_IO_BLOCS];
+	struct extent *extents;
+	size_t n, len, from, pos;
+	struct iov_cursor dst;
 	struct inode i;
 
+	*got = 0;
 	if ( ( (f->flags & O_RDONLY) == 0 && (f->flags & O_RDWR) == 0) ) {
 		fprintf(stderr, "Access denied, wrong mode %d\n", __LINE__);
 		return EXIT_FAILURE;
 	}
 
 	i = f->inode;
-	done = 0;
-	z = 0;
-	pos = 0;
-	strcpy(buf, "");
+	n = iov_total(iov, iovcnt);
+	if (offset >= i.size || n == 0)
+		return EXIT_SUCCESS;
+	if (n > i.size - offset)
+		n = i.size - offset;
 
-	while (!done && z != i.bloc_count) {
-		b = get_bloc_by_id(i.bloc_ids[z]);
+	dst.iov = iov;
+	dst.iovcnt = iovcnt;
+	dst.index = 0;
+	dst.skip = 0;
 
-		if (b.id == DELETED) {
-			perror(BLOC_DELETED_MESSAGE);
-			continue;
-		}
+	first = offset / BLOC_SIZE;
+	last = (offset + n - 1) / BLOC_SIZE;
 
-		if ((int) n >= 1 + (int) strlen(b.content)) {
-			strcat(buf + pos, b.content);
-			n -= strlen(b.content);
-			pos += strlen(b.content);
-		} else {
-			strncat(buf + pos, b.content, n);
-			strcat(buf, "\0");
-			done = 1;
+	extents = get_extents(fs, &i);
+	run = (struct bloc *) malloc(EXTENT_IO_BLOCS * sizeof(struct bloc));
+	if (run == NULL) {
+		free(extents);
+		return EXIT_FAILURE;
+	}
+
+	rst = extents == NULL ? EXIT_FAILURE : EXIT_SUCCESS;
+	pos = 0;
+	logical = 0;
+	for (k = 0; rst == EXIT_SUCCESS && pos != n && k != (unsigned int) i.extent_count; k++) {
+		/* the blocs of the extent in the range, from logical + z */
+		z = first > logical ? first - logical : 0;
+		for (; rst == EXIT_SUCCESS && pos != n && z < extents[k].length; z += count) {
+			count = extents[k].length - z;
+			if (count > last - (logical + z) + 1)
+				count = last - (logical + z) + 1;
+			if (count > EXTENT_IO_BLOCS)
+				count = EXTENT_IO_BLOCS;
+
+			rst = read_extent(fs, extents[k].start + z, count, run, refs);
+			for (j = 0; rst == EXIT_SUCCESS && j != count; j++) {
+				from = logical + z + j == first ? offset % BLOC_SIZE : 0;
+				len = refs[j]->length < BLOC_SIZE ? refs[j]->length : BLOC_SIZE;
+				len = len > from ? len - from : 0;
+				if (len > n - pos)
+					len = n - pos;
+
+				iov_copy(&dst, (char *) refs[j]->content + from, len, 1);
+				pos += len;
+			}
 		}
-		z++;
+		logical += extents[k].length;
 	}
 
+	if (rst != EXIT_SUCCESS)
+		perror(BLOC_DELETED_MESSAGE);
+
+	free(run);
+	free(extents);
+	*got = pos;
+
+	return rst;
+}
+
+/*
+ * Reads n bytes of files pointed by inode i from offset; the content
+ * is stored in buf, followed by a '\0' (buf holds n + 1 bytes)
+ */
+int iread_at(struct fs *fs, struct file *f, size_t offset, char *buf, size_t n) {
+	struct iovec iov;
+	size_t got;
+	int rst;
+
+	iov.iov_base = buf;
+	iov.iov_len = n;
+
+	rst = read_at(fs, f, offset, &iov, 1, &got);
+	buf[got] = '\0';
+
+	return rst;
+}
+
+/*
+ * Reads the bytes of files pointed by inode i from the position of the
+ * file into iovcnt buffers, one after the other; the position moves past
+ * them. The buffers are filled from the blocs in one pass (see read_at).
+ */
+int ireadv(struct fs *fs, struct file *f, const struct iovec *iov, int iovcnt) {
+	size_t got;
+
+	if (read_at(fs, f, f->current_pos, iov, iovcnt, &got) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	f->current_pos += got;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Reads n bytes of files pointed by inode i from the position of the
+ * file, followed by a '\0' (see ireadv)
+ */
+int iread(struct fs *fs, struct file *f, char *buf, size_t n) {
+	size_t offset;
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len = n;
+
+	offset = f->current_pos;
+	if (ireadv(fs, f, &iov, 1) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	buf[f->current_pos - offset] = '\0';
+
 	return EXIT_SUCCESS;
 }
 
@@ -910,7 +1376,7 @@ int iread(struct file *f, char *buf, size_t n) {
 /*
  * TODO what's it for ?
  */
-int iclose(struct file *f) {
+int iclose(struct fs *fs, struct file *f) {
 	(void) f;
 	return EXIT_FAILURE;
 }
@@ -920,36 +1386,19 @@ int iclose(struct file *f) {
  *
  * note: don't forget to free the array
  */
-char **list_files(struct inode *dir, int *filecount) {
+char **list_files(struct fs *fs, struct inode *dir, int *filecount) {
 	char **files;
-	struct bloc b;
-	unsigned int inode_id;
-	char name[FILENAME_COUNT];
-	int offset;
+	struct dir_iter it;
 	int z;
-	char *c;
 
-	b = get_bloc_by_id(dir->bloc_ids[0]);
-	*filecount = ocr(b.content, ',');
-	offset = 0;
-	z = 0;
+	*filecount = get_filecount(fs, dir);
 	files = NULL;
 	files = init_str_array(*filecount, FILENAME_COUNT);
+	z = 0;
 
-	while (z != *filecount) {
-
-		c = strchr(b.content + sizeof(char)*offset, ':');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%u", &inode_id);
-		*c = ':';
-		offset += get_index(b.content + offset, ':') + 1;
-		c = strchr(b.content + sizeof(char)*offset, ',');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%s", name);
-		*c = ',';
-		offset += get_index(b.content + offset, ',') + 1;
-
-		strncpy(files[z], name, FILENAME_COUNT);
+	dir_iter_init(fs, &it, dir);
+	while (z != *filecount && dir_iter_next(&it)) {
+		strncpy(files[z], it.name, FILENAME_COUNT - 1);
 		z++;
 	}
 
@@ -958,64 +1407,27 @@ char **list_files(struct inode *dir, int *filecount) {
 
 /*
  * Remove an inode from a directory, that is,
- * remove the inode id from the bloc content
- * the ids are stored like that "12,432,4324,"
+ * remove the entry of its name from the bucket of the name
  *
  * returns the bloc to be updated
  */
-struct bloc remove_inode_from_directory(struct inode *dir, unsigned int id) {
-	struct bloc b;
+struct bloc remove_inode_from_directory(struct fs *fs, struct inode *dir, char *filename) {
+	struct dir_iter it;
 	int found;
-	unsigned int linkcount;
-	int z;
-	unsigned int inode_id;
-	char name[FILENAME_COUNT];
-	int offset, initial_offset = 0;
-	char *c;
 
-	found = 0;
-	b = get_bloc_by_id(dir->bloc_ids[0]);
-	linkcount = ocr(b.content, ',');
-	offset = 0;
-	initial_offset = 0;
-	z = 0;
+	dcache_drop(&fs->dcache, dir->id, filename);
 
-	while (!found && z != linkcount) {
-		initial_offset = offset;
-
-		c = strchr(b.content + sizeof(char)*offset, ':');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%u", &inode_id);
-		*c = ':';
-		offset += get_index(b.content + offset, ':') + 1;
-		c = strchr(b.content + sizeof(char)*offset, ',');
-		*c = '\0';
-		sscanf(b.content + sizeof(char)*offset, "%s", name);
-		*c = ',';
-		offset += get_index(b.content + offset, ',') + 1;
-
-		if (inode_id == id) {
-			found = 1;
-		}
-		/*
-		if (strcmp(name, filename) == 0) {
+	found = 0;
+	dir_iter_bucket(fs, &it, dir, filename);
+	while (!found && dir_iter_next(&it)) {
+		if (strcmp(it.name, filename) == 0) {
+			dirent_remove(&it.b, it.offset);
+			dcache_name_drop(&fs->dcache, it.id);
 			found = 1;
 		}
-
-		 */
-		z++;
-	}
-
-	if (found) {
-		while (b.content[offset] != '\0') {
-			b.content[initial_offset] = b.content[offset];
-			offset++;
-			initial_offset++;
-		}
-		b.content[initial_offset] = '\0';
 	}
 
-	return b;
+	return it.b;
 }
 
 /*
@@ -1023,42 +1435,137 @@ struct bloc remove_inode_from_directory(struct inode *dir, unsigned int id) {
  *
  * exception: directory is not empty, file's not a directory
  */
-int remove_empty_directory(struct inode *under_dir, char *dirname) {
-	return remove_file(under_dir, dirname, DIRECTORY);
+int remove_empty_directory(struct fs *fs, struct inode *under_dir, char *dirname) {
+	return remove_file(fs, under_dir, dirname, DIRECTORY);
 }
 
 
 /*
  * Moves a file from an inode to another inode
+ * One transaction (see txn.c)
  */
-int move_file(struct inode *from, char *filename, struct inode *to) {
-	struct inode i;
+int move_file(struct fs *fs, struct inode *from, char *filename, struct inode *to) {
+	struct inode *i;
 	struct bloc to_update;
 
-	i = get_inode_by_filename(from, filename);
+	i = iget_by_filename(fs, from, filename);
+	if (i == NULL)
+		return EXIT_FAILURE;
+	if (!name_available(fs, to, filename)) {
+		iput(fs, i);
+		return EXIT_FAILURE;
+	}
 
-	to_update = remove_inode_from_directory(from, i.id);
-	update_bloc(&to_update);
-	to_update = add_inode_to_inode(to, &i, filename);
-	update_bloc(&to_update);
+	txn_begin(fs);
+	to_update = remove_inode_from_directory(fs, from, filename);
+	update_bloc(fs, &to_update);
+	to_update = add_inode_to_inode(fs, to, i, filename);
+	update_bloc(fs, &to_update);
+
+	/* a directory gets its new parent */
+	if (i->type == DIRECTORY) {
+		to_update = remove_inode_from_directory(fs, i, "..");
+		update_bloc(fs, &to_update);
+		create_dotdot_dir(fs, to, i);
+	}
+	iput(fs, i);
 
-	return EXIT_SUCCESS;
+	return txn_commit(fs);
 }
 
 /*
- * Copies a file from an inode to another
+ * Copies a file under a name in a directory
+ * A regular file gets a new inode sharing the blocs of i, whatever its
+ * size only its extents are written (see share.c); its blocs are copied
+ * on their first write (see extent_unshare). A directory is copied entry
+ * by entry, skip is its copy (a directory copied into itself).
  */
-int copy_file(struct inode *from, char *filename, char *to) {
-	struct inode i, to_dir;
+static int reflink(struct fs *fs, struct inode *i, struct inode *dir, char *name, unsigned int skip) {
+	struct inode copy, child;
+	struct extent *extents;
+	struct dir_iter it;
 	struct bloc to_update;
+	int z, rst;
 
-	i = get_inode_by_filename(from, filename);
+	if (i->type == DIRECTORY) {
+		copy = create_directory(fs, dir, name);
+		if (copy.id == DELETED)
+			return EXIT_FAILURE;
+		if (skip == DELETED)
+			skip = copy.id;
 
-	to_dir = get_inode_by_filename(from, to);
-	to_update = add_inode_to_inode(&to_dir, &i, filename);
-	update_bloc(&to_update);
+		rst = EXIT_SUCCESS;
+		dir_iter_init(fs, &it, i);
+		while (rst == EXIT_SUCCESS && dir_iter_next(&it)) {
+			if (it.id == skip || strcmp(it.name, ".") == 0 || strcmp(it.name, "..") == 0)
+				continue;
 
-	return EXIT_SUCCESS;
+			child = get_inode_by_id(fs, it.id);
+			rst = reflink(fs, &child, &copy, it.name, skip);
+		}
+
+		return rst;
+	}
+
+	if (!name_available(fs, dir, name))
+		return EXIT_FAILURE;
+
+	copy = new_inode(i->type, i->permissions, i->user_name, i->group_name);
+	copy.size = i->size;
+
+	rst = EXIT_SUCCESS;
+	extents = get_extents(fs, i);
+	for (z = 0; rst == EXIT_SUCCESS && extents != NULL && z != i->extent_count; z++) {
+		rst = share_add(fs, extents[z].start, extents[z].length, 1);
+		if (rst == EXIT_SUCCESS)
+			rst = extent_append(fs, &copy, extents[z].start, extents[z].length);
+	}
+	free(extents);
+
+	if (rst != EXIT_SUCCESS || write_inode(fs, &copy) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	to_update = add_inode_to_inode(fs, dir, &copy, name);
+
+	return update_bloc(fs, &to_update);
+}
+
+/**
+ * Copies a file of a directory: into the directory to when there is one
+ * of that name, else to a new file named to next to it
+ * The copy is a new file: the writes to one don't show in the other.
+ * One transaction (see txn.c)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no such file, name taken, no bloc
+ * left)
+ */
+int copy_file(struct fs *fs, struct inode *from, char *filename, char *to) {
+	struct inode i, to_dir, *dir;
+	char *name;
+	int rst;
+
+	i = get_inode_by_filename(fs, from, filename);
+	to_dir = get_inode_by_filename(fs, from, to);
+
+	dir = from;
+	name = to;
+	if (to_dir.id != DELETED && to_dir.type == DIRECTORY) {
+		dir = &to_dir;
+		name = filename;
+	}
+
+	if (i.id == DELETED || get_inode_by_filename(fs, dir, name).id != DELETED) {
+		fprintf(stderr, "Can't copy %s to %s %d\n", filename, to, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	txn_begin(fs);
+	rst = reflink(fs, &i, dir, name, DELETED);
+	if (txn_commit(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+
+	return rst;
 }
 
 
@@ -1109,23 +1616,25 @@ int remove_int(int **int_array, unsigned int *len, int i) {
  * TODO
  */
 /*
-int link_inode(struct inode *from_dir, char *filename, char *linkname) {
+int link_inode(struct fs *fs, struct inode *from_dir, char *filename, char *linkname) {
 	struct inode link, i;
 	struct bloc to_update;
 	int z;
 
-	i = get_inode_by_filename(from_dir, filename);
+	i = get_inode_by_filename(fs, from_dir, filename);
 	link = new_inode(i.type, i.permissions, i.user_name, i.group_name);
 
-	for (z = 0; z != i.bloc_count; z++) {
-		link.bloc_ids[z] = i.bloc_ids[z];
+	for (z = 0; z != i.extent_count && z != EXTENT_COUNT; z++) {
+		link.extents[z] = i.extents[z];
 	}
 
+	link.extent_count = i.extent_count;
+	link.overflow = i.overflow;
 	link.bloc_count = i.bloc_count;
-	write_inode(&link);
+	write_inode(fs, &link);
 
-	to_update = add_inode_to_inode(from_dir, &link, filename);
-	update_bloc(&to_update);
+	to_update = add_inode_to_inode(fs, from_dir, &link, filename);
+	update_bloc(fs, &to_update);
 
 	return EXIT_SUCCESS;
 }
@@ -1135,11 +1644,11 @@ int link_inode(struct inode *from_dir, char *filename, char *linkname) {
  * TODO
  */
 /*
-int unlink_inode(struct inode *from_dir, char *linkname) {
+int unlink_inode(struct fs *fs, struct inode *from_dir, char *linkname) {
 	struct inode link;
 
-	link = get_inode_by_filename(from_dir, linkname);
-	remove_inode_from_directory(from_dir, link.id);
+	link = get_inode_by_filename(fs, from_dir, linkname);
+	remove_inode_from_directory(fs, from_dir, linkname);
 
 	return EXIT_SUCCESS;
 }
@@ -1151,9 +1660,10 @@ int unlink_inode(struct inode *from_dir, char *linkname) {
 
 /*
  * Initialize a new file
- * TODO O_APPEND O_TRUNC flags
+ * With O_APPEND the position is the end of the file (iwrite keeps it
+ * there), O_TRUNC is done by iopen (see itruncate)
  */
-struct file new_file(struct inode *i, int flags) {
+struct file new_file(struct fs *fs, struct inode *i, int flags) {
 	struct file f;
 
 	memset(&f, 0, sizeof(struct file));
@@ -1161,7 +1671,7 @@ struct file new_file(struct inode *i, int flags) {
 	f.flags = flags;
 
 	if (flags & O_APPEND) {
-		f.current_pos = get_total_strlen(i);
+		f.current_pos = get_total_strlen(fs, i);
 	} else {
 		f.current_pos = 0;
 	}
@@ -1171,16 +1681,12 @@ struct file new_file(struct inode *i, int flags) {
 
 /*
  * Returns the total length of a file
- * pointed by an inode
+ * pointed by an inode (kept in the inode, nothing is read)
  */
-size_t get_total_strlen(struct inode *i) {
-	struct bloc b;
-	int bloc_count;
-
-	bloc_count = i->bloc_count;
-	b = get_bloc_by_id(i->bloc_ids[bloc_count - 1]);
+size_t get_total_strlen(struct fs *fs, struct inode *i) {
+	(void) fs;
 
-	return (bloc_count - 1) * (BLOC_SIZE - 1) + strlen(b.content);
+	return i->size;
 }
 
 void ch_dir(unsigned int inodeid){
@@ -1191,9 +1697,9 @@ void ch_dir(unsigned int inodeid){
 	setenv("SYSD_CURDIR", buff, 1);/* 1 is for overwrite */
 }
 
-char * get_filename_for_inodeID(struct inode *under_dir, unsigned int id) {
-	struct inode i = get_inode_by_id(id);
-	char * fn = get_filename_for_inode(under_dir, &i );
+char * get_filename_for_inodeID(struct fs *fs, struct inode *under_dir, unsigned int id) {
+	struct inode i = get_inode_by_id(fs, id);
+	char * fn = get_filename_for_inode(fs, under_dir, &i );
 	return fn;
 }
 
@@ -8,12 +8,21 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 #include "utils.h"
 #include "../utils/str_utils.h"
 #include "./inode.h"
 #include "./bloc.h"
+#include "./idmap.h"
+#include "./disk.h"
+#include "./bitmap.h"
+#include "./extent.h"
+#include "./share.h"
+#include "./defrag.h"
+#include "./dir.h"
+#include "./path.h"
 #include <sys/ipc.h>
 #include <sys/shm.h>
 
@@ -50,54 +59,64 @@ struct file {
 	int current_pos;
 };
 
-struct file new_file(struct inode *i, int flags);
-size_t get_total_strlen(struct inode *i);
+struct file new_file(struct fs *fs, struct inode *i, int flags);
+size_t get_total_strlen(struct fs *fs, struct inode *i);
 
 void initFS();
-char *get_filename_for_inode(struct inode *under_dir, struct inode *i);
-int clean_disk();
-int create_dot_dir(struct inode *dir);
-int create_dotdot_dir(struct inode *parent, struct inode *dir);
-int delete_bloc(struct bloc *b);
-int delete_inode(struct inode *i);
-int get_inodes(struct inode *under_dir, struct inode **inodes);
-int overwrite_bloc(struct bloc *new_bloc, unsigned int id);
-int overwrite_inode(struct inode *new_inode, unsigned int id);
-int print_disk();
-struct bloc remove_inode_from_directory(struct inode *dir, unsigned int id);
-int update_bloc(struct bloc *new_bloc);
-int update_inode(struct inode *new_inode);
-int write_bloc(struct bloc *b);
-int write_inode(struct inode *i);
-struct bloc add_inode_to_inode(struct inode *dir, struct inode *i, char *name);
-struct bloc get_bloc_by_id(unsigned int bloc_id);
-struct inode create_disk();
-struct inode create_root();
-struct inode get_inode_by_filename(struct inode *under_dir, char *filename);
-struct inode get_inode_by_id(unsigned int inode_id);
-unsigned int get_filecount(struct inode *dir);
-char *get_dirname_by_id(unsigned int id);
-char *get_dirname(struct inode *dir);
-void disk_free(unsigned int *blocs_available, unsigned int *inodes_available, size_t *bytes_available);
+char *get_filename_for_inode(struct fs *fs, struct inode *under_dir, struct inode *i);
+int clean_disk(struct fs *fs);
+int create_dot_dir(struct fs *fs, struct inode *dir);
+int create_dotdot_dir(struct fs *fs, struct inode *parent, struct inode *dir);
+int delete_bloc(struct fs *fs, struct bloc *b);
+int delete_inode(struct fs *fs, struct inode *i);
+int get_inodes(struct fs *fs, struct inode *under_dir, struct inode **inodes);
+int overwrite_bloc(struct fs *fs, struct bloc *new_bloc, unsigned int id);
+int overwrite_inode(struct fs *fs, struct inode *new_inode, unsigned int id);
+int print_disk(struct fs *fs);
+struct bloc remove_inode_from_directory(struct fs *fs, struct inode *dir, char *filename);
+int update_bloc(struct fs *fs, struct bloc *new_bloc);
+int update_inode(struct fs *fs, struct inode *new_inode);
+int write_bloc(struct fs *fs, struct bloc *b);
+int write_inode(struct fs *fs, struct inode *i);
+struct bloc add_inode_to_inode(struct fs *fs, struct inode *dir, struct inode *i, char *name);
+struct bloc get_bloc_by_id(struct fs *fs, unsigned int bloc_id);
+const struct bloc *bloc_ref(struct fs *fs, unsigned int bloc_id, struct bloc *tmp);
+struct inode create_disk(struct fs *fs);
+struct inode create_root(struct fs *fs);
+struct inode get_inode_by_filename(struct fs *fs, struct inode *under_dir, char *filename);
+struct inode get_inode_by_id(struct fs *fs, unsigned int inode_id);
+struct inode *iget(struct fs *fs, unsigned int inode_id);
+struct inode *iget_by_filename(struct fs *fs, struct inode *under_dir, char *filename);
+int idirty(struct fs *fs, struct inode *i);
+void iput(struct fs *fs, struct inode *i);
+unsigned int get_filecount(struct fs *fs, struct inode *dir);
+char *get_dirname_by_id(struct fs *fs, unsigned int id);
+char *get_dirname(struct fs *fs, struct inode *dir);
+void disk_free(struct fs *fs, unsigned int *blocs_available, unsigned int *inodes_available, size_t *bytes_available);
 
-char **list_files(struct inode *dir, int *filecount);
-int copy_file(struct inode *from, char *filename, char *to);
-int iread(struct file *f, char *buf, size_t n);
-int iwrite(struct file *f, char *buf, size_t n);
-int link_inode(struct inode *from_dir, char *filename, char *linkname);
-int move_file(struct inode *from, char *filename, struct inode *to);
-int unlink_inode(struct inode *from_dir, char *linkname);
-struct file create_emptyfile(struct inode *under_dir, char *filename, enum filetype type);
-struct file create_regularfile(struct inode *under_dir, char *filename, char *content, int flags);
-struct file iopen(struct inode *under_dir, char *filename, int flags);
+char **list_files(struct fs *fs, struct inode *dir, int *filecount);
+int copy_file(struct fs *fs, struct inode *from, char *filename, char *to);
+int iread(struct fs *fs, struct file *f, char *buf, size_t n);
+int iread_at(struct fs *fs, struct file *f, size_t offset, char *buf, size_t n);
+int ireadv(struct fs *fs, struct file *f, const struct iovec *iov, int iovcnt);
+int iwrite(struct fs *fs, struct file *f, char *buf, size_t n);
+int iwrite_at(struct fs *fs, struct file *f, size_t offset, char *buf, size_t n);
+int iwritev(struct fs *fs, struct file *f, const struct iovec *iov, int iovcnt);
+int itruncate(struct fs *fs, struct file *f, size_t size);
+int link_inode(struct fs *fs, struct inode *from_dir, char *filename, char *linkname);
+int move_file(struct fs *fs, struct inode *from, char *filename, struct inode *to);
+int unlink_inode(struct fs *fs, struct inode *from_dir, char *linkname);
+struct file create_emptyfile(struct fs *fs, struct inode *under_dir, char *filename, enum filetype type);
+struct file create_regularfile(struct fs *fs, struct inode *under_dir, char *filename, char *content, int flags);
+struct file iopen(struct fs *fs, struct inode *under_dir, char *filename, int flags);
 
-struct inode create_directory(struct inode *under_dir, char *dirname);
-int remove_empty_directory(struct inode *under_dir, char *dirname);
-int remove_file(struct inode *under_dir, char *filename, enum filetype ft);
+struct inode create_directory(struct fs *fs, struct inode *under_dir, char *dirname);
+int remove_empty_directory(struct fs *fs, struct inode *under_dir, char *dirname);
+int remove_file(struct fs *fs, struct inode *under_dir, char *filename, enum filetype ft);
 
 int remove_int(int **int_array, unsigned int *len, int i);
 void ch_dir(unsigned int inodeid);
-char * get_filename_for_inodeID(struct inode *under_dir, unsigned int id);
+char * get_filename_for_inodeID(struct fs *fs, struct inode *under_dir, unsigned int id);
 unsigned int get_pwd_id();
 void update_path(unsigned int inodeid);
 #endif
@@ -0,0 +1,236 @@
+#include "./icache.h"
+#include "./fs.h"
+
+/**
+ * Allocates an empty cache of size inodes
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (out of memory)
+ */
+int icache_init(struct icache *c, size_t size) {
+	memset(c, 0, sizeof(struct icache));
+
+	if (size == 0)
+		size = 1;
+
+	c->entries = (struct icache_entry **) calloc(size, sizeof(struct icache_entry *));
+	if (c->entries == NULL) return EXIT_FAILURE;
+
+	c->size = size;
+	idmap_init(&c->ids);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Releases the memory of the cache, dirty inodes are lost (see icache_flush)
+ */
+void icache_free(struct icache *c) {
+	size_t z;
+
+	for (z = 0; z < c->size; z++)
+		free(c->entries[z]);
+
+	free(c->entries);
+	idmap_free(&c->ids);
+	memset(c, 0, sizeof(struct icache));
+}
+
+/*
+ * Forgets the inodes, dirty inodes are lost (see icache_flush)
+ * The pinned inodes stay, they're read again on their next iget
+ */
+void icache_invalidate(struct icache *c) {
+	struct icache_entry *e;
+	size_t z;
+
+	for (z = 0; z < c->size; z++) {
+		e = c->entries[z];
+		if (e == NULL || e->id == DELETED) continue;
+
+		e->dirty = 0;
+		if (e->refcount > 0) {
+			e->stale = 1;
+			continue;
+		}
+
+		idmap_remove(&c->ids, e->id);
+		e->id = DELETED;
+	}
+}
+
+/**
+ * Looks up an inode by its id
+ *
+ * on success : returns its entry
+ * on failure : returns NULL (not cached, or to read again)
+ */
+struct icache_entry *icache_lookup(struct icache *c, unsigned int id) {
+	long z;
+
+	if (c->entries == NULL || !idmap_get(&c->ids, id, &z) || c->entries[z]->stale) {
+		c->misses++;
+		return NULL;
+	}
+
+	c->hits++;
+	c->entries[z]->referenced = 1;
+
+	return c->entries[z];
+}
+
+/*
+ * Writes a dirty entry back to the disk
+ */
+static int write_back(struct fs *fs, struct icache_entry *e) {
+	if (!e->dirty) return EXIT_SUCCESS;
+
+	if (disk_write(fs, e->offset, &e->inode, sizeof(struct inode)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+	e->dirty = 0;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Chooses the entry to reuse: an empty one, or the first one neither
+ * pinned nor referenced since the last sweep of the hand
+ * A dirty entry that can't be written back is kept. When every inode is
+ * pinned (or can't be written back) the cache grows by one entry.
+ */
+static long victim(struct fs *fs) {
+	struct icache *c;
+	struct icache_entry *e, **entries;
+	size_t z;
+
+	c = &fs->icache;
+	for (z = 0; z != 2 * c->size; z++) {
+		e = c->entries[c->hand];
+		c->hand = (c->hand + 1) % c->size;
+
+		if (e == NULL || e->id == DELETED) return (c->hand + c->size - 1) % c->size;
+		if (e->refcount > 0) continue;
+
+		if (e->referenced) {
+			e->referenced = 0;
+			continue;
+		}
+
+		if (write_back(fs, e) != EXIT_SUCCESS) continue;
+		idmap_remove(&c->ids, e->id);
+		e->id = DELETED;
+
+		return (c->hand + c->size - 1) % c->size;
+	}
+
+	entries = (struct icache_entry **) realloc(c->entries, (c->size + 1) * sizeof(struct icache_entry *));
+	if (entries == NULL) return -1;
+
+	c->entries = entries;
+	c->entries[c->size] = NULL;
+
+	return c->size++;
+}
+
+/**
+ * Caches an inode read or written at offset, evicts another one if needed
+ * (written back first if dirty)
+ * An entry already cached for this id is refreshed, its pins are kept
+ *
+ * on success : returns the entry
+ * on failure : returns NULL (out of memory)
+ */
+struct icache_entry *icache_insert(struct fs *fs, long offset, const struct inode *i, int dirty) {
+	struct icache *c;
+	struct icache_entry *e;
+	long z;
+
+	c = &fs->icache;
+	if (c->entries == NULL || i->id == DELETED) return NULL;
+
+	if (!idmap_get(&c->ids, i->id, &z)) {
+		z = victim(fs);
+		if (z < 0) return NULL;
+
+		if (c->entries[z] == NULL)
+			c->entries[z] = (struct icache_entry *) calloc(1, sizeof(struct icache_entry));
+		if (c->entries[z] == NULL) return NULL;
+
+		c->entries[z]->refcount = 0;
+		c->entries[z]->dirty = 0;
+		idmap_put(&c->ids, i->id, z);
+	}
+
+	e = c->entries[z];
+	e->inode = *i;
+	e->id = i->id;
+	e->offset = offset;
+	e->dirty = e->dirty || dirty;
+	e->stale = 0;
+	e->referenced = 1;
+
+	return e;
+}
+
+/**
+ * Updates a cached inode, it's written back later
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (not cached)
+ */
+int icache_update(struct icache *c, struct inode *i) {
+	struct icache_entry *e;
+	long z;
+
+	if (c->entries == NULL || !idmap_get(&c->ids, i->id, &z)) return EXIT_FAILURE;
+
+	e = c->entries[z];
+	if (&e->inode != i)
+		e->inode = *i;
+	e->dirty = 1;
+	e->stale = 0;
+	e->referenced = 1;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Forgets an inode without writing it back (the inode got deleted)
+ * A handle still pinned on it keeps the last content
+ */
+void icache_drop(struct icache *c, unsigned int id) {
+	long z;
+
+	if (c->entries == NULL || !idmap_get(&c->ids, id, &z)) return;
+
+	c->entries[z]->dirty = 0;
+	if (c->entries[z]->refcount > 0) {
+		c->entries[z]->stale = 1;
+		return;
+	}
+
+	c->entries[z]->id = DELETED;
+	idmap_remove(&c->ids, id);
+}
+
+/**
+ * Writes every dirty inode back to the disk
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int icache_flush(struct fs *fs) {
+	struct icache *c;
+	size_t z;
+	int rst;
+
+	c = &fs->icache;
+	rst = EXIT_SUCCESS;
+	for (z = 0; z < c->size; z++) {
+		if (c->entries[z] != NULL && c->entries[z]->id != DELETED
+				&& write_back(fs, c->entries[z]) != EXIT_SUCCESS)
+			rst = EXIT_FAILURE;
+	}
+
+	return rst;
+}
@@ -0,0 +1,55 @@
+#ifndef ICACHE_H
+#define ICACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "./inode.h"
+#include "./idmap.h"
+
+#define DEFAULT_ICACHE_SIZE (32)
+
+/*
+ * A cached inode
+ * The inode comes first so a handle (struct inode *) is also its entry
+ */
+struct icache_entry {
+	struct inode inode;
+
+	unsigned int id;
+	long offset;
+	int refcount;
+	int dirty;
+	int stale;
+	int referenced;
+};
+
+/*
+ * Cache of the inodes of a mounted disk (CLOCK eviction)
+ *
+ * iget hands out pinned pointers to the cached inodes, a pinned inode is
+ * never evicted, iput unpins it. Updates are applied to the cached inode
+ * and written back when it's evicted or when the cache is flushed.
+ * The entries are allocated one by one so the handles never move.
+ */
+struct icache {
+	struct icache_entry **entries;
+	size_t size;
+	size_t hand;
+	struct idmap ids;
+
+	unsigned long hits;
+	unsigned long misses;
+};
+
+struct fs;
+
+int icache_flush(struct fs *fs);
+int icache_init(struct icache *c, size_t size);
+int icache_update(struct icache *c, struct inode *i);
+struct icache_entry *icache_insert(struct fs *fs, long offset, const struct inode *i, int dirty);
+struct icache_entry *icache_lookup(struct icache *c, unsigned int id);
+void icache_drop(struct icache *c, unsigned int id);
+void icache_free(struct icache *c);
+void icache_invalidate(struct icache *c);
+
+#endif
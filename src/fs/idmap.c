@@ -0,0 +1,157 @@
+#include "./idmap.h"
+
+#define IDMAP_MIN_CAPACITY (64)
+
+/*
+ * Spreads the bits of an id (ids are often small or sequential)
+ */
+static size_t idmap_hash(unsigned int key, size_t capacity) {
+	key ^= key >> 16;
+	key *= 0x45d9f3b;
+	key ^= key >> 16;
+
+	return key & (capacity - 1);
+}
+
+/*
+ * Doubles the capacity of the map and reinserts every key
+ */
+static int idmap_grow(struct idmap *m) {
+	struct idmap bigger;
+	size_t z;
+
+	bigger.capacity = m->capacity ? m->capacity * 2 : IDMAP_MIN_CAPACITY;
+	bigger.count = 0;
+	bigger.keys = (unsigned int *) calloc(bigger.capacity, sizeof(unsigned int));
+	bigger.values = (long *) calloc(bigger.capacity, sizeof(long));
+
+	if (bigger.keys == NULL || bigger.values == NULL) {
+		free(bigger.keys);
+		free(bigger.values);
+		return EXIT_FAILURE;
+	}
+
+	for (z = 0; z != m->capacity; z++) {
+		if (m->keys[z] != IDMAP_EMPTY)
+			idmap_put(&bigger, m->keys[z], m->values[z]);
+	}
+
+	idmap_free(m);
+	*m = bigger;
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Initialize an empty map, nothing is allocated until the first put
+ */
+void idmap_init(struct idmap *m) {
+	memset(m, 0, sizeof(struct idmap));
+}
+
+/*
+ * Releases the memory of the map
+ */
+void idmap_free(struct idmap *m) {
+	free(m->keys);
+	free(m->values);
+	idmap_init(m);
+}
+
+/*
+ * Removes every key, keeps the memory
+ */
+void idmap_clear(struct idmap *m) {
+	if (m->capacity == 0) return;
+
+	memset(m->keys, 0, m->capacity * sizeof(unsigned int));
+	m->count = 0;
+}
+
+/**
+ * Looks up a key
+ *
+ * on success : returns 1 and stores the value in *value
+ * on failure : returns 0
+ */
+int idmap_get(struct idmap *m, unsigned int key, long *value) {
+	size_t z;
+
+	if (m->capacity == 0 || key == IDMAP_EMPTY) return 0;
+
+	for (z = idmap_hash(key, m->capacity); m->keys[z] != IDMAP_EMPTY; z = (z + 1) & (m->capacity - 1)) {
+		if (m->keys[z] == key) {
+			*value = m->values[z];
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Inserts or replaces a key
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (key 0, out of memory)
+ */
+int idmap_put(struct idmap *m, unsigned int key, long value) {
+	size_t z;
+
+	if (key == IDMAP_EMPTY) return EXIT_FAILURE;
+
+	/* keep the load under 70% so probes stay short */
+	if ((m->count + 1) * 10 > m->capacity * 7 && idmap_grow(m) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	for (z = idmap_hash(key, m->capacity); m->keys[z] != IDMAP_EMPTY; z = (z + 1) & (m->capacity - 1)) {
+		if (m->keys[z] == key) {
+			m->values[z] = value;
+			return EXIT_SUCCESS;
+		}
+	}
+
+	m->keys[z] = key;
+	m->values[z] = value;
+	m->count++;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Removes a key, the following keys of the cluster are shifted back
+ * so lookups never need tombstones
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (key not found)
+ */
+int idmap_remove(struct idmap *m, unsigned int key) {
+	size_t z, next, home;
+
+	if (m->capacity == 0 || key == IDMAP_EMPTY) return EXIT_FAILURE;
+
+	for (z = idmap_hash(key, m->capacity); m->keys[z] != key; z = (z + 1) & (m->capacity - 1)) {
+		if (m->keys[z] == IDMAP_EMPTY)
+			return EXIT_FAILURE;
+	}
+
+	next = z;
+	for (;;) {
+		next = (next + 1) & (m->capacity - 1);
+		if (m->keys[next] == IDMAP_EMPTY)
+			break;
+
+		home = idmap_hash(m->keys[next], m->capacity);
+		/* the key at next can move back to z only if z is between its home and next */
+		if ((next > z && (home <= z || home > next)) || (next < z && (home <= z && home > next))) {
+			m->keys[z] = m->keys[next];
+			m->values[z] = m->values[next];
+			z = next;
+		}
+	}
+
+	m->keys[z] = IDMAP_EMPTY;
+	m->count--;
+
+	return EXIT_SUCCESS;
+}
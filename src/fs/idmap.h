@@ -0,0 +1,29 @@
+#ifndef IDMAP_H
+#define IDMAP_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define IDMAP_EMPTY (0)
+
+/*
+ * Hash map from a non-zero id to a long (open addressing, linear probing)
+ *
+ * note: the key 0 is reserved to mark an empty slot, which is fine since
+ * DELETED records are never indexed
+ */
+struct idmap {
+	unsigned int *keys;
+	long *values;
+	size_t capacity;
+	size_t count;
+};
+
+int idmap_get(struct idmap *m, unsigned int key, long *value);
+int idmap_put(struct idmap *m, unsigned int key, long value);
+int idmap_remove(struct idmap *m, unsigned int key);
+void idmap_clear(struct idmap *m);
+void idmap_free(struct idmap *m);
+void idmap_init(struct idmap *m);
+
+#endif
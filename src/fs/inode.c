@@ -15,7 +15,8 @@ struct inode new_inode(enum filetype type, mode_t perms, const char *user, const
 	time_t t;
 
 	memset(&i, 0, sizeof(struct inode));
-	i.id = rand();
+	/* the id is given by write_inode */
+	i.id = DELETED;
 
 	i.type = type;
 	i.permissions = perms;
@@ -28,10 +29,13 @@ struct inode new_inode(enum filetype type, mode_t perms, const char *user, const
 
 
 	t = time(NULL);
-	i.created_at = localtime(&t);
-	i.updated_at = localtime(&t);
+	i.created_at = (int64_t) t;
+	i.updated_at = (int64_t) t;
 
+	i.extent_count = 0;
+	i.overflow = DELETED;
 	i.bloc_count = 0;
+	i.size = 0;
 
 	return i;
 }
@@ -44,7 +48,8 @@ int inode_equals(struct inode i1, struct inode i2) {
 }
 
 /**
- * Checks if a bloc id is in the bloc ids of an inode
+ * Checks if a bloc id is in the extents kept in an inode (the extents
+ * of the overflow blocs are not looked at, see get_extents)
  *
  * success : 1
  * failure : 0
@@ -52,14 +57,27 @@ int inode_equals(struct inode i1, struct inode i2) {
 int contains(struct inode *i, unsigned int bloc_id) {
 	int j;
 
-	for (j = 0; j != i->bloc_count; j++) {
-		if (i->bloc_ids[j] == bloc_id)
+	for (j = 0; j != i->extent_count && j != EXTENT_COUNT; j++) {
+		if (bloc_id >= i->extents[j].start && bloc_id - i->extents[j].start < i->extents[j].length)
 			return 1;
 	}
 
 	return 0;
 }
 
+/*
+ * Formats a time of an inode as a local time, "?" when it's out of range
+ */
+static void format_time(int64_t at, char *s, size_t size) {
+	struct tm *tm;
+	time_t t;
+
+	t = (time_t) at;
+	tm = localtime(&t);
+	if (tm == NULL || strftime(s, size, "%c", tm) == 0)
+		snprintf(s, size, "?");
+}
+
 /**
  * Prints an inode in the terminal
  */
@@ -68,22 +86,23 @@ void print_inode(struct inode *i) {
 	char s2[64];
 	int j;
 
-	printf("<INODE> id:%d", i->id);
+	printf("<INODE> id:%u", i->id);
 	printf(" filetype:%d", i->type);
 	printf(" permissions:%d", i->permissions);
 	printf(" user:%s", i->user_name);
 	printf(" group:%s", i->group_name);
-	/*
-	assert(strftime(s, 64, "%c", i->created_at));
-	assert(strftime(s2, 64, "%c", i->updated_at));
+	printf(" size:%zu", i->size);
+	format_time(i->created_at, s, sizeof(s));
+	format_time(i->updated_at, s2, sizeof(s2));
 	printf(" created at:%s", s);
 	printf(" updated at:%s", s2);
-	*/
 
 	puts("");
-	for (j = 0; j != i->bloc_count; j++) {
-		printf("\tbloc_id:%d\n", i->bloc_ids[j]);
+	for (j = 0; j != i->extent_count && j != EXTENT_COUNT; j++) {
+		printf("\textent:%u+%u\n", i->extents[j].start, i->extents[j].length);
 	}
+	if (i->overflow != DELETED)
+		printf("\toverflow:%u\n", i->overflow);
 
 }
 
@@ -97,11 +116,3 @@ struct inode empty_inode() {
 	return i;
 }
 
-/**
- * Initialize the id generator (seed for random)
- * TODO put in rand_utils/c
- */
-void init_id_generator() {
-	srand(getpid() + time(NULL) + __LINE__);
-}
-
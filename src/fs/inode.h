@@ -5,6 +5,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
 #include <stdio.h>
 #include <assert.h>
@@ -13,7 +14,7 @@
 #define ROOT_ID (1)
 #define USERNAME_COUNT (15)
 #define GROUPNAME_COUNT (15)
-#define BLOC_IDS_COUNT (10)
+#define EXTENT_COUNT (4)
 #define DELETED (0)
 #define TODO_PRINT printf("TODO line %d\n", __LINE__)
 
@@ -21,11 +22,26 @@ enum filetype {
 	REGULAR_FILE, DIRECTORY, SYMBOLIC_LINK, FIFO, SOCKET, DEVICE
 };
 
+/*
+ * A run of length blocs with contiguous ids, from the bloc id start
+ * (contiguous ids are contiguous on the disk)
+ */
+struct extent {
+	unsigned int start;
+	unsigned int length;
+};
+
 /**
  * Stores metadata of blocs
+ *
+ * The blocs of a file are mapped by extents: the first EXTENT_COUNT are
+ * kept in the inode, the next ones in a chain of extent blocs starting at
+ * overflow (see extent.c). bloc_count is the number of blocs of the file,
+ * size its number of bytes. The times are in seconds since the epoch, 64
+ * bits whatever the size of time_t.
  */
 struct inode {
-	unsigned char id;
+	unsigned int id;
 
 	enum filetype type;
 	mode_t permissions;
@@ -33,18 +49,20 @@ struct inode {
 	char user_name[USERNAME_COUNT];
 	char group_name[GROUPNAME_COUNT];
 
-	const struct tm *created_at;
-	struct tm *updated_at;
+	int64_t created_at;
+	int64_t updated_at;
 
-	unsigned int bloc_ids[BLOC_IDS_COUNT];
+	struct extent extents[EXTENT_COUNT];
+	int extent_count;
+	unsigned int overflow;
 	int bloc_count;
+	size_t size;
 };
 
 int contains(struct inode *i, unsigned int bloc_id);
 int inode_equals(struct inode i1, struct inode i2);
 struct inode empty_inode();
 struct inode new_inode(enum filetype type, mode_t perms, const char *user, const char *group);
-void init_id_generator();
 void print_inode(struct inode *i);
 
 #endif
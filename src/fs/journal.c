@@ -0,0 +1,261 @@
+#include "./journal.h"
+#include "./fs.h"
+
+/*
+ * Write-ahead journal of the metadata transactions (see txn.c)
+ *
+ * A commit writes the records of the transaction in the journal region
+ * with no sync, they stay pending in memory. A checkpoint, once
+ * "journal_group=N" commits are in the journal or when it's full, syncs
+ * the journal, applies the pending records in place, syncs them and
+ * starts a new sequence: a group of commits costs two syncs.
+ * After a crash the transactions of the journal are applied again at
+ * mount (see journal_replay), a torn one and the next are dropped.
+ */
+
+/*
+ * FNV-1a hash of size bytes, going on from h
+ */
+static unsigned int checksum(unsigned int h, const void *bytes, size_t size) {
+	const unsigned char *p;
+	size_t z;
+
+	p = (const unsigned char *) bytes;
+	for (z = 0; z != size; z++) {
+		h ^= p[z];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/*
+ * Waits for the writes of the disk to be on the device
+ */
+static int sync_disk(struct fs *fs) {
+	/* a scratch disk, see "durability=none" */
+	if (fs->durability.mode == DURABILITY_NONE) return EXIT_SUCCESS;
+
+	fs->journal.syncs++;
+
+	return disk_datasync(fs);
+}
+
+/*
+ * Writes the header of the journal with the current sequence
+ */
+static int write_header(struct fs *fs) {
+	struct journal_header h;
+
+	h.magic = JOURNAL_MAGIC;
+	h.sequence = fs->journal.sequence;
+
+	return disk_write_through(fs, fs->sb.journal, &h, sizeof(struct journal_header));
+}
+
+/*
+ * Applies the pending records in place (the committed ones only, or all of
+ * them), after the journal is synced. The journal starts a new sequence
+ * once they're synced too.
+ */
+static int checkpoint(struct fs *fs, int committed_only) {
+	int pending;
+
+	pending = fs->journal.pending;
+	if (pending > 0 && sync_disk(fs) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	if (txn_apply(fs, committed_only) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	if (pending > 0) {
+		if (sync_disk(fs) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+		fs->journal.sequence++;
+		fs->journal.used = 0;
+		fs->journal.pending = 0;
+		return write_header(fs);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Applies every pending record in place (see checkpoint)
+ * To call before another process reads the disk (see flush_disk)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE
+ */
+int journal_sync(struct fs *fs) {
+	if (fs->txn.depth > 0) return EXIT_FAILURE;
+
+	return checkpoint(fs, 0);
+}
+
+/**
+ * Writes the records of the transaction just closed in the journal, they
+ * become committed. A checkpoint makes room first when the journal is
+ * full, and follows a group of commits.
+ * A transaction bigger than the journal can't be atomic: it's refused,
+ * its records are dropped and the mounted disk is loaded again as the
+ * commits before it left it (see refresh_disk).
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (write error, refused)
+ */
+int journal_commit(struct fs *fs) {
+	struct txn *t;
+	struct journal_txn head;
+	struct journal_write w;
+	char *buf;
+	size_t z, size, pos, room;
+	int rst;
+
+	t = &fs->txn;
+	memset(&head, 0, sizeof(struct journal_txn));
+	size = 0;
+	for (z = 0; z != t->count; z++) {
+		if (!t->records[z].committed) {
+			head.count++;
+			size += sizeof(struct journal_write) + t->records[z].size;
+		}
+	}
+	if (head.count == 0) return EXIT_SUCCESS;
+
+	room = fs->sb.journal_size > sizeof(struct journal_header) ? fs->sb.journal_size - sizeof(struct journal_header) : 0;
+	if (sizeof(struct journal_txn) + size > room) {
+		fprintf(stderr, "Transaction of %lu bytes refused, bigger than the journal %d\n", (unsigned long) size, __LINE__);
+		txn_discard(t);
+		if (checkpoint(fs, 1) != EXIT_SUCCESS) return EXIT_FAILURE;
+		refresh_disk(fs);
+		return EXIT_FAILURE;
+	}
+
+	if (fs->journal.used + sizeof(struct journal_txn) + size > room
+			&& checkpoint(fs, 1) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	buf = (char *) malloc(sizeof(struct journal_txn) + size);
+	if (buf == NULL) return EXIT_FAILURE;
+
+	pos = sizeof(struct journal_txn);
+	for (z = 0; z != t->count; z++) {
+		if (!t->records[z].committed) {
+			w.offset = t->records[z].offset;
+			w.size = t->records[z].size;
+			memcpy(buf + pos, &w, sizeof(struct journal_write));
+			memcpy(buf + pos + sizeof(struct journal_write), t->records[z].data, w.size);
+			pos += sizeof(struct journal_write) + w.size;
+		}
+	}
+
+	head.magic = JOURNAL_MAGIC;
+	head.sequence = fs->journal.sequence;
+	head.size = size;
+	head.checksum = checksum(checksum(2166136261u, &head, sizeof(struct journal_txn)), buf + sizeof(struct journal_txn), size);
+	memcpy(buf, &head, sizeof(struct journal_txn));
+
+	rst = disk_write_through(fs, fs->sb.journal + sizeof(struct journal_header) + fs->journal.used, buf, pos);
+	free(buf);
+	if (rst != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	for (z = 0; z != t->count; z++)
+		t->records[z].committed = 1;
+	fs->journal.used += pos;
+	fs->journal.pending++;
+
+	if (fs->journal.pending >= fs->journal.group)
+		return checkpoint(fs, 1);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Reads the transaction at pos in the journal, its writes are in body
+ * (malloc'd)
+ *
+ * on success : returns 1
+ * on failure : returns 0 (past the last transaction, torn, stale)
+ */
+static int read_txn(struct fs *fs, long pos, struct journal_txn *head, char **body) {
+	unsigned int sum;
+	long start;
+
+	*body = NULL;
+	start = fs->sb.journal + sizeof(struct journal_header) + pos;
+	if (pos + (long) sizeof(struct journal_txn) > (long) (fs->sb.journal_size - sizeof(struct journal_header))
+			|| disk_read(fs, start, head, sizeof(struct journal_txn)) != EXIT_SUCCESS
+			|| head->magic != JOURNAL_MAGIC || head->sequence != fs->journal.sequence
+			|| pos + sizeof(struct journal_txn) + head->size > fs->sb.journal_size - sizeof(struct journal_header))
+		return 0;
+
+	*body = (char *) malloc(head->size);
+	if (*body == NULL || disk_read(fs, start + sizeof(struct journal_txn), *body, head->size) != EXIT_SUCCESS)
+		return 0;
+
+	sum = head->checksum;
+	head->checksum = 0;
+	head->checksum = checksum(checksum(2166136261u, head, sizeof(struct journal_txn)), *body, head->size);
+
+	return head->checksum == sum;
+}
+
+/**
+ * Applies again the transactions left in the journal by a crash, up to the
+ * first torn one, then starts a new sequence
+ * To call at mount, before the superblock and the bitmaps are used
+ *
+ * on success : returns EXIT_SUCCESS, journal.replayed is the number of
+ * transactions applied
+ * on failure : returns EXIT_FAILURE
+ */
+int journal_replay(struct fs *fs) {
+	struct journal_header h;
+	struct journal_txn head;
+	struct journal_write w;
+	char *body;
+	long pos;
+	size_t at;
+	unsigned int z;
+	int rst;
+
+	fs->journal.group = mount_option_value("journal_group", DEFAULT_JOURNAL_GROUP);
+	if (fs->journal.group < 1)
+		fs->journal.group = 1;
+	if (fs->sb.journal_size == 0) return EXIT_SUCCESS;
+
+	if (disk_read(fs, fs->sb.journal, &h, sizeof(struct journal_header)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	/* a fresh disk: the region is zeros */
+	if (h.magic != JOURNAL_MAGIC) {
+		fs->journal.sequence = 1;
+		return write_header(fs);
+	}
+
+	fs->journal.sequence = h.sequence;
+	rst = EXIT_SUCCESS;
+	for (pos = 0; rst == EXIT_SUCCESS && read_txn(fs, pos, &head, &body); pos += sizeof(struct journal_txn) + head.size) {
+		at = 0;
+		for (z = 0; rst == EXIT_SUCCESS && z != head.count && at + sizeof(struct journal_write) <= head.size; z++) {
+			memcpy(&w, body + at, sizeof(struct journal_write));
+			at += sizeof(struct journal_write);
+			if (at + w.size <= head.size)
+				rst = disk_write_through(fs, w.offset, body + at, w.size);
+			at += w.size;
+		}
+		free(body);
+		/* a failed write ends the loop before read_txn resets it */
+		body = NULL;
+		fs->journal.replayed++;
+	}
+	free(body);
+
+	if (fs->journal.replayed == 0 || rst != EXIT_SUCCESS)
+		return rst;
+
+	if (sync_disk(fs) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	fs->journal.sequence++;
+
+	return write_header(fs);
+}
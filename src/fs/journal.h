@@ -0,0 +1,63 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define JOURNAL_MAGIC (0x4c4e524a) /* "JRNL" */
+#define DEFAULT_JOURNAL_SIZE (256 * 1024)
+/* commits a checkpoint by default, see "journal_group=N" */
+#define DEFAULT_JOURNAL_GROUP (16)
+
+/*
+ * The head of the journal region, the transactions of its sequence follow
+ * it. A checkpoint moves to the next sequence: the transactions left in
+ * the region are stale.
+ */
+struct journal_header {
+	unsigned int magic;
+	unsigned int sequence;
+};
+
+/*
+ * A transaction in the journal, count writes follow it (size bytes): a
+ * struct journal_write then the bytes written, each
+ * checksum covers the header (its checksum is 0) and the writes, a torn
+ * transaction doesn't match it
+ */
+struct journal_txn {
+	unsigned int magic;
+	unsigned int sequence;
+	unsigned int count;
+	unsigned int size;
+	unsigned int checksum;
+};
+
+struct journal_write {
+	long offset;
+	unsigned int size;
+};
+
+/*
+ * The journal of a mounted disk
+ *
+ * used is the bytes of transactions after the header, pending the commits
+ * written there since the last checkpoint.
+ */
+struct journal {
+	unsigned int sequence;
+	long used;
+	int pending;
+	int group;
+
+	unsigned long syncs;
+	unsigned long replayed;
+};
+
+struct fs;
+
+int journal_commit(struct fs *fs);
+int journal_replay(struct fs *fs);
+int journal_sync(struct fs *fs);
+
+#endif
@@ -0,0 +1,163 @@
+#include "./path.h"
+#include "./fs.h"
+
+/*
+ * Paths are names separated by '/', from the root when they start with
+ * one, else from a directory. "." and ".." are entries of the directories
+ * but the root's: they're handled here, ".." of the root is the root.
+ */
+
+/**
+ * Resolves a path to an inode, each component is one cached lookup (see
+ * find_filename). Empty components are skipped: "a//b/" is "a/b".
+ *
+ * on failure: returns an inode with id DELETED (a component is missing or
+ * is not a directory)
+ */
+struct inode resolve_path(struct fs *fs, struct inode *dir, const char *path) {
+	struct inode cur;
+	char name[FILENAME_COUNT];
+	const char *end;
+	size_t len;
+
+	if (path[0] == '/')
+		cur = get_inode_by_id(fs, ROOT_ID);
+	else
+		cur = current_dir(fs, dir);
+
+	while (cur.id != DELETED && *path != '\0') {
+		end = strchr(path, '/');
+		len = end == NULL ? strlen(path) : (size_t) (end - path);
+
+		if (len >= FILENAME_COUNT) {
+			cur = empty_inode();
+		} else if (len > 0) {
+			memcpy(name, path, len);
+			name[len] = '\0';
+
+			if (cur.type != DIRECTORY)
+				cur = empty_inode();
+			else if (strcmp(name, ".") == 0 || (cur.id == ROOT_ID && strcmp(name, "..") == 0))
+				; /* stays in cur */
+			else
+				cur = get_inode_by_filename(fs, &cur, name);
+		}
+
+		path += len;
+		if (*path == '/')
+			path++;
+	}
+
+	return cur;
+}
+
+/**
+ * Resolves the directory of the last component of a path, which is stored
+ * in name (FILENAME_COUNT chars): "a/b/c" is "c" in "a/b"
+ *
+ * on failure: returns an inode with id DELETED (no last component, or its
+ * directory doesn't resolve)
+ */
+struct inode resolve_parent(struct fs *fs, struct inode *dir, const char *path, char *name) {
+	struct inode parent;
+	char *copy, *slash;
+	size_t len;
+
+	copy = strdup(path);
+	if (copy == NULL) return empty_inode();
+
+	len = strlen(copy);
+	while (len > 1 && copy[len - 1] == '/')
+		copy[--len] = '\0';
+
+	slash = strrchr(copy, '/');
+	if (slash == NULL) {
+		parent = current_dir(fs, dir);
+		slash = copy - 1;
+	} else if (slash == copy) {
+		parent = get_inode_by_id(fs, ROOT_ID);
+	} else {
+		*slash = '\0';
+		parent = resolve_path(fs, dir, copy);
+	}
+
+	len = strlen(slash + 1);
+	if (len == 0 || len >= FILENAME_COUNT || parent.type != DIRECTORY)
+		parent = empty_inode();
+	else
+		strcpy(name, slash + 1);
+
+	free(copy);
+
+	return parent;
+}
+
+/**
+ * Gets the directory a directory is in, and its name there (FILENAME_COUNT
+ * chars). Memoized in the dcache, the next lookup reads nothing.
+ *
+ * on success : returns 1
+ * on failure : returns 0 (the root, not a directory, or not linked)
+ */
+int inode_parent(struct fs *fs, unsigned int id, unsigned int *parent, char *name) {
+	struct inode dir, up;
+	char *found;
+	int linked;
+
+	if (id == ROOT_ID) return 0;
+	if (dcache_name_lookup(&fs->dcache, id, parent, name)) return 1;
+
+	dir = get_inode_by_id(fs, id);
+	if (dir.id == DELETED || dir.type != DIRECTORY) return 0;
+
+	up = get_inode_by_filename(fs, &dir, "..");
+	if (up.id == DELETED) return 0;
+
+	found = get_filename_for_inode(fs, &up, &dir);
+	linked = found[0] != '\0';
+	if (linked) {
+		strcpy(name, found);
+		*parent = up.id;
+		dcache_name_insert(&fs->dcache, id, up.id, name);
+	}
+	free(found);
+
+	return linked;
+}
+
+/**
+ * Returns the full path of a directory, "/" for the root: one reverse
+ * lookup a level (see inode_parent)
+ *
+ * note: don't forget to free the char*
+ * on failure: returns NULL (not a directory, or not linked to the root)
+ */
+char *inode_path(struct fs *fs, struct inode *dir) {
+	char name[FILENAME_COUNT];
+	char *path, *longer;
+	unsigned int id, parent;
+	int depth;
+
+	path = strdup("");
+	id = dir->id;
+	for (depth = 0; path != NULL && id != ROOT_ID; depth++) {
+		if (depth == PATH_DEPTH_MAX || !inode_parent(fs, id, &parent, name)) {
+			free(path);
+			path = NULL;
+		} else {
+			longer = (char *) malloc(strlen(name) + strlen(path) + 2);
+			if (longer != NULL)
+				sprintf(longer, "/%s%s", name, path);
+			free(path);
+			path = longer;
+			id = parent;
+		}
+	}
+
+	if (path != NULL && path[0] == '\0') {
+		free(path);
+		path = strdup("/");
+	}
+
+	return path;
+}
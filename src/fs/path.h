@@ -0,0 +1,18 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "./inode.h"
+
+/* most directories walked up by inode_path, a bound on a broken chain */
+#define PATH_DEPTH_MAX (256)
+
+struct fs;
+
+char *inode_path(struct fs *fs, struct inode *dir);
+int inode_parent(struct fs *fs, unsigned int id, unsigned int *parent, char *name);
+struct inode resolve_parent(struct fs *fs, struct inode *dir, const char *path, char *name);
+struct inode resolve_path(struct fs *fs, struct inode *dir, const char *path);
+
+#endif
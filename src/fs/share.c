@@ -0,0 +1,154 @@
+#include "./share.h"
+#include "./fs.h"
+
+/*
+ * The share counts of the blocs, in the share table: a file of its own
+ * (no directory entry), whose inode is in the superblock. The share count
+ * of the bloc of slot N is the share_count at byte N * 2 of the table.
+ *
+ * The table is created by the first copy (see copy_file), a disk without
+ * copies has none and nothing is read. It's written as any file, through
+ * the caches, the transactions and the copy on write of the snapshots.
+ */
+
+/*
+ * Frees a share table that couldn't be written, with the blocs written
+ * before the failure (as the disk has its inode)
+ */
+static void drop_table(struct fs *fs, unsigned int id) {
+	struct inode t;
+
+	t = get_inode_by_id(fs, id);
+	if (t.id == DELETED) return;
+
+	if (extent_truncate(fs, &t, 0) == EXIT_SUCCESS)
+		delete_inode(fs, &t);
+}
+
+/*
+ * Creates the share table, every count 0
+ */
+static int create_table(struct fs *fs) {
+	struct inode t;
+	struct file f;
+	char *zeros;
+	size_t size;
+	int rst;
+
+	t = new_inode(REGULAR_FILE, 0, ROOT, ROOT);
+	if (write_inode(fs, &t) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	size = (size_t) fs->sb.bloc_count * sizeof(share_count);
+	zeros = (char *) calloc(size, sizeof(char));
+	if (zeros == NULL) {
+		drop_table(fs, t.id);
+		return EXIT_FAILURE;
+	}
+
+	f = new_file(fs, &t, O_RDWR);
+	rst = iwrite_at(fs, &f, 0, zeros, size);
+	free(zeros);
+	if (rst != EXIT_SUCCESS) {
+		drop_table(fs, t.id);
+		return EXIT_FAILURE;
+	}
+
+	fs->sb.shares = t.id;
+
+	return write_superblock(fs);
+}
+
+/**
+ * Returns the share count of a bloc (0 without a share table)
+ */
+unsigned int share_get(struct fs *fs, unsigned int id) {
+	struct inode t;
+	struct bloc tmp;
+	const struct bloc *b;
+	share_count count;
+	unsigned int slot;
+
+	if (fs->sb.shares == DELETED || id == DELETED || id > fs->sb.bloc_count) return 0;
+
+	slot = id - 1;
+	t = get_inode_by_id(fs, fs->sb.shares);
+	b = bloc_ref(fs, bmap(fs, &t, slot / SHARES_PER_BLOC), &tmp);
+	if (b == NULL) return 0;
+
+	memcpy(&count, b->content + (slot % SHARES_PER_BLOC) * sizeof(share_count), sizeof(share_count));
+
+	return count;
+}
+
+/*
+ * Checks that delta keeps the share counts of the slots from slot to end
+ * in range, every bloc of the table is read before any is updated
+ *
+ * success : 1
+ * failure : 0 (a count would go past SHARE_MAX or below 0, a bloc of the
+ * table can't be read)
+ */
+static int counts_in_range(struct fs *fs, struct inode *t, unsigned int slot, unsigned int end, int delta) {
+	struct bloc tmp;
+	const struct bloc *b;
+	share_count count;
+	unsigned int z;
+	long value;
+
+	while (slot != end) {
+		b = bloc_ref(fs, bmap(fs, t, slot / SHARES_PER_BLOC), &tmp);
+		if (b == NULL) return 0;
+
+		for (z = slot % SHARES_PER_BLOC; z != SHARES_PER_BLOC && slot != end; z++, slot++) {
+			memcpy(&count, b->content + z * sizeof(share_count), sizeof(share_count));
+			value = (long) count + delta;
+			if (value < 0 || value > SHARE_MAX) {
+				fprintf(stderr, "Wrong share count %ld for bloc %u %d\n", value, slot + 1, __LINE__);
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Adds delta to the share counts of count blocs of contiguous ids from
+ * start, one update a bloc of the table
+ * The table is created when a count goes up for the first time. The
+ * counts change all or none: the range is checked first.
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (a count would go past SHARE_MAX or
+ * below 0, no bloc left for the table)
+ */
+int share_add(struct fs *fs, unsigned int start, unsigned int count, int delta) {
+	struct inode t;
+	struct bloc b;
+	share_count *counts;
+	unsigned int slot, end, z;
+
+	if (count == 0 || delta == 0) return EXIT_SUCCESS;
+	if (start == DELETED || start - 1 + count > fs->sb.bloc_count) return EXIT_FAILURE;
+
+	if (fs->sb.shares == DELETED && (delta < 0 || create_table(fs) != EXIT_SUCCESS))
+		return EXIT_FAILURE;
+
+	t = get_inode_by_id(fs, fs->sb.shares);
+	end = start - 1 + count;
+	if (!counts_in_range(fs, &t, start - 1, end, delta))
+		return EXIT_FAILURE;
+
+	for (slot = start - 1; slot != end;) {
+		b = get_bloc_by_id(fs, bmap(fs, &t, slot / SHARES_PER_BLOC));
+		if (b.id == DELETED) return EXIT_FAILURE;
+
+		counts = (share_count *) b.content;
+		for (z = slot % SHARES_PER_BLOC; z != SHARES_PER_BLOC && slot != end; z++, slot++)
+			counts[z] = (share_count) ((long) counts[z] + delta);
+
+		if (update_bloc(fs, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,23 @@
+#ifndef SHARE_H
+#define SHARE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "./bloc.h"
+
+/* share counts of a bloc of the share table */
+#define SHARES_PER_BLOC (BLOC_SIZE / sizeof(share_count))
+#define SHARE_MAX (0xffff)
+
+/*
+ * The number of files a bloc is shared with besides its first owner:
+ * 0 for a bloc of one file only (see copy_file)
+ */
+typedef unsigned short share_count;
+
+struct fs;
+
+int share_add(struct fs *fs, unsigned int start, unsigned int count, int delta);
+unsigned int share_get(struct fs *fs, unsigned int id);
+
+#endif
@@ -0,0 +1,704 @@
+#include "./snapshot.h"
+#include "./fs.h"
+
+/*
+ * Snapshots of the disk, kept in the disk itself
+ *
+ * Taking a snapshot writes a copy of the bitmaps (the slots in use) and
+ * a head bloc, whatever the size of the files: no record is copied. The
+ * records are copied on write instead: the first time a slot in use in a
+ * snapshot is written (an inode or a bloc overwritten, deleted, or a freed
+ * slot given again), the record as it was is copied in a new bloc, an
+ * exception of the snapshot (see snapshot_preserve).
+ *
+ * A snapshot reads as the disk with its bitmaps and its exceptions over
+ * the slots (see snapshot_overlay), rolling back writes its exceptions
+ * back in place (see snapshot_rollback).
+ *
+ * The blocs holding the snapshots go past the bloc cache and the copy on
+ * write, they are not part of the snapshots taken afterwards. They are
+ * put in slots free in every snapshot as long as there are some (see
+ * storage_slot).
+ */
+
+/*
+ * The key of the exception of a slot (0 is never a key)
+ */
+static unsigned int exception_key(int flag, unsigned int slot) {
+	return (slot + 1) * 2 + (flag == INODE_FLAG);
+}
+
+/*
+ * Checks if the bit of a slot is set
+ */
+static int bit_set(const bitmap_word *bitmap, unsigned int slot) {
+	return (bitmap[slot / BITMAP_WORD_BITS] >> (slot % BITMAP_WORD_BITS)) & 1;
+}
+
+static void set_bit(bitmap_word *bitmap, unsigned int slot, int used) {
+	if (used)
+		bitmap[slot / BITMAP_WORD_BITS] |= 1ULL << (slot % BITMAP_WORD_BITS);
+	else
+		bitmap[slot / BITMAP_WORD_BITS] &= ~(1ULL << (slot % BITMAP_WORD_BITS));
+}
+
+static size_t inode_bitmap_size(struct fs *fs) {
+	return bitmap_words(fs->sb.inode_count) * sizeof(bitmap_word);
+}
+
+static size_t bloc_bitmap_size(struct fs *fs) {
+	return bitmap_words(fs->sb.bloc_count) * sizeof(bitmap_word);
+}
+
+/*
+ * Reads a bloc of the snapshots, past the bloc cache
+ */
+static int read_raw(struct fs *fs, unsigned int id, struct bloc *b) {
+	if (id == DELETED || id > fs->sb.bloc_count) return EXIT_FAILURE;
+
+	return disk_read(fs, bloc_offset(&fs->sb, id - 1), b, sizeof(struct bloc));
+}
+
+static int write_raw(struct fs *fs, struct bloc *b) {
+	bloc_seal(b);
+	return disk_write(fs, bloc_offset(&fs->sb, b->id - 1), b, sizeof(struct bloc));
+}
+
+/*
+ * Finds a free slot in use in none of the snapshots: a bloc holding a
+ * snapshot never lies where a rollback writes a record back
+ *
+ * success : 1
+ * failure : 0 (every free slot is in a snapshot)
+ */
+static int storage_slot(struct fs *fs, unsigned int *slot) {
+	bitmap_word used;
+	unsigned int words, word, z;
+	size_t k;
+
+	words = bitmap_words(fs->sb.bloc_count);
+	for (z = 0; z != words; z++) {
+		word = (fs->sb.bloc_hint + z) % words;
+		used = fs->bloc_bitmap[word];
+		for (k = 0; k != fs->snapshots.count; k++)
+			used |= fs->snapshots.list[k].bloc_bitmap[word];
+		if (used == ~0ULL) continue;
+
+		*slot = word * BITMAP_WORD_BITS + __builtin_ctzll(~used);
+		return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Writes a bloc of the snapshots in a free slot, it gets its id
+ */
+static int store_bloc(struct fs *fs, struct bloc *b) {
+	unsigned int slot, got;
+
+	if (!storage_slot(fs, &slot))
+		slot = NO_GOAL;
+	if (alloc_run(fs, BLOC_FLAG, slot, 1, &slot, &got) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	/* the slot may hold a record of a snapshot, freed since */
+	if (snapshot_preserve(fs, BLOC_FLAG, slot) != EXIT_SUCCESS) {
+		free_slot(fs, BLOC_FLAG, slot);
+		return EXIT_FAILURE;
+	}
+
+	b->id = slot + 1;
+	bcache_drop(&fs->bcache, b->id);
+
+	return write_raw(fs, b);
+}
+
+static int write_head(struct fs *fs, struct snapshot *s) {
+	struct bloc b;
+
+	b = empty_bloc();
+	b.id = s->id;
+	b.length = sizeof(struct snapshot_bloc);
+	memcpy(b.content, &s->head, sizeof(struct snapshot_bloc));
+
+	return write_raw(fs, &b);
+}
+
+/*
+ * Writes size bytes in a chain of new blocs, first is the first one
+ */
+static int write_chain(struct fs *fs, const char *bytes, size_t size, unsigned int *first) {
+	struct bloc b;
+	unsigned int next;
+	size_t k, len;
+
+	next = DELETED;
+	for (k = (size + SNAPSHOT_CHAIN_BYTES - 1) / SNAPSHOT_CHAIN_BYTES; k-- > 0;) {
+		len = size - k * SNAPSHOT_CHAIN_BYTES < SNAPSHOT_CHAIN_BYTES ? size - k * SNAPSHOT_CHAIN_BYTES : SNAPSHOT_CHAIN_BYTES;
+
+		b = empty_bloc();
+		b.length = sizeof(unsigned int) + len;
+		memcpy(b.content, &next, sizeof(unsigned int));
+		memcpy(b.content + sizeof(unsigned int), bytes + k * SNAPSHOT_CHAIN_BYTES, len);
+		if (store_bloc(fs, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+		next = b.id;
+	}
+
+	*first = next;
+
+	return EXIT_SUCCESS;
+}
+
+static int read_chain(struct fs *fs, unsigned int id, char *bytes, size_t size) {
+	struct bloc b;
+	size_t pos, len;
+
+	for (pos = 0; pos < size; pos += len) {
+		if (read_raw(fs, id, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+		len = size - pos < SNAPSHOT_CHAIN_BYTES ? size - pos : SNAPSHOT_CHAIN_BYTES;
+		memcpy(bytes + pos, b.content + sizeof(unsigned int), len);
+		memcpy(&id, b.content, sizeof(unsigned int));
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Marks the blocs holding a snapshot in a bloc bitmap: its head and the
+ * chain of its bitmaps, its exceptions too (their chain and their copies)
+ */
+static int mark_storage(struct fs *fs, struct snapshot *s, bitmap_word *bitmap, int used, int exceptions) {
+	struct bloc b;
+	struct snapshot_exception_bloc *eb;
+	unsigned int id, z;
+
+	set_bit(bitmap, s->id - 1, used);
+
+	for (id = s->head.bitmaps; id != DELETED; memcpy(&id, b.content, sizeof(unsigned int))) {
+		if (read_raw(fs, id, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+		set_bit(bitmap, id - 1, used);
+	}
+
+	if (!exceptions) return EXIT_SUCCESS;
+
+	eb = (struct snapshot_exception_bloc *) b.content;
+	for (id = s->head.exceptions; id != DELETED; id = eb->next) {
+		if (read_raw(fs, id, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+		set_bit(bitmap, id - 1, used);
+
+		for (z = 0; z != eb->count; z++)
+			set_bit(bitmap, eb->entries[z].copy - 1, used);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Writes both bitmaps of the disk whole, after they were rebuilt
+ */
+static int write_bitmaps(struct fs *fs) {
+	fs->sb.inode_hint = 0;
+	fs->sb.bloc_hint = 0;
+
+	if (disk_write(fs, fs->sb.inode_bitmap, fs->inode_bitmap, inode_bitmap_size(fs)) != EXIT_SUCCESS
+			|| disk_write(fs, fs->sb.bloc_bitmap, fs->bloc_bitmap, bloc_bitmap_size(fs)) != EXIT_SUCCESS)
+		return EXIT_FAILURE;
+
+	return write_superblock(fs);
+}
+
+/*
+ * Adds an exception to a snapshot, in the first bloc of its chain or in
+ * a new one when it's full
+ */
+static int add_exception(struct fs *fs, struct snapshot *s, unsigned int key, unsigned int copy) {
+	struct bloc b;
+	struct snapshot_exception_bloc *eb;
+
+	eb = (struct snapshot_exception_bloc *) b.content;
+	if (s->head.exceptions == DELETED || read_raw(fs, s->head.exceptions, &b) != EXIT_SUCCESS
+			|| eb->count == SNAPSHOT_EXCEPTIONS_PER_BLOC) {
+		b = empty_bloc();
+		if (store_bloc(fs, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+		/* read after the store, which may have added a bloc already */
+		eb->next = s->head.exceptions;
+		s->head.exceptions = b.id;
+		if (write_head(fs, s) != EXIT_SUCCESS) return EXIT_FAILURE;
+	}
+
+	eb->entries[eb->count].key = key;
+	eb->entries[eb->count].copy = copy;
+	eb->count++;
+	b.length = 2 * sizeof(unsigned int) + eb->count * sizeof(struct snapshot_exception);
+	if (write_raw(fs, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	return idmap_put(&s->exceptions, key, copy);
+}
+
+/*
+ * Reads the record of a slot as a bloc: a bloc as it is, an inode in the
+ * content
+ */
+static int read_record(struct fs *fs, int flag, unsigned int slot, struct bloc *copy) {
+	*copy = empty_bloc();
+
+	if (flag == INODE_FLAG) {
+		copy->length = sizeof(struct inode);
+		return disk_read(fs, inode_offset(&fs->sb, slot), copy->content, sizeof(struct inode));
+	}
+
+	return disk_read(fs, bloc_offset(&fs->sb, slot), copy, sizeof(struct bloc));
+}
+
+/**
+ * Copies the record of a slot about to be written for every snapshot it
+ * belongs to and that has no copy of it yet
+ * To call before a slot of the inode table or of the bloc region changes,
+ * its record is still the one of the disk (not of a cache)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (a snapshot is mounted: read-only, no
+ * bloc left for the copy)
+ */
+int snapshot_preserve(struct fs *fs, int flag, unsigned int slot) {
+	struct snapshot *s;
+	struct bloc copy;
+	unsigned int key;
+	long known;
+	size_t z;
+
+	if (fs->snapshots.view != NULL) {
+		fprintf(stderr, "Read-only snapshot %s %d\n", fs->snapshots.view->head.name, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	key = exception_key(flag, slot);
+	for (z = 0; z != fs->snapshots.count; z++) {
+		s = &fs->snapshots.list[z];
+		if (!bit_set(flag == INODE_FLAG ? s->inode_bitmap : s->bloc_bitmap, slot)
+				|| idmap_get(&s->exceptions, key, &known))
+			continue;
+
+		if (read_record(fs, flag, slot, &copy) != EXIT_SUCCESS || store_bloc(fs, &copy) != EXIT_SUCCESS
+				|| add_exception(fs, s, key, copy.id) != EXIT_SUCCESS)
+			return EXIT_FAILURE;
+
+		fs->snapshots.preserved++;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Copies the slots of a region (the inode table or the bloc region) as
+ * they were in the snapshot mounted over size bytes read at offset
+ */
+static void overlay_region(struct fs *fs, int flag, long start, size_t record, unsigned int count,
+		long offset, char *buf, size_t size) {
+	struct snapshot *s;
+	struct bloc copy;
+	char rec[sizeof(struct bloc)];
+	long from, to, at, lo, hi, known;
+	unsigned int slot;
+	int in_use;
+
+	s = fs->snapshots.view;
+	from = offset > start ? offset : start;
+	to = offset + (long) size < start + (long) (count * record) ? offset + (long) size : start + (long) (count * record);
+
+	for (slot = (from - start) / record; from < to && start + (long) (slot * record) < to; slot++) {
+		in_use = bit_set(flag == INODE_FLAG ? s->inode_bitmap : s->bloc_bitmap, slot);
+		if (in_use && !idmap_get(&s->exceptions, exception_key(flag, slot), &known))
+			continue;
+
+		/* a slot free then reads as a DELETED record */
+		memset(rec, 0, record);
+		if (in_use && disk_read_through(fs, bloc_offset(&fs->sb, known - 1), &copy, sizeof(struct bloc)) == EXIT_SUCCESS) {
+			copy.id = slot + 1;
+			if (flag == INODE_FLAG)
+				memcpy(rec, copy.content, sizeof(struct inode));
+			else
+				memcpy(rec, &copy, sizeof(struct bloc));
+		}
+
+		at = start + (long) (slot * record);
+		lo = at > offset ? at : offset;
+		hi = at + (long) record < offset + (long) size ? at + (long) record : offset + (long) size;
+		memcpy(buf + (lo - offset), rec + (lo - at), hi - lo);
+	}
+}
+
+/**
+ * Copies the records of the snapshot mounted over size bytes read at
+ * offset (see disk_read)
+ */
+void snapshot_overlay(struct fs *fs, long offset, void *buf, size_t size) {
+	overlay_region(fs, INODE_FLAG, fs->sb.inode_table, sizeof(struct inode), fs->sb.inode_count,
+			offset, (char *) buf, size);
+	overlay_region(fs, BLOC_FLAG, fs->sb.bloc_region, sizeof(struct bloc), fs->sb.bloc_count,
+			offset, (char *) buf, size);
+}
+
+static void release(struct snapshot *s) {
+	free(s->inode_bitmap);
+	free(s->bloc_bitmap);
+	idmap_free(&s->exceptions);
+	s->inode_bitmap = NULL;
+	s->bloc_bitmap = NULL;
+}
+
+/*
+ * Releases the snapshots kept in memory
+ */
+void snapshot_free(struct snapshots *s) {
+	size_t z;
+
+	for (z = 0; z != s->count; z++)
+		release(&s->list[z]);
+	free(s->list);
+	memset(s, 0, sizeof(struct snapshots));
+}
+
+/*
+ * Reads the snapshot of the head bloc id: its bitmaps and its exceptions
+ */
+static int load_one(struct fs *fs, unsigned int id, struct snapshot *s) {
+	struct bloc b;
+	struct snapshot_exception_bloc *eb;
+	char *bytes;
+	unsigned int z;
+	int rst;
+
+	memset(s, 0, sizeof(struct snapshot));
+	idmap_init(&s->exceptions);
+	if (read_raw(fs, id, &b) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	memcpy(&s->head, b.content, sizeof(struct snapshot_bloc));
+	if (s->head.magic != SNAPSHOT_MAGIC) return EXIT_FAILURE;
+	s->id = id;
+
+	s->inode_bitmap = (bitmap_word *) malloc(inode_bitmap_size(fs));
+	s->bloc_bitmap = (bitmap_word *) malloc(bloc_bitmap_size(fs));
+	bytes = (char *) malloc(inode_bitmap_size(fs) + bloc_bitmap_size(fs));
+
+	rst = EXIT_FAILURE;
+	if (s->inode_bitmap != NULL && s->bloc_bitmap != NULL && bytes != NULL
+			&& read_chain(fs, s->head.bitmaps, bytes, inode_bitmap_size(fs) + bloc_bitmap_size(fs)) == EXIT_SUCCESS) {
+		memcpy(s->inode_bitmap, bytes, inode_bitmap_size(fs));
+		memcpy(s->bloc_bitmap, bytes + inode_bitmap_size(fs), bloc_bitmap_size(fs));
+		rst = EXIT_SUCCESS;
+	}
+	free(bytes);
+
+	eb = (struct snapshot_exception_bloc *) b.content;
+	for (id = s->head.exceptions; rst == EXIT_SUCCESS && id != DELETED; id = eb->next) {
+		rst = read_raw(fs, id, &b);
+		for (z = 0; rst == EXIT_SUCCESS && z != eb->count; z++)
+			rst = idmap_put(&s->exceptions, eb->entries[z].key, eb->entries[z].copy);
+	}
+
+	return rst;
+}
+
+/**
+ * Returns the snapshot of a name
+ *
+ * on failure: returns NULL
+ */
+struct snapshot *snapshot_find(struct fs *fs, const char *name) {
+	size_t z;
+
+	for (z = 0; z != fs->snapshots.count; z++) {
+		if (strcmp(fs->snapshots.list[z].head.name, name) == 0)
+			return &fs->snapshots.list[z];
+	}
+
+	return NULL;
+}
+
+/*
+ * Mounts a snapshot read-only: the slots in use are the ones of the
+ * snapshot, its records are read over the disk (see snapshot_overlay)
+ */
+static int view(struct fs *fs, const char *name) {
+	struct snapshot *s;
+
+	s = snapshot_find(fs, name);
+	if (s == NULL) {
+		fprintf(stderr, "No snapshot %s %d\n", name, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	memcpy(fs->inode_bitmap, s->inode_bitmap, inode_bitmap_size(fs));
+	memcpy(fs->bloc_bitmap, s->bloc_bitmap, bloc_bitmap_size(fs));
+	fs->sb.inode_high = s->head.inode_high;
+	fs->sb.bloc_high = s->head.bloc_high;
+	fs->snapshots.view = s;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Reads the snapshots of the disk, then mounts the one of the
+ * "snapshot=NAME" mount option if any
+ * To call once the superblock and the bitmaps are loaded
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (broken snapshot, no such snapshot)
+ */
+int snapshot_load(struct fs *fs) {
+	struct snapshot *list;
+	char name[SNAPSHOT_NAME_MAX + 1];
+	unsigned int id;
+
+	list = NULL;
+	snapshot_free(&fs->snapshots);
+
+	for (id = fs->sb.snapshots; id != DELETED; id = list[fs->snapshots.count++].head.next) {
+		list = (struct snapshot *) realloc(fs->snapshots.list, (fs->snapshots.count + 1) * sizeof(struct snapshot));
+		if (list == NULL) return EXIT_FAILURE;
+
+		fs->snapshots.list = list;
+		if (load_one(fs, id, &list[fs->snapshots.count]) != EXIT_SUCCESS) {
+			release(&list[fs->snapshots.count]);
+			fprintf(stderr, "Broken snapshot %u %d\n", id, __LINE__);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (mount_option_text("snapshot", name, sizeof(name)))
+		return view(fs, name);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Takes a snapshot of the disk as it is: the caches and the journal are
+ * flushed, the bitmaps are copied. The records are copied when they are
+ * written afterwards (see snapshot_preserve).
+ * One transaction (see txn.c)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (snapshot mounted, name taken or too
+ * long, no bloc left)
+ */
+int snapshot_take(struct fs *fs, const char *name) {
+	struct snapshot s;
+	struct snapshot *list;
+	struct bloc b;
+	char *bytes;
+	size_t z;
+	int rst;
+
+	/* the names go in the mount options, see "snapshot=NAME" */
+	if (fs->snapshots.view != NULL || name[0] == '\0' || strlen(name) > SNAPSHOT_NAME_MAX
+			|| strchr(name, ',') != NULL || snapshot_find(fs, name) != NULL) {
+		fprintf(stderr, "Can't take the snapshot %s %d\n", name, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	if (flush_disk(fs) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	memset(&s, 0, sizeof(struct snapshot));
+	idmap_init(&s.exceptions);
+	s.inode_bitmap = (bitmap_word *) malloc(inode_bitmap_size(fs));
+	s.bloc_bitmap = (bitmap_word *) malloc(bloc_bitmap_size(fs));
+	bytes = (char *) malloc(inode_bitmap_size(fs) + bloc_bitmap_size(fs));
+	if (s.inode_bitmap == NULL || s.bloc_bitmap == NULL || bytes == NULL) {
+		release(&s);
+		free(bytes);
+		return EXIT_FAILURE;
+	}
+
+	/* the blocs of the other snapshots are not part of it */
+	rst = EXIT_SUCCESS;
+	memcpy(s.inode_bitmap, fs->inode_bitmap, inode_bitmap_size(fs));
+	memcpy(s.bloc_bitmap, fs->bloc_bitmap, bloc_bitmap_size(fs));
+	for (z = 0; rst == EXIT_SUCCESS && z != fs->snapshots.count; z++)
+		rst = mark_storage(fs, &fs->snapshots.list[z], s.bloc_bitmap, 0, 1);
+	memcpy(bytes, s.inode_bitmap, inode_bitmap_size(fs));
+	memcpy(bytes + inode_bitmap_size(fs), s.bloc_bitmap, bloc_bitmap_size(fs));
+
+	s.head.magic = SNAPSHOT_MAGIC;
+	s.head.next = fs->sb.snapshots;
+	strncpy(s.head.name, name, SNAPSHOT_NAME_MAX);
+	s.head.created = time(NULL);
+	s.head.inode_high = fs->sb.inode_high;
+	s.head.bloc_high = fs->sb.bloc_high;
+
+	txn_begin(fs);
+	if (rst == EXIT_SUCCESS)
+		rst = write_chain(fs, bytes, inode_bitmap_size(fs) + bloc_bitmap_size(fs), &s.head.bitmaps);
+	if (rst == EXIT_SUCCESS) {
+		b = empty_bloc();
+		b.length = sizeof(struct snapshot_bloc);
+		memcpy(b.content, &s.head, sizeof(struct snapshot_bloc));
+		rst = store_bloc(fs, &b);
+		s.id = b.id;
+	}
+	if (rst == EXIT_SUCCESS) {
+		fs->sb.snapshots = s.id;
+		rst = write_superblock(fs);
+	}
+	if (txn_commit(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+	free(bytes);
+
+	list = NULL;
+	if (rst == EXIT_SUCCESS)
+		list = (struct snapshot *) realloc(fs->snapshots.list, (fs->snapshots.count + 1) * sizeof(struct snapshot));
+	if (list == NULL) {
+		release(&s);
+		return EXIT_FAILURE;
+	}
+
+	/* the last one taken first, as in the chain */
+	memmove(list + 1, list, fs->snapshots.count * sizeof(struct snapshot));
+	list[0] = s;
+	fs->snapshots.list = list;
+	fs->snapshots.count++;
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Brings the disk back to a snapshot: its exceptions are written back in
+ * place and the bitmaps become the ones of the snapshot (with the blocs of
+ * the snapshots kept). The snapshots taken after it are dropped, it's kept
+ * as if it was just taken.
+ * One transaction (see txn.c)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (snapshot mounted, no such snapshot)
+ */
+int snapshot_rollback(struct fs *fs, const char *name) {
+	struct snapshot *s;
+	struct bloc *copies;
+	unsigned int *keys, slot;
+	size_t k, j, n;
+	int rst;
+
+	s = snapshot_find(fs, name);
+	if (fs->snapshots.view != NULL || s == NULL) {
+		fprintf(stderr, "Can't roll back to the snapshot %s %d\n", name, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	if (flush_disk(fs) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	/* every copy is read before any is written back: short of slots, a
+	 * copy may lie in a slot of the snapshot (see store_bloc) */
+	n = s->exceptions.count;
+	copies = (struct bloc *) malloc((n ? n : 1) * sizeof(struct bloc));
+	keys = (unsigned int *) malloc((n ? n : 1) * sizeof(unsigned int));
+	rst = copies != NULL && keys != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+	for (j = 0, n = 0; rst == EXIT_SUCCESS && j != s->exceptions.capacity; j++) {
+		if (s->exceptions.keys[j] == IDMAP_EMPTY) continue;
+
+		keys[n] = s->exceptions.keys[j];
+		rst = read_raw(fs, (unsigned int) s->exceptions.values[j], &copies[n++]);
+	}
+
+	k = s - fs->snapshots.list;
+	txn_begin(fs);
+
+	/* the records written since, as they were */
+	for (j = 0; rst == EXIT_SUCCESS && j != n; j++) {
+		slot = keys[j] / 2 - 1;
+		if (keys[j] % 2 == 1) {
+			rst = disk_write(fs, inode_offset(&fs->sb, slot), copies[j].content, sizeof(struct inode));
+		} else {
+			copies[j].id = slot + 1;
+			rst = disk_write(fs, bloc_offset(&fs->sb, slot), &copies[j], sizeof(struct bloc));
+		}
+	}
+	free(copies);
+	free(keys);
+
+	/* the slots in use then, with the blocs of the snapshots kept */
+	if (rst == EXIT_SUCCESS) {
+		memcpy(fs->inode_bitmap, s->inode_bitmap, inode_bitmap_size(fs));
+		memcpy(fs->bloc_bitmap, s->bloc_bitmap, bloc_bitmap_size(fs));
+	}
+	for (j = k; rst == EXIT_SUCCESS && j != fs->snapshots.count; j++)
+		rst = mark_storage(fs, &fs->snapshots.list[j], fs->bloc_bitmap, 1, j != k);
+
+	if (rst == EXIT_SUCCESS) {
+		s->head.exceptions = DELETED;
+		fs->sb.snapshots = s->id;
+		/* the share table may be younger than the snapshot (see share.c) */
+		if (fs->sb.shares != DELETED && !bit_set(s->inode_bitmap, fs->sb.shares - 1))
+			fs->sb.shares = DELETED;
+		rst = write_head(fs, s);
+	}
+	if (rst == EXIT_SUCCESS)
+		rst = write_bitmaps(fs);
+
+	/* on a failure nothing is written, the bitmaps and the snapshots of
+	 * the disk are loaded again */
+	if (rst != EXIT_SUCCESS)
+		txn_abort(fs);
+	if (rst != EXIT_SUCCESS || txn_commit(fs) != EXIT_SUCCESS) {
+		refresh_disk(fs);
+		return EXIT_FAILURE;
+	}
+
+	idmap_clear(&s->exceptions);
+	for (j = 0; j != k; j++)
+		release(&fs->snapshots.list[j]);
+	memmove(fs->snapshots.list, s, (fs->snapshots.count - k) * sizeof(struct snapshot));
+	fs->snapshots.count -= k;
+
+	/* the cached records are the ones of before */
+	bcache_invalidate(&fs->bcache);
+	icache_invalidate(&fs->icache);
+	dcache_invalidate(&fs->dcache);
+
+	return rst;
+}
+
+/**
+ * Drops a snapshot, the blocs holding it are freed
+ * One transaction (see txn.c)
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (snapshot mounted, no such snapshot)
+ */
+int snapshot_drop(struct fs *fs, const char *name) {
+	struct snapshot *s;
+	size_t k;
+	int rst;
+
+	s = snapshot_find(fs, name);
+	if (fs->snapshots.view != NULL || s == NULL) {
+		fprintf(stderr, "Can't drop the snapshot %s %d\n", name, __LINE__);
+		return EXIT_FAILURE;
+	}
+
+	if (flush_disk(fs) != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	k = s - fs->snapshots.list;
+	txn_begin(fs);
+
+	rst = mark_storage(fs, s, fs->bloc_bitmap, 0, 1);
+	if (k == 0) {
+		fs->sb.snapshots = s->head.next;
+	} else {
+		fs->snapshots.list[k - 1].head.next = s->head.next;
+		if (rst == EXIT_SUCCESS)
+			rst = write_head(fs, &fs->snapshots.list[k - 1]);
+	}
+	if (rst == EXIT_SUCCESS)
+		rst = write_bitmaps(fs);
+	if (txn_commit(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+
+	release(s);
+	memmove(s, s + 1, (fs->snapshots.count - k - 1) * sizeof(struct snapshot));
+	fs->snapshots.count--;
+
+	return rst;
+}
@@ -0,0 +1,95 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "./bloc.h"
+#include "./bitmap.h"
+#include "./idmap.h"
+
+#define SNAPSHOT_MAGIC (0x50414e53) /* "SNAP" */
+#define SNAPSHOT_NAME_MAX (31)
+/* bytes of a bitmap chain bloc after the id of the next one */
+#define SNAPSHOT_CHAIN_BYTES (BLOC_SIZE - sizeof(unsigned int))
+#define SNAPSHOT_EXCEPTIONS_PER_BLOC ((BLOC_SIZE - 2 * sizeof(unsigned int)) / sizeof(struct snapshot_exception))
+
+/*
+ * The content of the head bloc of a snapshot
+ *
+ * next is the head bloc of the snapshot taken before (DELETED if none),
+ * the superblock points at the last one taken. bitmaps is the first bloc
+ * of the chain holding the inode bitmap then the bloc bitmap of the
+ * snapshot, exceptions the first bloc of the chain of its exceptions.
+ */
+struct snapshot_bloc {
+	unsigned int magic;
+	unsigned int next;
+	char name[SNAPSHOT_NAME_MAX + 1];
+	time_t created;
+
+	unsigned int inode_high;
+	unsigned int bloc_high;
+
+	unsigned int bitmaps;
+	unsigned int exceptions;
+};
+
+/*
+ * A record of the snapshot overwritten since: key is (id * 2) + 1 for an
+ * inode, id * 2 for a bloc, copy the bloc holding it as it was (see
+ * snapshot_preserve)
+ */
+struct snapshot_exception {
+	unsigned int key;
+	unsigned int copy;
+};
+
+/*
+ * The content of a bloc of the chain of exceptions
+ */
+struct snapshot_exception_bloc {
+	unsigned int next;
+	unsigned int count;
+	struct snapshot_exception entries[SNAPSHOT_EXCEPTIONS_PER_BLOC];
+};
+
+/*
+ * A snapshot in memory: its head bloc, the slots in use when it was taken
+ * and its exceptions (key -> copy)
+ */
+struct snapshot {
+	unsigned int id;
+	struct snapshot_bloc head;
+
+	bitmap_word *inode_bitmap;
+	bitmap_word *bloc_bitmap;
+	struct idmap exceptions;
+};
+
+/*
+ * The snapshots of a mounted disk, the last one taken first
+ *
+ * view is the snapshot mounted read-only ("snapshot=NAME"), NULL for the
+ * disk itself.
+ */
+struct snapshots {
+	struct snapshot *list;
+	size_t count;
+	struct snapshot *view;
+
+	unsigned long preserved;
+};
+
+struct fs;
+
+int snapshot_drop(struct fs *fs, const char *name);
+int snapshot_load(struct fs *fs);
+int snapshot_preserve(struct fs *fs, int flag, unsigned int slot);
+int snapshot_rollback(struct fs *fs, const char *name);
+int snapshot_take(struct fs *fs, const char *name);
+struct snapshot *snapshot_find(struct fs *fs, const char *name);
+void snapshot_free(struct snapshots *s);
+void snapshot_overlay(struct fs *fs, long offset, void *buf, size_t size);
+
+#endif
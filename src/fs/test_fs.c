@@ -1,6 +1,8 @@
 #include "fileio/fileio.h"
 #include "fs/fs.h"
 
+struct fs g_fs;
+
 int test_new_inode() {
 	enum filetype t = REGULAR_FILE;
 	mode_t m = S_IRWXU;
@@ -8,7 +10,10 @@ int test_new_inode() {
 
 
 	struct inode i = new_inode(t, m, user, NULL);
-	(void) i;
+	if (i.created_at <= 0 || i.created_at > (int64_t) time(NULL) || i.updated_at != i.created_at) {
+		perror("test_new_inode() failed");
+		return EXIT_FAILURE;
+	}
 
 	printf("test_new_inode() successful\n");
 	return EXIT_SUCCESS;
@@ -33,7 +38,7 @@ int test_write_inode() {
 	struct inode i;
 
 	i = new_inode(t, m, user, NULL);
-	if (write_inode(&i) != EXIT_SUCCESS)
+	if (write_inode(&g_fs, &i) != EXIT_SUCCESS)
 		perror("test_write_inode() failed");
 	printf("test_write_inode() success\n");
 
@@ -54,7 +59,7 @@ int test_write_bloc() {
 	struct bloc b;
 
 	b = new_bloc("#include<stdio.h>\nint main(){printf(\"HelloWorld\n\");return 0;}");
-	if (write_bloc(&b) != EXIT_SUCCESS)
+	if (write_bloc(&g_fs, &b) != EXIT_SUCCESS)
 		perror("test_write_bloc() failure");
 
 	printf("test_write_bloc() successful\n");
@@ -63,7 +68,7 @@ int test_write_bloc() {
 }
 
 int test_print_disk() {
-	print_disk();
+	print_disk(&g_fs);
 
 	return 0;
 }
@@ -71,8 +76,8 @@ int test_print_disk() {
 int test_create_disk() {
 	struct inode i;
 
-	clean_disk();
-	i = create_disk();
+	clean_disk(&g_fs);
+	i = create_disk(&g_fs);
 	(void) i;
 
 	printf("test_create_disk() successful\n");
@@ -83,12 +88,12 @@ int test_create_disk() {
 int test_update_inode() {
 	struct file f;
 
-	clean_disk();
-	g_working_directory = create_disk();
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
 
-	f = create_regularfile(&g_working_directory, "FILENAME", "TRUC", O_RDONLY);
+	f = create_regularfile(&g_fs, &g_working_directory, "FILENAME", "TRUC", O_RDONLY);
 	strcpy(f.inode.user_name, "Pauli");
-	if (update_inode(&(f.inode)) == EXIT_FAILURE) {
+	if (update_inode(&g_fs, &(f.inode)) == EXIT_FAILURE) {
 		perror("test_update_inode() failed");
 		return EXIT_FAILURE;
 	}
@@ -119,16 +124,16 @@ int test_create_regularfile() {
 	char filename[FILENAME_COUNT] = "FILENAME";
 	char *content;
 
-	clean_disk();
-	g_working_directory = create_disk();
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
 
 	content = rd("README.md");
 	if (content == NULL) {
 		perror("test_create_regularfile() failed");
 		return EXIT_FAILURE;
 	}
-	create_regularfile(&g_working_directory, filename, content, O_RDONLY);
-	if (get_filecount(&g_working_directory) != 1) {
+	create_regularfile(&g_fs, &g_working_directory, filename, content, O_RDONLY);
+	if (get_filecount(&g_fs, &g_working_directory) != 1) {
 		perror("test_create_regularfile() failed");
 		return EXIT_FAILURE;
 	}
@@ -139,8 +144,8 @@ int test_create_regularfile() {
 }
 
 int test_get_inode_blocs() {
-	clean_disk();
-	create_disk();
+	clean_disk(&g_fs);
+	create_disk(&g_fs);
 
 	return 1;
 }
@@ -149,22 +154,25 @@ int test_iwrite() {
 	char filename[FILENAME_COUNT] = "FILENAME";
 	char *content;
 	struct file f;
-	unsigned int blocs, inodes;
+	unsigned int blocs, inodes, blocs_before, inodes_before;
 	size_t bytes;
 
-	clean_disk();
-	g_working_directory = create_disk();
-	f = create_emptyfile(&g_working_directory, filename, REGULAR_FILE);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	f = create_emptyfile(&g_fs, &g_working_directory, filename, REGULAR_FILE);
+	disk_free(&g_fs, &blocs_before, &inodes_before, &bytes);
 	content = rd("README.md");
 	if (content == NULL) {
 		perror("test_remove_file() failed");
 		return EXIT_FAILURE;
 	}
 
-	iwrite(&f, content, 620);
-	iwrite(&f, content, 120);
-	disk_free(&blocs, &inodes, &bytes);
-	if (blocs != 1 && inodes != 0) {
+	iwrite(&g_fs, &f, content, 620);
+	f = iopen(&g_fs, &g_working_directory, filename, O_RDWR | O_TRUNC);
+	iwrite(&g_fs, &f, content, 120);
+	/* the bloc added by the first write is freed by the truncation */
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != blocs_before || inodes != inodes_before) {
 		perror("test_remove_file() failed");
 		return EXIT_FAILURE;
 	}
@@ -180,10 +188,10 @@ int test_get_filename_for_inode() {
 	char *rst;
 	struct file f;
 
-	clean_disk();
-	g_working_directory = create_disk();
-	f = create_regularfile(&g_working_directory, filename, content, O_RDONLY);
-	rst = get_filename_for_inode(&g_working_directory, &(f.inode));
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	f = create_regularfile(&g_fs, &g_working_directory, filename, content, O_RDONLY);
+	rst = get_filename_for_inode(&g_fs, &g_working_directory, &(f.inode));
 	if (rst == NULL) {
 		perror("Ah !");
 		return EXIT_FAILURE;
@@ -201,28 +209,35 @@ int test_get_filename_for_inode() {
 }
 
 int test_disk_free() {
-	unsigned int blocs, inodes;
+	unsigned int blocs, inodes, blocs_before, inodes_before;
 	size_t bytes;
 
-	clean_disk();
+	clean_disk(&g_fs);
 
 	/* write inode */
-	g_working_directory = create_disk();
+	g_working_directory = create_disk(&g_fs);
 
-	/* check number of inodes == 0 */
-	disk_free(&blocs, &inodes, &bytes);
-	if (blocs != 0 && inodes != 0 && bytes != 0) {
+	/* only the root uses an inode and a bloc */
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != DEFAULT_BLOC_COUNT - 1 || inodes != DEFAULT_INODE_COUNT - 1 || bytes == 0) {
 		perror("test_disk_free() failed");
 		return EXIT_FAILURE;
 	}
 
 	/* delete dir */
-	create_directory(&g_working_directory, "dir");
-	remove_empty_directory(&g_working_directory, "dir");
+	blocs_before = blocs;
+	inodes_before = inodes;
+	create_directory(&g_fs, &g_working_directory, "dir");
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != blocs_before - 1 || inodes != inodes_before - 1) {
+		perror("test_disk_free() failed");
+		return EXIT_FAILURE;
+	}
+	remove_empty_directory(&g_fs, &g_working_directory, "dir");
 
-	/* check number of inodes == 1 */
-	disk_free(&blocs, &inodes, &bytes);
-	if (blocs != 1 && inodes != 1) {
+	/* the inode and the bloc of dir are available again */
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != blocs_before || inodes != inodes_before) {
 		perror("test_disk_free() failed");
 		return 0;
 	}
@@ -236,16 +251,16 @@ int test_add_inode_to_inode() {
 	struct inode i, i2;
 	struct bloc b;
 
-	clean_disk();
-	create_disk();
+	clean_disk(&g_fs);
+	create_disk(&g_fs);
 	b = new_bloc("");
 	i = new_inode(DIRECTORY, DEFAULT_PERMISSIONS, g_username, g_username);
-	write_bloc(&b);
-	add_bloc(&i, &b);
-	write_inode(&i);
+	write_bloc(&g_fs, &b);
+	add_bloc(&g_fs, &i, &b);
+	write_inode(&g_fs, &i);
 
 	/* check filecount == 0 */
-	if (get_filecount(&i) != 0) {
+	if (get_filecount(&g_fs, &i) != 0) {
 		fprintf(stderr, "test_add_inode_to_inode() failed\n");
 		return EXIT_FAILURE;
 	}
@@ -253,14 +268,14 @@ int test_add_inode_to_inode() {
 	/* add inode/file to dir */
 	b = new_bloc("print('Hello World')\\n");
 	i2 = new_inode(REGULAR_FILE, DEFAULT_PERMISSIONS, g_username, g_username);
-	write_inode(&i2);
-	write_bloc(&b);
-	add_bloc(&i2, &b);
+	write_inode(&g_fs, &i2);
+	write_bloc(&g_fs, &b);
+	add_bloc(&g_fs, &i2, &b);
 
-	b = add_inode_to_inode(&i, &i2, "file.py");
-	update_bloc(&b);
+	b = add_inode_to_inode(&g_fs, &i, &i2, "file.py");
+	update_bloc(&g_fs, &b);
 	/* check filecount == 1 */
-	if (get_filecount(&i) != 1) {
+	if (get_filecount(&g_fs, &i) != 1) {
 		fprintf(stderr, "test_add_inode_to_inode() failed\n");
 		return EXIT_FAILURE;
 	}
@@ -274,19 +289,19 @@ int test_create_directory() {
 	int filecount;
 	char **files;
 
-	clean_disk();
-	g_working_directory = create_disk();
-	dir = create_directory(&g_working_directory, "home");
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	dir = create_directory(&g_fs, &g_working_directory, "home");
 
-	if (get_filecount(&g_working_directory) != 1) {
+	if (get_filecount(&g_fs, &g_working_directory) != 1) {
 		perror("test_create_directory() failed");
 		return EXIT_FAILURE;
 	}
-	if (get_filecount(&dir) != 2) {
+	if (get_filecount(&g_fs, &dir) != 2) {
 		perror("test_create_directory() failed");
 		return EXIT_FAILURE;
 	}
-	files = list_files(&dir, &filecount);
+	files = list_files(&g_fs, &dir, &filecount);
 	print_str_array(files, filecount);
 	free_str_array(files, filecount);
 
@@ -299,15 +314,15 @@ int test_create_directory() {
 int test_create_emptyfile() {
 	struct file f;
 
-	clean_disk();
-	g_working_directory = create_disk();
-	f = create_emptyfile(&g_working_directory, "hello.py", REGULAR_FILE);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	f = create_emptyfile(&g_fs, &g_working_directory, "hello.py", REGULAR_FILE);
 
 	if (f.inode.bloc_count != 1) {
 		perror("test_create_emptyfile() failed");
 		return EXIT_FAILURE;
 	}
-	if (get_filecount(&g_working_directory) != 1) {
+	if (get_filecount(&g_fs, &g_working_directory) != 1) {
 		perror("test_create_emptyfile() failed");
 		return EXIT_FAILURE;
 	}
@@ -320,16 +335,16 @@ int test_list_files() {
 	int filecount;
 	char **files;
 
-	clean_disk();
-	g_working_directory = create_disk();
-	create_directory(&g_working_directory, "home");
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	create_directory(&g_fs, &g_working_directory, "home");
 
-	files = list_files(&g_working_directory, &filecount);
+	files = list_files(&g_fs, &g_working_directory, &filecount);
 	print_str_array(files, filecount);
 	free_str_array(files, filecount);
 
-	create_regularfile(&g_working_directory, "hey.txt", "OwO", O_RDONLY);
-	files = list_files(&g_working_directory, &filecount);
+	create_regularfile(&g_fs, &g_working_directory, "hey.txt", "OwO", O_RDONLY);
+	files = list_files(&g_fs, &g_working_directory, &filecount);
 	print_str_array(files, filecount);
 	free_str_array(files, filecount);
 
@@ -338,9 +353,9 @@ int test_list_files() {
 }
 
 int test_get_filecount() {
-	clean_disk();
-	g_working_directory = create_disk();
-	if (get_filecount(&g_working_directory) != 0) {
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	if (get_filecount(&g_fs, &g_working_directory) != 0) {
 		perror("test_get_filecount() failed");
 		return EXIT_FAILURE;
 	}
@@ -356,12 +371,12 @@ int test_iread() {
 	size_t n = 120;
 	struct file f;
 
-	clean_disk();
-	g_working_directory = create_disk();
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
 	content = rd("README.md");
-	f = create_regularfile(&g_working_directory, filename, content, O_RDONLY);
+	f = create_regularfile(&g_fs, &g_working_directory, filename, content, O_RDONLY);
 	free(content);
-	iread(&f, buf, n);
+	iread(&g_fs, &f, buf, n);
 
 	if (buf == NULL) {
 		perror("test_iread() failure");
@@ -397,11 +412,11 @@ int test_get_inodes() {
 	int len, z;
 	struct inode *inodes;
 
-	clean_disk();
-	g_working_directory = create_disk();
-	create_regularfile(&g_working_directory, "FILENAME", "TRUC", O_RDONLY);
-	create_directory(&g_working_directory, "home");
-	len = get_inodes(&g_working_directory, &inodes);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	create_regularfile(&g_fs, &g_working_directory, "FILENAME", "TRUC", O_RDONLY);
+	create_directory(&g_fs, &g_working_directory, "home");
+	len = get_inodes(&g_fs, &g_working_directory, &inodes);
 
 	if (len != 2) {
 		perror("NON");
@@ -420,18 +435,18 @@ int test_get_inodes() {
 int test_iopen() {
 	struct file f1, f2;
 
-	clean_disk();
-	g_working_directory = create_disk();
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
 
-	f1 = create_regularfile(&g_working_directory, "Bidsouf", "Yahoo", O_RDONLY);
-	f2 = iopen(&g_working_directory, "Bidsouf", O_RDONLY);
+	f1 = create_regularfile(&g_fs, &g_working_directory, "Bidsouf", "Yahoo", O_RDONLY);
+	f2 = iopen(&g_fs, &g_working_directory, "Bidsouf", O_RDONLY);
 	if (!inode_equals(f1.inode, f2.inode)) {
 		perror("test_iopen() failed");
 		printf("F1 %u F2 %u \n", f1.inode.id, f2.inode.id);
-		print_disk();
+		print_disk(&g_fs);
 		return EXIT_FAILURE;
 	}
-	f1 = iopen(&g_working_directory, "Croute", O_RDONLY);
+	f1 = iopen(&g_fs, &g_working_directory, "Croute", O_RDONLY);
 	if (f1.inode.id != DELETED) {
 		perror("test_iopen() failed");
 		return EXIT_FAILURE;
@@ -447,29 +462,29 @@ int test_remove_empty_directory() {
 	char **files;
 	struct inode dir, usr_dir;
 
-	clean_disk();
-	g_working_directory = create_disk();
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
 
-	dir = create_directory(&g_working_directory, "home");
+	dir = create_directory(&g_fs, &g_working_directory, "home");
 
-	files = list_files(&dir, &filecount);
+	files = list_files(&g_fs, &dir, &filecount);
 	print_str_array(files, filecount);
 	free_str_array(files, filecount);
 
-	if (get_filecount(&dir) != 2) {
+	if (get_filecount(&g_fs, &dir) != 2) {
 		perror("test_remove_empty_directory() failed");
 		return EXIT_FAILURE;
 	}
 
-	if (remove_empty_directory(&g_working_directory, "home") != EXIT_SUCCESS
-			&& get_filecount(&g_working_directory) != 1) {
+	if (remove_empty_directory(&g_fs, &g_working_directory, "home") != EXIT_SUCCESS
+			&& get_filecount(&g_fs, &g_working_directory) != 1) {
 		perror("test_remove_empty_directory() failed");
 		return EXIT_FAILURE;
 	}
 
-	usr_dir = create_directory(&g_working_directory, "usr");
-	create_regularfile(&usr_dir, "user_file.sh", "echo 'je suis une loutre'", O_RDONLY);
-	if (remove_empty_directory(&g_working_directory, "usr") != EXIT_FAILURE && get_filecount(&usr_dir) != 3) {
+	usr_dir = create_directory(&g_fs, &g_working_directory, "usr");
+	create_regularfile(&g_fs, &usr_dir, "user_file.sh", "echo 'je suis une loutre'", O_RDONLY);
+	if (remove_empty_directory(&g_fs, &g_working_directory, "usr") != EXIT_FAILURE && get_filecount(&g_fs, &usr_dir) != 3) {
 		perror("test_remove_empty_directory() failed");
 		return EXIT_FAILURE;
 	}
@@ -493,32 +508,28 @@ int test_strjoin() {
 }
 
 int test_remove_file() {
-	unsigned int blocs, inodes;
+	unsigned int blocs, inodes, blocs_before, inodes_before;
 	size_t bytes;
 
 
-	clean_disk();
-	g_working_directory = create_disk();
-	create_regularfile(&g_working_directory, "FILENAME", "TRUC", O_RDONLY);
-	create_directory(&g_working_directory, "home");
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	create_regularfile(&g_fs, &g_working_directory, "FILENAME", "TRUC", O_RDONLY);
+	create_directory(&g_fs, &g_working_directory, "home");
 
-	if (remove_file(&g_working_directory, "home", REGULAR_FILE) != EXIT_FAILURE) {
+	if (remove_file(&g_fs, &g_working_directory, "home", REGULAR_FILE) != EXIT_FAILURE) {
 		perror("test_remove_file() failed");
 		return EXIT_FAILURE;
 	}
 
-	disk_free(&blocs, &inodes, &bytes);
-	if (blocs != 0 && inodes != 0 && bytes != 0) {
-		perror("test_remove_file() failed");
-		return EXIT_FAILURE;
-	}
+	disk_free(&g_fs, &blocs_before, &inodes_before, &bytes);
 
-	if (remove_file(&g_working_directory, "FILENAME", REGULAR_FILE) != EXIT_SUCCESS) {
+	if (remove_file(&g_fs, &g_working_directory, "FILENAME", REGULAR_FILE) != EXIT_SUCCESS) {
 		perror("test_remove_file() failed");
 		return EXIT_FAILURE;
 	}
-	disk_free(&blocs, &inodes, &bytes);
-	if (blocs != 1 && inodes != 1) {
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != blocs_before + 1 || inodes != inodes_before + 1) {
 		perror("test_remove_file() failed");
 		return EXIT_FAILURE;
 	}
@@ -530,20 +541,20 @@ int test_remove_file() {
 int test_move_file() {
 	struct inode to;
 
-	clean_disk();
-	g_working_directory = create_disk();
-	create_regularfile(&g_working_directory, "FILENAME", "TRUC", O_RDONLY);
-	to = create_directory(&g_working_directory, "home");
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	create_regularfile(&g_fs, &g_working_directory, "FILENAME", "TRUC", O_RDONLY);
+	to = create_directory(&g_fs, &g_working_directory, "home");
 
-	move_file(&g_working_directory, "FILENAME", &to);
+	move_file(&g_fs, &g_working_directory, "FILENAME", &to);
 
-	print_disk();
-	if (get_filecount(&g_working_directory) != 1) {
+	print_disk(&g_fs);
+	if (get_filecount(&g_fs, &g_working_directory) != 1) {
 		perror("test_move_file() failed");
 		return EXIT_FAILURE;
 	}
-	print_disk();
-	if (get_filecount(&to) != 3) {
+	print_disk(&g_fs);
+	if (get_filecount(&g_fs, &to) != 3) {
 		perror("test_move_file() failed");
 		return EXIT_FAILURE;
 	}
@@ -557,38 +568,38 @@ int test_mode() {
 	struct file f;
 	char buf[20];
 
-	clean_disk();
-	g_working_directory = create_disk();
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
 
 	/* rdonly and iwrite (expect failure) */
-	f = create_regularfile(&g_working_directory, "FILENAME", "TzegzgezegzezgRUC", O_RDONLY);
+	f = create_regularfile(&g_fs, &g_working_directory, "FILENAME", "TzegzgezegzezgRUC", O_RDONLY);
 
 	printf("FLAGS %d\n", f.flags);
-	if (iwrite(&f, "tototototototototototo", 10) != EXIT_FAILURE) {
+	if (iwrite(&g_fs, &f, "tototototototototototo", 10) != EXIT_FAILURE) {
 		fprintf(stderr, "test_mode() failed\n");
 		return EXIT_FAILURE;
 	}
 
 	/* wronly and iread (expect failure) */
-	f = iopen(&g_working_directory, "FILENAME", O_WRONLY);
+	f = iopen(&g_fs, &g_working_directory, "FILENAME", O_WRONLY);
 	printf("FLAGS %d\n", f.flags);
-	if (iread(&f, buf, 10) != EXIT_FAILURE) {
+	if (iread(&g_fs, &f, buf, 10) != EXIT_FAILURE) {
 		fprintf(stderr, "test_mode() failed\n");
 		return EXIT_FAILURE;
 	}
 
 	/* rdwr and iread and iwrite (expect success) */
-	f = iopen(&g_working_directory, "FILENAME", O_RDWR);
-	if (iread(&f, buf, 10) != EXIT_SUCCESS &&
-			iwrite(&f, "encorecnoreencore", 10) != EXIT_SUCCESS) {
+	f = iopen(&g_fs, &g_working_directory, "FILENAME", O_RDWR);
+	if (iread(&g_fs, &f, buf, 10) != EXIT_SUCCESS &&
+			iwrite(&g_fs, &f, "encorecnoreencore", 10) != EXIT_SUCCESS) {
 		fprintf(stderr, "test_mode() failed\n");
 		return EXIT_FAILURE;
 	}
 
 	/* o_creat and iread (expect failure) and iwrite (expect success) */
-	f = iopen(&g_working_directory, "FILENAME", O_RDWR);
-	if (iread(&f, buf, 10) != EXIT_SUCCESS &&
-			iwrite(&f, "encorecnoreencore", 10) != EXIT_SUCCESS) {
+	f = iopen(&g_fs, &g_working_directory, "FILENAME", O_RDWR);
+	if (iread(&g_fs, &f, buf, 10) != EXIT_SUCCESS &&
+			iwrite(&g_fs, &f, "encorecnoreencore", 10) != EXIT_SUCCESS) {
 
 		fprintf(stderr, "test_mode() failed\n");
 		return EXIT_FAILURE;
@@ -601,12 +612,12 @@ int test_mode() {
 int test_get_inode_by_filename() {
 	struct inode i;
 	struct file f1;
-	clean_disk();
-	g_working_directory = create_disk();
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
 
-	f1 = create_regularfile(&g_working_directory, "Bidsouf", "Yahoo", O_RDONLY);
+	f1 = create_regularfile(&g_fs, &g_working_directory, "Bidsouf", "Yahoo", O_RDONLY);
 
-	i = get_inode_by_filename(&g_working_directory, "Bidsouf");
+	i = get_inode_by_filename(&g_fs, &g_working_directory, "Bidsouf");
 	if (i.id != f1.inode.id) {
 		perror("test_get_inode_by_filename() failed");
 		printf("i %u f1 %u\n", i.id, f1.inode.id);
@@ -617,11 +628,1423 @@ int test_get_inode_by_filename() {
 	return EXIT_SUCCESS;
 }
 
+int test_idmap() {
+	struct idmap m;
+	long value;
+	unsigned int z;
+
+	idmap_init(&m);
+	for (z = 1; z != 1000; z++)
+		idmap_put(&m, z * 7, z);
+
+	for (z = 1; z < 1000; z += 2)
+		idmap_remove(&m, z * 7);
+
+	for (z = 1; z != 1000; z++) {
+		if (idmap_get(&m, z * 7, &value) != (z % 2 == 0) || (z % 2 == 0 && value != (long) z)) {
+			perror("test_idmap() failed");
+			idmap_free(&m);
+			return EXIT_FAILURE;
+		}
+	}
+	idmap_free(&m);
+
+	printf("test_idmap() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_disk_index() {
+	struct bloc blocs[200];
+	struct bloc b;
+	int z;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	for (z = 0; z != 200; z++) {
+		blocs[z] = new_bloc("");
+		sprintf(blocs[z].content, "bloc %d", z);
+		write_bloc(&g_fs, &blocs[z]);
+	}
+
+	for (z = 0; z < 200; z += 3)
+		delete_bloc(&g_fs, &blocs[z]);
+
+	/* lookups must also survive an index rebuilt from the disk */
+	refresh_disk(&g_fs);
+	strcpy(blocs[1].content, "overwritten");
+	update_bloc(&g_fs, &blocs[1]);
+
+	for (z = 0; z != 200; z++) {
+		if (z % 3 == 0) continue;
+
+		b = get_bloc_by_id(&g_fs, blocs[z].id);
+		if (b.id != blocs[z].id || strcmp(b.content, blocs[z].content) != 0) {
+			perror("test_disk_index() failed");
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (get_inode_by_id(&g_fs, ROOT_ID).id != ROOT_ID) {
+		perror("test_disk_index() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_disk_index() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_convert_disk() {
+	FILE *f;
+	struct inode_v1 old_root, old_file;
+	struct inode root, file;
+	struct bloc_v1 b;
+	unsigned int version;
+	int z;
+	const char *parts[3] = { "abc", "def", "" };
+
+	/* a v1 disk: a log of flagged records */
+	clean_disk(&g_fs);
+	f = fopen(DISK, "wb");
+	memset(&old_root, 0, sizeof(struct inode_v1));
+	old_root.id = ROOT_ID;
+	old_root.type = DIRECTORY;
+	old_root.permissions = ROOT_PERMISSIONS;
+	memset(&b, 0, sizeof(struct bloc_v1));
+	b.id = 42;
+	strcpy(b.content, "7:f,");
+	old_root.bloc_ids[0] = b.id;
+	old_root.bloc_count = 1;
+	fwrite(&INODE_FLAG, sizeof(const int), 1, f);
+	fwrite(&old_root, sizeof(struct inode_v1), 1, f);
+	fwrite(&BLOC_FLAG, sizeof(const int), 1, f);
+	fwrite(&b, sizeof(struct bloc_v1), 1, f);
+
+	/* a file of 6 bytes over 3 blocs, the last one empty */
+	memset(&old_file, 0, sizeof(struct inode_v1));
+	old_file.id = 7;
+	old_file.type = REGULAR_FILE;
+	old_file.permissions = DEFAULT_PERMISSIONS;
+	/* the v1 times are addresses of the process that wrote the disk */
+	old_file.created_at = (const struct tm *) &old_file;
+	old_file.updated_at = (struct tm *) &old_file;
+	for (z = 0; z != 3; z++) {
+		memset(&b, 0, sizeof(struct bloc_v1));
+		b.id = 50 + z;
+		strcpy(b.content, parts[z]);
+		old_file.bloc_ids[z] = b.id;
+		fwrite(&BLOC_FLAG, sizeof(const int), 1, f);
+		fwrite(&b, sizeof(struct bloc_v1), 1, f);
+	}
+	old_file.bloc_count = 3;
+	fwrite(&INODE_FLAG, sizeof(const int), 1, f);
+	fwrite(&old_file, sizeof(struct inode_v1), 1, f);
+	fclose(f);
+
+	if (disk_version(DISK) != 1 || convert_disk(DISK) != EXIT_SUCCESS
+			|| disk_version(DISK) != DISK_VERSION) {
+		perror("test_convert_disk() failed");
+		return EXIT_FAILURE;
+	}
+
+	if (mount_disk(&g_fs, DISK) != EXIT_SUCCESS) {
+		perror("test_convert_disk() failed");
+		return EXIT_FAILURE;
+	}
+
+	root = get_inode_by_id(&g_fs, ROOT_ID);
+	/* the ids are given again: the bloc 42 is now the first bloc */
+	if (root.id != ROOT_ID || root.bloc_count != 1 || bmap(&g_fs, &root, 0) != 1
+			|| get_bloc_by_id(&g_fs, bmap(&g_fs, &root, 0)).id != 1) {
+		perror("test_convert_disk() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* the bytes of the file are packed in one bloc, the emptied ones are dropped */
+	file = get_inode_by_id(&g_fs, ROOT_ID + 1);
+	if (file.type != REGULAR_FILE || file.size != 6 || file.bloc_count != 1
+			|| strcmp(get_bloc_by_id(&g_fs, bmap(&g_fs, &file, 0)).content, "abcdef") != 0
+			|| used_slots(&g_fs, BLOC_FLAG) != 2
+			|| file.created_at <= 0 || file.created_at > (int64_t) time(NULL) || file.updated_at != file.created_at) {
+		perror("test_convert_disk() failed");
+		printf("size %u blocs %d\n", (unsigned int) file.size, file.bloc_count);
+		return EXIT_FAILURE;
+	}
+
+	/* any other version has no upgrade path: it's refused and left as it is */
+	unmount_disk(&g_fs);
+	f = fopen(DISK, "r+b");
+	version = DISK_VERSION - 1;
+	fseek(f, sizeof(unsigned int), SEEK_SET);
+	fwrite(&version, sizeof(unsigned int), 1, f);
+	fclose(f);
+
+	if (mount_disk(&g_fs, DISK) == EXIT_SUCCESS || convert_disk(DISK) == EXIT_SUCCESS
+			|| disk_version(DISK) != DISK_VERSION - 1) {
+		perror("test_convert_disk() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_convert_disk() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_slot_reuse() {
+	struct superblock sb;
+	int z;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	/* create/delete churn must reuse the freed slots */
+	for (z = 0; z != 50; z++) {
+		create_regularfile(&g_fs, &g_working_directory, "churn", "some content", O_RDONLY);
+		remove_file(&g_fs, &g_working_directory, "churn", REGULAR_FILE);
+	}
+
+	if (g_fs.sb.inode_high > 2 || g_fs.sb.bloc_high > 2) {
+		perror("test_slot_reuse() failed");
+		printf("inodes %u blocs %u\n", g_fs.sb.inode_high, g_fs.sb.bloc_high);
+		return EXIT_FAILURE;
+	}
+
+	/* a superblock left behind by a crash: the highs follow the bitmaps at mount */
+	create_regularfile(&g_fs, &g_working_directory, "kept", "some content", O_RDONLY);
+	flush_disk(&g_fs);
+	sb = g_fs.sb;
+	sb.inode_high = 0;
+	sb.bloc_high = 0;
+	pwrite(g_fs.fd, &sb, sizeof(struct superblock), 0);
+	refresh_disk(&g_fs);
+	if (g_fs.sb_dirty || g_fs.sb.inode_high != 2 || g_fs.sb.bloc_high != 2) {
+		perror("test_slot_reuse() failed");
+		printf("inodes %u blocs %u\n", g_fs.sb.inode_high, g_fs.sb.bloc_high);
+		return EXIT_FAILURE;
+	}
+
+	printf("test_slot_reuse() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_sequential_ids() {
+	struct inode a, b, c;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	/* ids follow the slots: the root is 1, the next inodes 2 and 3 */
+	a = new_inode(REGULAR_FILE, DEFAULT_PERMISSIONS, g_username, g_username);
+	b = new_inode(REGULAR_FILE, DEFAULT_PERMISSIONS, g_username, g_username);
+	write_inode(&g_fs, &a);
+	write_inode(&g_fs, &b);
+	if (a.id != ROOT_ID + 1 || b.id != ROOT_ID + 2) {
+		perror("test_sequential_ids() failed");
+		printf("ids %u %u\n", a.id, b.id);
+		return EXIT_FAILURE;
+	}
+
+	/* a freed id is given again before a new one */
+	a.id = DELETED;
+	overwrite_inode(&g_fs, &a, ROOT_ID + 1);
+	c = new_inode(REGULAR_FILE, DEFAULT_PERMISSIONS, g_username, g_username);
+	write_inode(&g_fs, &c);
+	if (c.id != ROOT_ID + 1 || get_inode_by_id(&g_fs, b.id).id != b.id) {
+		perror("test_sequential_ids() failed");
+		printf("id %u\n", c.id);
+		return EXIT_FAILURE;
+	}
+
+	printf("test_sequential_ids() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_extents() {
+	struct file f;
+	struct inode i;
+	struct bloc b;
+	unsigned int ids[EXTENT_COUNT + EXTENTS_PER_BLOC + 1];
+	unsigned int z, count, blocs_before, blocs, inodes;
+	size_t bytes;
+	char *content, *buf;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	/* 20 blocs (an inode used to hold 10) in one extent */
+	content = (char *) malloc(20 * BLOC_SIZE + 1);
+	buf = (char *) malloc(20 * BLOC_SIZE + 1);
+	memset(content, 'x', 20 * BLOC_SIZE);
+	content[20 * BLOC_SIZE] = '\0';
+
+	f = create_emptyfile(&g_fs, &g_working_directory, "big", REGULAR_FILE);
+	iwrite(&g_fs, &f, content, strlen(content));
+	if (f.inode.bloc_count != 20 || f.inode.extent_count != 1) {
+		perror("test_extents() failed");
+		printf("blocs %d extents %d\n", f.inode.bloc_count, f.inode.extent_count);
+		return EXIT_FAILURE;
+	}
+
+	f = iopen(&g_fs, &g_working_directory, "big", O_RDWR);
+	iread(&g_fs, &f, buf, get_total_strlen(&g_fs, &f.inode));
+	if (strcmp(buf, content) != 0) {
+		perror("test_extents() failed");
+		return EXIT_FAILURE;
+	}
+	free(content);
+	free(buf);
+
+	/* one bloc out of two: an extent a bloc, past the inode and an extent bloc */
+	count = EXTENT_COUNT + EXTENTS_PER_BLOC + 1;
+	i = new_inode(REGULAR_FILE, DEFAULT_PERMISSIONS, g_username, g_username);
+	for (z = 0; z != count; z++) {
+		b = new_bloc("gap");
+		write_bloc(&g_fs, &b);
+		b = new_bloc("data");
+		write_bloc(&g_fs, &b);
+		add_bloc(&g_fs, &i, &b);
+		ids[z] = b.id;
+	}
+
+	if (i.extent_count != (int) count || i.overflow == DELETED) {
+		perror("test_extents() failed");
+		return EXIT_FAILURE;
+	}
+
+	for (z = 0; z != count; z++) {
+		if (bmap(&g_fs, &i, z) != ids[z]) {
+			perror("test_extents() failed");
+			printf("bloc %u: %u instead of %u\n", z, bmap(&g_fs, &i, z), ids[z]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* the blocs and the 2 extent blocs are freed, a first cut keeps the first blocs mapped */
+	disk_free(&g_fs, &blocs_before, &inodes, &bytes);
+	if (extent_truncate(&g_fs, &i, count - 2) != EXIT_SUCCESS || i.bloc_count != (int) count - 2
+			|| bmap(&g_fs, &i, count - 3) != ids[count - 3] || bmap(&g_fs, &i, count - 2) != DELETED) {
+		perror("test_extents() failed");
+		return EXIT_FAILURE;
+	}
+	extent_truncate(&g_fs, &i, 0);
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != blocs_before + count + 2 || i.bloc_count != 0 || i.overflow != DELETED) {
+		perror("test_extents() failed");
+		printf("blocs %u -> %u\n", blocs_before, blocs);
+		return EXIT_FAILURE;
+	}
+
+	printf("test_extents() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_hashed_directory() {
+	struct inode dir;
+	struct dir_iter it;
+	char name[FILENAME_COUNT];
+	unsigned int ids[200];
+	int z, filecount, found;
+	char **files;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	dir = create_directory(&g_fs, &g_working_directory, "big");
+
+	/* a bloc used to hold about 30 entries */
+	for (z = 0; z != 200; z++) {
+		sprintf(name, "file%d", z);
+		ids[z] = create_emptyfile(&g_fs, &dir, name, REGULAR_FILE).inode.id;
+	}
+
+	if (dir.bloc_count < 2 || get_filecount(&g_fs, &dir) != 202) {
+		perror("test_hashed_directory() failed");
+		printf("blocs %d files %u\n", dir.bloc_count, get_filecount(&g_fs, &dir));
+		return EXIT_FAILURE;
+	}
+
+	for (z = 0; z != 200; z++) {
+		sprintf(name, "file%d", z);
+		if (get_inode_by_filename(&g_fs, &dir, name).id != ids[z]) {
+			perror("test_hashed_directory() failed");
+			printf("%s not found\n", name);
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* a name is in its bucket */
+	dir_iter_bucket(&g_fs, &it, &dir, "file7");
+	found = 0;
+	while (dir_iter_next(&it))
+		found += strcmp(it.name, "file7") == 0;
+	if (found != 1 || it.bucket != dir_bucket(&dir, "file7")) {
+		perror("test_hashed_directory() failed");
+		return EXIT_FAILURE;
+	}
+
+	for (z = 0; z != 200; z += 2) {
+		sprintf(name, "file%d", z);
+		remove_file(&g_fs, &dir, name, REGULAR_FILE);
+	}
+
+	files = list_files(&g_fs, &dir, &filecount);
+	free_str_array(files, filecount);
+	if (filecount != 102 || get_inode_by_filename(&g_fs, &dir, "file2").id != DELETED
+			|| get_inode_by_filename(&g_fs, &dir, "file3").id != ids[3]) {
+		perror("test_hashed_directory() failed");
+		printf("files %d\n", filecount);
+		return EXIT_FAILURE;
+	}
+
+	printf("test_hashed_directory() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_dirents() {
+	struct inode dir;
+	struct dir_iter it;
+	struct bloc b;
+	char name[FILENAME_COUNT + 1];
+	unsigned int file_id, used;
+	int z;
+	const char *names[] = {".", "..", "a", "file", "b"};
+	enum filetype types[] = {DIRECTORY, DIRECTORY, DIRECTORY, REGULAR_FILE, DIRECTORY};
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	dir = create_directory(&g_fs, &g_working_directory, "home");
+	create_directory(&g_fs, &dir, "a");
+	file_id = create_emptyfile(&g_fs, &dir, "file", REGULAR_FILE).inode.id;
+	create_directory(&g_fs, &dir, "b");
+
+	/* the entries come in order with their type hints */
+	z = 0;
+	dir_iter_init(&g_fs, &it, &dir);
+	while (dir_iter_next(&it)) {
+		if (z == 5 || strcmp(it.name, names[z]) != 0 || it.type != types[z]
+				|| it.name_len != (int) strlen(names[z]) || (z == 3 && it.id != file_id)) {
+			perror("test_dirents() failed");
+			printf("entry %d: %s\n", z, it.name);
+			return EXIT_FAILURE;
+		}
+		z++;
+	}
+
+	/* a removed entry leaves no hole */
+	b = remove_inode_from_directory(&g_fs, &dir, "file");
+	update_bloc(&g_fs, &b);
+	z = 0;
+	dir_iter_init(&g_fs, &it, &dir);
+	while (dir_iter_next(&it))
+		z++;
+
+	if (z != 4 || strcmp(it.name, "b") != 0 || get_inode_by_filename(&g_fs, &dir, "b").type != DIRECTORY) {
+		perror("test_dirents() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a name is once in a directory, and fits the path and listing buffers */
+	used = used_slots(&g_fs, INODE_FLAG);
+	memset(name, 'n', FILENAME_COUNT);
+	name[FILENAME_COUNT] = '\0';
+	b = get_bloc_by_id(&g_fs, bmap(&g_fs, &dir, dir_bucket(&dir, "b")));
+	if (dirent_add(&b, dir.id, DIRECTORY, "b") == EXIT_SUCCESS || dirent_add(&b, dir.id, DIRECTORY, name) == EXIT_SUCCESS
+			|| create_directory(&g_fs, &dir, "b").id != DELETED || create_directory(&g_fs, &dir, name).id != DELETED
+			|| create_emptyfile(&g_fs, &dir, "a", REGULAR_FILE).inode.id != DELETED
+			|| used_slots(&g_fs, INODE_FLAG) != used || get_filecount(&g_fs, &dir) != 4) {
+		perror("test_dirents() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_dirents() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_dcache() {
+	struct inode home, a, b;
+	struct file f;
+	unsigned long hits;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	home = create_directory(&g_fs, &g_working_directory, "home");
+
+	/* the second lookup of a name is a hit, a missing name too */
+	get_inode_by_filename(&g_fs, &g_working_directory, "home");
+	get_inode_by_filename(&g_fs, &g_working_directory, "missing");
+	hits = g_fs.dcache.hits;
+	if (get_inode_by_filename(&g_fs, &g_working_directory, "home").id != home.id
+			|| get_inode_by_filename(&g_fs, &g_working_directory, "missing").id != DELETED
+			|| g_fs.dcache.hits != hits + 2) {
+		perror("test_dcache() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* adding and removing a name drop its lookup */
+	f = iopen(&g_fs, &g_working_directory, "missing", O_CREAT | O_RDWR);
+	if (get_inode_by_filename(&g_fs, &g_working_directory, "missing").id != f.inode.id) {
+		perror("test_dcache() failed");
+		return EXIT_FAILURE;
+	}
+	remove_file(&g_fs, &g_working_directory, "missing", REGULAR_FILE);
+	if (get_inode_by_filename(&g_fs, &g_working_directory, "missing").id != DELETED) {
+		perror("test_dcache() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a moved directory gets its new parent */
+	a = create_directory(&g_fs, &home, "a");
+	b = create_directory(&g_fs, &home, "b");
+	get_inode_by_filename(&g_fs, &a, "..");
+	move_file(&g_fs, &home, "a", &b);
+	if (get_inode_by_filename(&g_fs, &a, "..").id != b.id
+			|| get_inode_by_filename(&g_fs, &home, "a").id != DELETED
+			|| get_inode_by_filename(&g_fs, &b, "a").id != a.id) {
+		perror("test_dcache() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_dcache() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_resolve_path() {
+	struct inode home, user, docs;
+	char name[FILENAME_COUNT];
+	char *path;
+	unsigned long hits;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	home = create_directory(&g_fs, &g_working_directory, "home");
+	user = create_directory(&g_fs, &home, "user");
+	docs = create_directory(&g_fs, &user, "docs");
+	create_regularfile(&g_fs, &docs, "notes", "some notes", O_RDWR);
+
+	/* absolute, relative, "." and ".." */
+	if (resolve_path(&g_fs, &docs, "/home/user/docs").id != docs.id
+			|| resolve_path(&g_fs, &g_working_directory, "home//user/").id != user.id
+			|| resolve_path(&g_fs, &docs, "../..").id != home.id
+			|| resolve_path(&g_fs, &docs, "./../docs/.").id != docs.id
+			|| resolve_path(&g_fs, &home, "/../..").id != ROOT_ID
+			|| resolve_path(&g_fs, &home, "user/missing").id != DELETED
+			|| resolve_path(&g_fs, &home, "user/docs/notes/..").id != DELETED) {
+		perror("test_resolve_path() failed");
+		return EXIT_FAILURE;
+	}
+
+	if (resolve_parent(&g_fs, &home, "user/docs/notes", name).id != docs.id
+			|| strcmp(name, "notes") != 0
+			|| resolve_parent(&g_fs, &home, "/home", name).id != ROOT_ID
+			|| resolve_parent(&g_fs, &home, "/", name).id != DELETED) {
+		perror("test_resolve_path() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* the reverse lookups are memoized: the second path is cache hits only */
+	path = inode_path(&g_fs, &docs);
+	if (path == NULL || strcmp(path, "/home/user/docs") != 0) {
+		perror("test_resolve_path() failed");
+		return EXIT_FAILURE;
+	}
+	free(path);
+
+	hits = g_fs.dcache.hits;
+	path = inode_path(&g_fs, &docs);
+	if (path == NULL || strcmp(path, "/home/user/docs") != 0 || g_fs.dcache.hits != hits + 3) {
+		perror("test_resolve_path() failed");
+		return EXIT_FAILURE;
+	}
+	free(path);
+
+	/* a moved directory gets its new path */
+	move_file(&g_fs, &home, "user", &g_working_directory);
+	path = inode_path(&g_fs, &docs);
+	if (path == NULL || strcmp(path, "/user/docs") != 0) {
+		perror("test_resolve_path() failed");
+		return EXIT_FAILURE;
+	}
+	free(path);
+
+	printf("test_resolve_path() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_binary_content() {
+	char content[2 * BLOC_SIZE], buf[2 * BLOC_SIZE + 1];
+	struct file f;
+	int z;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	/* every byte of a bloc is used, '\0' is a byte like the others */
+	for (z = 0; z != 2 * BLOC_SIZE; z++)
+		content[z] = (char) (z % 7);
+
+	f = create_emptyfile(&g_fs, &g_working_directory, "binary", REGULAR_FILE);
+	iwrite(&g_fs, &f, content, 2 * BLOC_SIZE);
+	if (f.inode.bloc_count != 2 || get_total_strlen(&g_fs, &f.inode) != 2 * BLOC_SIZE) {
+		perror("test_binary_content() failed");
+		return EXIT_FAILURE;
+	}
+
+	f = iopen(&g_fs, &g_working_directory, "binary", O_RDWR);
+	iread(&g_fs, &f, buf, get_total_strlen(&g_fs, &f.inode));
+	if (memcmp(buf, content, 2 * BLOC_SIZE) != 0) {
+		perror("test_binary_content() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a read stops at n bytes, in the middle of a bloc */
+	iread_at(&g_fs, &f, 0, buf, BLOC_SIZE + 3);
+	if (memcmp(buf, content, BLOC_SIZE + 3) != 0 || buf[BLOC_SIZE + 3] != '\0') {
+		perror("test_binary_content() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_binary_content() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_iread_at() {
+	char content[3 * BLOC_SIZE], buf[3 * BLOC_SIZE + 1];
+	struct file f;
+	int z;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	for (z = 0; z != 3 * BLOC_SIZE; z++)
+		content[z] = 'a' + z % 26;
+
+	f = create_emptyfile(&g_fs, &g_working_directory, "random", REGULAR_FILE);
+	iwrite(&g_fs, &f, content, 3 * BLOC_SIZE);
+	f = iopen(&g_fs, &g_working_directory, "random", O_RDWR);
+
+	/* across two blocs, the tail, past the end */
+	if (iread_at(&g_fs, &f, BLOC_SIZE - 2, buf, 4) != EXIT_SUCCESS
+			|| memcmp(buf, content + BLOC_SIZE - 2, 4) != 0 || buf[4] != '\0') {
+		perror("test_iread_at() failed");
+		return EXIT_FAILURE;
+	}
+	if (iread_at(&g_fs, &f, 3 * BLOC_SIZE - 5, buf, 100) != EXIT_SUCCESS
+			|| memcmp(buf, content + 3 * BLOC_SIZE - 5, 5) != 0 || buf[5] != '\0') {
+		perror("test_iread_at() failed");
+		return EXIT_FAILURE;
+	}
+	if (iread_at(&g_fs, &f, 3 * BLOC_SIZE, buf, 10) != EXIT_SUCCESS || buf[0] != '\0') {
+		perror("test_iread_at() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* iread goes on from where the last one stopped */
+	iread(&g_fs, &f, buf, BLOC_SIZE + 1);
+	iread(&g_fs, &f, buf, 3);
+	if (memcmp(buf, content + BLOC_SIZE + 1, 3) != 0 || f.current_pos != BLOC_SIZE + 4) {
+		perror("test_iread_at() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_iread_at() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_incremental_write() {
+	char content[2 * BLOC_SIZE], buf[2 * BLOC_SIZE + 1];
+	struct file f;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	memset(content, 'a', BLOC_SIZE - 10);
+	f = create_emptyfile(&g_fs, &g_working_directory, "log", REGULAR_FILE);
+	iwrite(&g_fs, &f, content, BLOC_SIZE - 10);
+
+	/* an append fills the free space of the last bloc first */
+	f = iopen(&g_fs, &g_working_directory, "log", O_WRONLY | O_APPEND);
+	iwrite(&g_fs, &f, "bbbbb", 5);
+	if (f.inode.bloc_count != 1 || f.inode.size != BLOC_SIZE - 5) {
+		perror("test_incremental_write() failed");
+		return EXIT_FAILURE;
+	}
+	iwrite(&g_fs, &f, "cccccccccc", 10);
+	if (f.inode.bloc_count != 2 || f.inode.extent_count != 1 || f.inode.size != BLOC_SIZE + 5) {
+		perror("test_incremental_write() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a write in the middle changes its bytes only, one past the end leaves a hole */
+	f = iopen(&g_fs, &g_working_directory, "log", O_RDWR);
+	iwrite_at(&g_fs, &f, BLOC_SIZE - 6, "XYZ", 3);
+	iwrite_at(&g_fs, &f, BLOC_SIZE + 8, "end", 3);
+	memset(content + BLOC_SIZE - 10, 'b', 5);
+	memset(content + BLOC_SIZE - 5, 'c', 10);
+	memcpy(content + BLOC_SIZE - 6, "XYZ", 3);
+	memset(content + BLOC_SIZE + 5, 0, 3);
+	memcpy(content + BLOC_SIZE + 8, "end", 3);
+	iread_at(&g_fs, &f, 0, buf, 2 * BLOC_SIZE);
+	if (f.inode.size != BLOC_SIZE + 11 || memcmp(buf, content, BLOC_SIZE + 11) != 0) {
+		perror("test_incremental_write() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a truncation frees the blocs past the size */
+	itruncate(&g_fs, &f, 7);
+	iread_at(&g_fs, &f, 0, buf, 2 * BLOC_SIZE);
+	if (f.inode.bloc_count != 1 || f.inode.size != 7 || strcmp(buf, "aaaaaaa") != 0) {
+		perror("test_incremental_write() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_incremental_write() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_vectored_io() {
+	char header[3] = "abc", body[BLOC_SIZE], footer[7] = "0123456";
+	char first[BLOC_SIZE + 1], second[20], buf[BLOC_SIZE + 11];
+	struct iovec out[4], in[2];
+	struct file f;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	memset(body, 'x', BLOC_SIZE);
+
+	/* the buffers one after the other, an empty one too */
+	out[0].iov_base = header;
+	out[0].iov_len = 3;
+	out[1].iov_base = body;
+	out[1].iov_len = BLOC_SIZE;
+	out[2].iov_base = NULL;
+	out[2].iov_len = 0;
+	out[3].iov_base = footer;
+	out[3].iov_len = 7;
+
+	f = create_emptyfile(&g_fs, &g_working_directory, "vectored", REGULAR_FILE);
+	if (iwritev(&g_fs, &f, out, 4) != EXIT_SUCCESS || f.inode.size != BLOC_SIZE + 10
+			|| f.inode.bloc_count != 2 || f.current_pos != BLOC_SIZE + 10) {
+		perror("test_vectored_io() failed");
+		return EXIT_FAILURE;
+	}
+
+	f = iopen(&g_fs, &g_working_directory, "vectored", O_RDWR);
+	iread_at(&g_fs, &f, 0, buf, BLOC_SIZE + 10);
+	if (memcmp(buf, header, 3) != 0 || memcmp(buf + 3, body, BLOC_SIZE) != 0
+			|| memcmp(buf + 3 + BLOC_SIZE, footer, 7) != 0) {
+		perror("test_vectored_io() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* split across the buffers the other way, the read stops at the end */
+	in[0].iov_base = first;
+	in[0].iov_len = BLOC_SIZE + 1;
+	in[1].iov_base = second;
+	in[1].iov_len = 20;
+	if (ireadv(&g_fs, &f, in, 2) != EXIT_SUCCESS || f.current_pos != BLOC_SIZE + 10
+			|| memcmp(first, buf, BLOC_SIZE + 1) != 0 || memcmp(second, buf + BLOC_SIZE + 1, 9) != 0) {
+		perror("test_vectored_io() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_vectored_io() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_transaction() {
+	struct fs other;
+	unsigned long commits, logged, writes;
+	unsigned int id;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	/* a mkdir is one commit, its writes are coalesced */
+	commits = g_fs.txn.commits;
+	logged = g_fs.txn.logged;
+	writes = g_fs.txn.writes;
+	create_directory(&g_fs, &g_working_directory, "home");
+	if (g_fs.txn.commits != commits + 1 || g_fs.txn.writes - writes >= g_fs.txn.logged - logged) {
+		perror("test_transaction() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* the writes of an open transaction are seen by its disk only */
+	flush_disk(&g_fs);
+	txn_begin(&g_fs);
+	id = create_regularfile(&g_fs, &g_working_directory, "pending", "content", O_RDWR).inode.id;
+	flush_disk(&g_fs);
+	icache_invalidate(&g_fs.icache);
+	bcache_invalidate(&g_fs.bcache);
+	dcache_invalidate(&g_fs.dcache);
+	if (get_inode_by_filename(&g_fs, &g_working_directory, "pending").id != id
+			|| mount_disk(&other, DISK) != EXIT_SUCCESS
+			|| get_inode_by_filename(&other, &g_working_directory, "pending").id != DELETED) {
+		perror("test_transaction() failed");
+		return EXIT_FAILURE;
+	}
+	unmount_disk(&other);
+
+	txn_commit(&g_fs);
+	flush_disk(&g_fs);
+	if (mount_disk(&other, DISK) != EXIT_SUCCESS
+			|| get_inode_by_filename(&other, &g_working_directory, "pending").id != id) {
+		perror("test_transaction() failed");
+		return EXIT_FAILURE;
+	}
+	unmount_disk(&other);
+
+	printf("test_transaction() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_journal() {
+	struct fs other;
+	FILE *from, *to;
+	char buf[4096];
+	const char *crash = "rsc/disk.crash";
+	struct file f;
+	unsigned long syncs;
+	unsigned int blocs;
+	size_t n;
+	int found;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	flush_disk(&g_fs);
+
+	/* the commits of a group wait in the journal, with no sync */
+	syncs = g_fs.journal.syncs;
+	create_directory(&g_fs, &g_working_directory, "home");
+	create_directory(&g_fs, &g_working_directory, "etc");
+	create_regularfile(&g_fs, &g_working_directory, "motd", "hello", O_RDWR);
+	if (g_fs.journal.syncs != syncs || g_fs.journal.pending != 3) {
+		perror("test_journal() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a crash now: the copy of the disk has them in the journal only */
+	from = fopen(DISK, "rb");
+	to = fopen(crash, "wb");
+	while (from != NULL && to != NULL && (n = fread(buf, 1, sizeof(buf), from)) > 0)
+		fwrite(buf, 1, n, to);
+	if (from != NULL) fclose(from);
+	if (to != NULL) fclose(to);
+
+	found = mount_disk(&other, crash) == EXIT_SUCCESS && other.journal.replayed == 3
+		&& get_inode_by_filename(&other, &g_working_directory, "home").id != DELETED
+		&& get_inode_by_filename(&other, &g_working_directory, "motd").id != DELETED;
+	if (found)
+		unmount_disk(&other);
+	remove(crash);
+	if (!found) {
+		perror("test_journal() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a checkpoint syncs the journal, then the writes in place */
+	flush_disk(&g_fs);
+	if (g_fs.journal.syncs != syncs + 2 || g_fs.journal.pending != 0 || g_fs.txn.count != 0
+			|| mount_disk(&other, DISK) != EXIT_SUCCESS || other.journal.replayed != 0
+			|| get_inode_by_filename(&other, &g_working_directory, "etc").id == DELETED) {
+		perror("test_journal() failed");
+		return EXIT_FAILURE;
+	}
+	unmount_disk(&other);
+
+	/* a write and a truncation are a transaction each */
+	f = iopen(&g_fs, &g_working_directory, "motd", O_RDWR);
+	iwrite_at(&g_fs, &f, 0, "hello again", 11);
+	itruncate(&g_fs, &f, 5);
+	if (g_fs.journal.pending != 2) {
+		perror("test_journal() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* one bigger than the journal is refused, the disk is as the commits before left it */
+	blocs = count_free_slots(&g_fs, BLOC_FLAG);
+	g_fs.sb.journal_size = sizeof(struct journal_header) + 64;
+	create_directory(&g_fs, &g_working_directory, "refused");
+	if (get_inode_by_filename(&g_fs, &g_working_directory, "refused").id != DELETED
+			|| count_free_slots(&g_fs, BLOC_FLAG) != blocs || g_fs.sb.journal_size != DEFAULT_JOURNAL_SIZE
+			|| get_inode_by_filename(&g_fs, &g_working_directory, "motd").size != 5) {
+		perror("test_journal() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_journal() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_durability() {
+	struct file f;
+	unsigned long syncs;
+
+	/* one sync a call, not one a write of the call */
+	setenv(MOUNT_OPTIONS_ENV, "durability=sync", 1);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	unsetenv(MOUNT_OPTIONS_ENV);
+
+	syncs = g_fs.durability.syncs;
+	create_directory(&g_fs, &g_working_directory, "home");
+	f = create_emptyfile(&g_fs, &g_working_directory, "log", REGULAR_FILE);
+	f.flags = O_RDWR;
+	iwrite(&g_fs, &f, "a line\n", 7);
+	if (g_fs.durability.mode != DURABILITY_SYNC || g_fs.durability.syncs != syncs + 3) {
+		perror("test_durability() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a scratch disk never syncs, not even at a checkpoint */
+	setenv(MOUNT_OPTIONS_ENV, "durability=none", 1);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	unsetenv(MOUNT_OPTIONS_ENV);
+
+	create_directory(&g_fs, &g_working_directory, "home");
+	flush_disk(&g_fs);
+	if (g_fs.durability.syncs != 0 || g_fs.journal.syncs != 0
+			|| get_inode_by_filename(&g_fs, &g_working_directory, "home").id == DELETED) {
+		perror("test_durability() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_durability() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_snapshot() {
+	struct fs view;
+	struct file f;
+	struct inode root;
+	char buf[64];
+	unsigned int blocs, blocs_before, inodes;
+	size_t bytes;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	create_directory(&g_fs, &g_working_directory, "home");
+	create_regularfile(&g_fs, &g_working_directory, "notes", "as it was", O_RDONLY);
+	flush_disk(&g_fs);
+	disk_free(&g_fs, &blocs_before, &inodes, &bytes);
+
+	if (snapshot_take(&g_fs, "s1") != EXIT_SUCCESS || snapshot_take(&g_fs, "s1") != EXIT_FAILURE) {
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* the disk goes on, the records of s1 are copied on write */
+	f = iopen(&g_fs, &g_working_directory, "notes", O_RDWR | O_TRUNC);
+	iwrite(&g_fs, &f, "as it is", 8);
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	remove_empty_directory(&g_fs, &g_working_directory, "home");
+	create_regularfile(&g_fs, &g_working_directory, "new", "", O_RDONLY);
+	flush_disk(&g_fs);
+	if (g_fs.snapshots.list[0].exceptions.count == 0) {
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* s1 mounted read-only next to the disk */
+	setenv(MOUNT_OPTIONS_ENV, "snapshot=s1", 1);
+	if (mount_disk(&view, DISK) != EXIT_SUCCESS) {
+		unsetenv(MOUNT_OPTIONS_ENV);
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+	unsetenv(MOUNT_OPTIONS_ENV);
+
+	root = get_inode_by_id(&view, ROOT_ID);
+	f = iopen(&view, &root, "notes", O_RDWR);
+	iread_at(&view, &f, 0, buf, sizeof(buf) - 1);
+	/* a refused write leaves the bitmaps as they were */
+	inodes = count_free_slots(&view, INODE_FLAG);
+	if (strcmp(buf, "as it was") != 0 || get_inode_by_filename(&view, &root, "home").id == DELETED
+			|| get_inode_by_filename(&view, &root, "new").id != DELETED
+			|| create_directory(&view, &root, "nope").id != DELETED
+			|| count_free_slots(&view, INODE_FLAG) != inodes) {
+		unmount_disk(&view);
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+	unmount_disk(&view);
+
+	/* back to s1, which is kept */
+	if (snapshot_rollback(&g_fs, "s1") != EXIT_SUCCESS) {
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	f = iopen(&g_fs, &g_working_directory, "notes", O_RDWR);
+	iread_at(&g_fs, &f, 0, buf, sizeof(buf) - 1);
+	if (strcmp(buf, "as it was") != 0 || get_inode_by_filename(&g_fs, &g_working_directory, "home").id == DELETED
+			|| get_inode_by_filename(&g_fs, &g_working_directory, "new").id != DELETED
+			|| snapshot_find(&g_fs, "s1") == NULL) {
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* dropped, it holds no bloc anymore */
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (snapshot_drop(&g_fs, "s1") != EXIT_SUCCESS || g_fs.snapshots.count != 0 || blocs >= blocs_before) {
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != blocs_before) {
+		perror("test_snapshot() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_snapshot() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_copy_file() {
+	struct file f;
+	struct inode big, dir;
+	char content[3000], buf[3001];
+	unsigned int blocs, blocs_before, inodes, first;
+	size_t bytes;
+	int z;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	for (z = 0; z != (int) sizeof(content); z++)
+		content[z] = 'a' + z % 26;
+	f = create_emptyfile(&g_fs, &g_working_directory, "big", REGULAR_FILE);
+	iwrite(&g_fs, &f, content, sizeof(content));
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+
+	/* the first copy creates the share table, the next ones write no bloc */
+	copy_file(&g_fs, &g_working_directory, "big", "copy");
+	disk_free(&g_fs, &blocs_before, &inodes, &bytes);
+	if (copy_file(&g_fs, &g_working_directory, "big", "copy2") != EXIT_SUCCESS
+			|| copy_file(&g_fs, &g_working_directory, "big", "copy") != EXIT_FAILURE) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	big = get_inode_by_filename(&g_fs, &g_working_directory, "big");
+	if (blocs != blocs_before || share_get(&g_fs, bmap(&g_fs, &big, 0)) != 2) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a write to the copy copies the bloc written only */
+	f = iopen(&g_fs, &g_working_directory, "copy", O_RDWR);
+	iwrite_at(&g_fs, &f, 600, "XYZ", 3);
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	f = iopen(&g_fs, &g_working_directory, "copy", O_RDWR);
+	iread_at(&g_fs, &f, 0, buf, sizeof(content));
+	if (blocs != blocs_before - 1 || memcmp(buf + 600, "XYZ", 3) != 0 || memcmp(buf, content, 600) != 0
+			|| share_get(&g_fs, bmap(&g_fs, &big, 1)) != 1 || share_get(&g_fs, bmap(&g_fs, &big, 2)) != 2) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* the blocs go with their last file */
+	remove_file(&g_fs, &g_working_directory, "big", REGULAR_FILE);
+	f = iopen(&g_fs, &g_working_directory, "copy2", O_RDWR);
+	iread_at(&g_fs, &f, 0, buf, sizeof(content));
+	if (memcmp(buf, content, sizeof(content)) != 0) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+	remove_file(&g_fs, &g_working_directory, "copy", REGULAR_FILE);
+	remove_file(&g_fs, &g_working_directory, "copy2", REGULAR_FILE);
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (blocs != blocs_before + 6) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a directory is copied with its files, into a directory */
+	dir = create_directory(&g_fs, &g_working_directory, "d");
+	create_regularfile(&g_fs, &dir, "f", "in d", O_RDONLY);
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	create_directory(&g_fs, &g_working_directory, "e");
+	if (copy_file(&g_fs, &g_working_directory, "d", "e") != EXIT_SUCCESS) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+	dir = get_inode_by_filename(&g_fs, &g_working_directory, "e");
+	dir = get_inode_by_filename(&g_fs, &dir, "d");
+	f = iopen(&g_fs, &dir, "f", O_RDWR);
+	iread_at(&g_fs, &f, 0, buf, 16);
+	if (dir.type != DIRECTORY || strcmp(buf, "in d") != 0) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a count out of range in a later bloc of the table changes no count */
+	first = 10 * SHARES_PER_BLOC;
+	share_add(&g_fs, first, 2, 1);
+	if (share_add(&g_fs, first, 3, -1) == EXIT_SUCCESS
+			|| share_get(&g_fs, first) != 1 || share_get(&g_fs, first + 1) != 1) {
+		perror("test_copy_file() failed");
+		return EXIT_FAILURE;
+	}
+	share_add(&g_fs, first, 2, -1);
+
+	printf("test_copy_file() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_defrag() {
+	struct defrag_stats before, after;
+	struct file a, b;
+	struct inode dir;
+	char content[1200], buf[2 * sizeof(content) + 1];
+	unsigned int pwd;
+	int z;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	for (z = 0; z != (int) sizeof(content); z++)
+		content[z] = 'a' + z % 26;
+
+	/* two files growing by turns: their blocs interleave */
+	a = create_emptyfile(&g_fs, &g_working_directory, "a", REGULAR_FILE);
+	b = create_emptyfile(&g_fs, &g_working_directory, "b", REGULAR_FILE);
+	for (z = 0; z != 2; z++) {
+		iwrite(&g_fs, &a, content, sizeof(content));
+		iwrite(&g_fs, &b, content, sizeof(content));
+	}
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	dir = create_directory(&g_fs, &g_working_directory, "home");
+	create_regularfile(&g_fs, &dir, "notes", "in home", O_RDONLY);
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	copy_file(&g_fs, &g_working_directory, "a", "c");
+
+	/* the slots of a file removed stay below the highs */
+	a = create_emptyfile(&g_fs, &g_working_directory, "gone", REGULAR_FILE);
+	iwrite(&g_fs, &a, content, sizeof(content));
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	remove_file(&g_fs, &g_working_directory, "gone", REGULAR_FILE);
+	flush_disk(&g_fs);
+
+	pwd = dir.id;
+	if (defrag_disk(DISK, &pwd, &before, &after, NULL) != EXIT_SUCCESS || refresh_disk(&g_fs) != EXIT_SUCCESS) {
+		perror("test_defrag() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* the same tree, one run a file */
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	dir = get_inode_by_id(&g_fs, pwd);
+	a = iopen(&g_fs, &g_working_directory, "c", O_RDWR);
+	iread_at(&g_fs, &a, 0, buf, sizeof(buf) - 1);
+	if (after.extents >= before.extents || after.bloc_high >= before.bloc_high || after.size >= before.size
+			|| after.blocs > before.blocs
+			|| after.inodes != before.inodes || memcmp(buf, content, sizeof(content)) != 0
+			|| memcmp(buf + sizeof(content), content, sizeof(content)) != 0
+			|| get_inode_by_filename(&g_fs, &dir, "notes").id == DELETED
+			|| share_get(&g_fs, bmap(&g_fs, &a.inode, 0)) != 1) {
+		perror("test_defrag() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_defrag() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_compact() {
+	struct file a, b;
+	struct stat before, after;
+	char content[3001], buf[sizeof(content)];
+	unsigned int high, first;
+	int z;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	for (z = 0; z != (int) sizeof(content) - 1; z++)
+		content[z] = 'a' + z % 26;
+	content[z] = '\0';
+
+	/* the blocs of the file removed leave a hole below the other one */
+	a = create_regularfile(&g_fs, &g_working_directory, "a", content, O_RDWR);
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	b = create_regularfile(&g_fs, &g_working_directory, "b", content, O_RDWR);
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	remove_file(&g_fs, &g_working_directory, "a", REGULAR_FILE);
+	flush_disk(&g_fs);
+	high = g_fs.sb.bloc_high;
+	first = bmap(&g_fs, &b.inode, 0);
+	fstat(g_fs.fd, &before);
+
+	/* a tick moves "compact=N" blocs at most */
+	for (z = 0; z != 1000 && compact_tick(&g_fs); z++);
+	flush_disk(&g_fs);
+	fstat(g_fs.fd, &after);
+
+	g_working_directory = get_inode_by_id(&g_fs, ROOT_ID);
+	b = iopen(&g_fs, &g_working_directory, "b", O_RDWR);
+	memset(buf, 0, sizeof(buf));
+	iread_at(&g_fs, &b, 0, buf, sizeof(content) - 1);
+	if (z == 1000 || g_fs.compact.moved == 0 || g_fs.sb.bloc_high >= high || bmap(&g_fs, &b.inode, 0) >= first
+			|| after.st_size >= before.st_size || memcmp(buf, content, sizeof(content)) != 0
+			|| compact_tick(&g_fs) != 0) {
+		perror("test_compact() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_compact() successful\n");
+	return EXIT_SUCCESS;
+}
+
+static unsigned int g_scrubbed;
+
+static void scrub_found(unsigned int id) {
+	g_scrubbed = id;
+}
+
+int test_checksum() {
+	struct scrub_stats stats;
+	struct file f;
+	struct bloc b;
+	char data[1000];
+	unsigned int id;
+	unsigned long errors;
+	int z;
+
+	/* the kernels agree, on the check value of CRC32C too */
+	for (z = 0; z != (int) sizeof(data); z++)
+		data[z] = (char) (z * 131 + 7);
+	for (z = 0; z < (int) sizeof(data) - 8; z += 61) {
+		if (crc32c_slicing(0, data + z % 8, z) != crc32c_bytewise(0, data + z % 8, z)
+				|| crc32c_hw(0, data + z % 8, z) != crc32c_bytewise(0, data + z % 8, z)) {
+			perror("test_checksum() failed");
+			return EXIT_FAILURE;
+		}
+	}
+	if (crc32c(0, "123456789", 9) != 0xe3069283) {
+		perror("test_checksum() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* every bloc read is checked, with SSE4.2 or not */
+	setenv(MOUNT_OPTIONS_ENV, "verify=1", 1);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	unsetenv(MOUNT_OPTIONS_ENV);
+	f = create_regularfile(&g_fs, &g_working_directory, "sealed", "checked as it's read", O_RDWR);
+	flush_disk(&g_fs);
+	id = bmap(&g_fs, &f.inode, 0);
+
+	/* a sound disk */
+	if (scrub_disk(&g_fs, 4, &stats, scrub_found) != EXIT_SUCCESS || stats.corrupted != 0
+			|| stats.unsealed != 0 || stats.checked != DEFAULT_BLOC_COUNT - count_free_slots(&g_fs, BLOC_FLAG)) {
+		perror("test_checksum() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* a byte of the content flips on the device */
+	b = get_bloc_by_id(&g_fs, id);
+	b.content[3] ^= 0x20;
+	pwrite(g_fs.fd, &b, sizeof(struct bloc), bloc_offset(&g_fs.sb, id - 1));
+	refresh_disk(&g_fs);
+
+	errors = g_fs.checksums.errors;
+	if (get_bloc_by_id(&g_fs, id).id != DELETED || g_fs.checksums.errors != errors + 1
+			|| scrub_disk(&g_fs, 0, &stats, scrub_found) != EXIT_SUCCESS || stats.corrupted != 1
+			|| g_scrubbed != id) {
+		perror("test_checksum() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_checksum() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_refresh_disk() {
+	struct fs other;
+	struct bloc b;
+	unsigned int blocs, inodes;
+	size_t bytes;
+
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	get_bloc_by_id(&g_fs, bmap(&g_fs, &g_working_directory, 0));
+
+	/* another process (a command) writes the same disk */
+	if (mount_disk(&other, DISK) != EXIT_SUCCESS) {
+		perror("test_refresh_disk() failed");
+		return EXIT_FAILURE;
+	}
+	b = new_bloc("from another mount");
+	write_bloc(&other, &b);
+	unmount_disk(&other);
+
+	refresh_disk(&g_fs);
+	disk_free(&g_fs, &blocs, &inodes, &bytes);
+	if (get_bloc_by_id(&g_fs, b.id).id != b.id || blocs != DEFAULT_BLOC_COUNT - 2) {
+		perror("test_refresh_disk() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_refresh_disk() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_mmap_disk() {
+	struct fs other;
+	struct bloc b;
+	const struct bloc *ref;
+	unsigned int first, last;
+	int z;
+
+	setenv(MOUNT_OPTIONS_ENV, "mmap", 1);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+
+	/* enough blocs to grow the mapping past a MAP_GROW step */
+	for (z = 0; z != 2500; z++) {
+		b = new_bloc("");
+		sprintf(b.content, "mapped %d", z);
+		write_bloc(&g_fs, &b);
+		if (z == 0) first = b.id;
+	}
+	last = b.id;
+
+	ref = bloc_ref(&g_fs, first, &b);
+	if (g_fs.map == NULL || (const char *) ref < g_fs.map || (const char *) ref >= g_fs.map + g_fs.map_size
+			|| strcmp(ref->content, "mapped 0") != 0) {
+		perror("test_mmap_disk() failed");
+		unsetenv(MOUNT_OPTIONS_ENV);
+		return EXIT_FAILURE;
+	}
+
+	/* a bloc no pending record covers is still read in place */
+	create_directory(&g_fs, &g_working_directory, "pending");
+	bcache_flush(&g_fs);
+	bcache_invalidate(&g_fs.bcache);
+	ref = bloc_ref(&g_fs, first, &b);
+	if (g_fs.txn.count == 0 || (const char *) ref < g_fs.map || (const char *) ref >= g_fs.map + g_fs.map_size
+			|| strcmp(ref->content, "mapped 0") != 0) {
+		perror("test_mmap_disk() failed");
+		unsetenv(MOUNT_OPTIONS_ENV);
+		return EXIT_FAILURE;
+	}
+	disk_sync(&g_fs);
+	unsetenv(MOUNT_OPTIONS_ENV);
+
+	/* the writes are seen by a mount without the mapping */
+	mount_disk(&other, DISK);
+	ref = bloc_ref(&other, last, &b);
+	if (other.map != NULL || ref == NULL || strcmp(ref->content, "mapped 2499") != 0) {
+		perror("test_mmap_disk() failed");
+		unmount_disk(&other);
+		return EXIT_FAILURE;
+	}
+	unmount_disk(&other);
+
+	printf("test_mmap_disk() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_bcache() {
+	struct fs other;
+	struct bloc b;
+	struct bloc blocs[10];
+	unsigned long misses;
+	int z;
+
+	setenv(MOUNT_OPTIONS_ENV, "cache=4", 1);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	unsetenv(MOUNT_OPTIONS_ENV);
+
+	for (z = 0; z != 10; z++) {
+		blocs[z] = new_bloc("");
+		sprintf(blocs[z].content, "bloc %d", z);
+		write_bloc(&g_fs, &blocs[z]);
+	}
+
+	/* the last blocs written are cached */
+	misses = g_fs.bcache.misses;
+	get_bloc_by_id(&g_fs, blocs[9].id);
+	get_bloc_by_id(&g_fs, blocs[9].id);
+	if (g_fs.bcache.size != 4 || g_fs.bcache.misses != misses) {
+		perror("test_bcache() failed");
+		return EXIT_FAILURE;
+	}
+
+	/* an update stays in the cache until it's flushed or evicted */
+	strcpy(blocs[9].content, "dirty");
+	update_bloc(&g_fs, &blocs[9]);
+	mount_disk(&other, DISK);
+	b = get_bloc_by_id(&other, blocs[9].id);
+	if (strcmp(b.content, "bloc 9") != 0) {
+		perror("test_bcache() failed");
+		unmount_disk(&other);
+		return EXIT_FAILURE;
+	}
+
+	for (z = 0; z != 9; z++)
+		get_bloc_by_id(&g_fs, blocs[z].id);
+
+	refresh_disk(&other);
+	b = get_bloc_by_id(&other, blocs[9].id);
+	unmount_disk(&other);
+	if (strcmp(b.content, "dirty") != 0 || strcmp(get_bloc_by_id(&g_fs, blocs[9].id).content, "dirty") != 0) {
+		perror("test_bcache() failed");
+		return EXIT_FAILURE;
+	}
+
+	printf("test_bcache() successful\n");
+	return EXIT_SUCCESS;
+}
+
+int test_icache() {
+	struct fs other;
+	struct inode *root, *again;
+	struct file f;
+	char name[FILENAME_COUNT];
+	int z;
+
+	setenv(MOUNT_OPTIONS_ENV, "icache=2", 1);
+	clean_disk(&g_fs);
+	g_working_directory = create_disk(&g_fs);
+	unsetenv(MOUNT_OPTIONS_ENV);
+
+	root = iget(&g_fs, ROOT_ID);
+	for (z = 0; z != 5; z++) {
+		sprintf(name, "file%d", z);
+		f = create_emptyfile(&g_fs, &g_working_directory, name, REGULAR_FILE);
+		get_inode_by_id(&g_fs, f.inode.id);
+	}
+
+	/* a pinned inode is never evicted, the handles are shared */
+	again = iget(&g_fs, ROOT_ID);
+	if (root == NULL || again != root || root->id != ROOT_ID) {
+		perror("test_icache() failed");
+		return EXIT_FAILURE;
+	}
+	iput(&g_fs, again);
+
+	root->permissions = S_IRWXU;
+	idirty(&g_fs, root);
+	iput(&g_fs, root);
+	flush_disk(&g_fs);
+
+	mount_disk(&other, DISK);
+	if (get_inode_by_id(&other, ROOT_ID).permissions != S_IRWXU
+			|| get_inode_by_id(&g_fs, ROOT_ID).permissions != S_IRWXU) {
+		perror("test_icache() failed");
+		unmount_disk(&other);
+		return EXIT_FAILURE;
+	}
+	unmount_disk(&other);
+
+	printf("test_icache() successful\n");
+	return EXIT_SUCCESS;
+}
+
 int main() {
 
-	init_id_generator();
 	strcpy(g_username, "Paul");
 
+	test_convert_disk();
 	test_new_inode();
 	test_print_inode();
 	test_write_inode();
@@ -652,6 +2075,31 @@ int main() {
 	test_move_file();
 	test_mode();
 	test_remove_empty_directory();
+	test_idmap();
+	test_disk_index();
+	test_slot_reuse();
+	test_sequential_ids();
+	test_extents();
+	test_hashed_directory();
+	test_dirents();
+	test_dcache();
+	test_resolve_path();
+	test_binary_content();
+	test_iread_at();
+	test_incremental_write();
+	test_vectored_io();
+	test_transaction();
+	test_journal();
+	test_durability();
+	test_snapshot();
+	test_copy_file();
+	test_defrag();
+	test_compact();
+	test_checksum();
+	test_refresh_disk();
+	test_mmap_disk();
+	test_bcache();
+	test_icache();
 
 	return EXIT_SUCCESS;
 }
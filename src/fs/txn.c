@@ -0,0 +1,307 @@
+#include "./txn.h"
+#include "./fs.h"
+
+/**
+ * Opens a transaction on a mounted disk, or nests in the open one
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (not mounted)
+ */
+int txn_begin(struct fs *fs) {
+	if (!fs->mounted) return EXIT_FAILURE;
+
+	fs->txn.depth++;
+	durable_begin(fs);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+ * Counts a record in the pages it covers
+ */
+static void count_pages(struct txn *t, const struct txn_record *r) {
+	long page, last;
+
+	last = (r->offset + (long) r->size - 1) / TXN_PAGE;
+	for (page = r->offset / TXN_PAGE; page <= last && page - r->offset / TXN_PAGE < TXN_PAGES; page++)
+		t->pages[page % TXN_PAGES]++;
+}
+
+/*
+ * Counts the records left in the pages again, once some are forgotten
+ */
+static void recount_pages(struct txn *t) {
+	size_t z;
+
+	memset(t->pages, 0, sizeof(t->pages));
+	for (z = 0; z != t->count; z++)
+		count_pages(t, &t->records[z]);
+}
+
+/*
+ * Checks if a record may have some of size bytes at offset: one is
+ * counted in a page of them
+ */
+static int may_overlap(struct txn *t, long offset, size_t size) {
+	long page, last;
+
+	if (t->count == 0 || size == 0) return 0;
+
+	last = (offset + (long) size - 1) / TXN_PAGE;
+	for (page = offset / TXN_PAGE; page <= last && page - offset / TXN_PAGE < TXN_PAGES; page++) {
+		if (t->pages[page % TXN_PAGES] != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Logs a write, it replaces a write of the same bytes not committed yet
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (out of memory)
+ */
+int txn_log(struct txn *t, long offset, const void *buf, size_t size) {
+	struct txn_record *r;
+	size_t z;
+
+	t->logged++;
+
+	for (z = 0; z != t->count; z++) {
+		r = &t->records[z];
+		if (!r->committed && r->offset == offset && r->size == size) {
+			memcpy(r->data, buf, size);
+			return EXIT_SUCCESS;
+		}
+	}
+
+	if (t->count == t->capacity) {
+		r = (struct txn_record *) realloc(t->records, (t->capacity * 2 + 8) * sizeof(struct txn_record));
+		if (r == NULL) return EXIT_FAILURE;
+
+		t->records = r;
+		t->capacity = t->capacity * 2 + 8;
+	}
+
+	r = &t->records[t->count];
+	r->data = (char *) malloc(size);
+	if (r->data == NULL) return EXIT_FAILURE;
+
+	memcpy(r->data, buf, size);
+	r->offset = offset;
+	r->size = size;
+	r->committed = 0;
+	t->count++;
+	count_pages(t, r);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Checks if a pending record has some of size bytes at offset
+ *
+ * on success : returns 1
+ * on failure : returns 0
+ */
+int txn_overlaps(struct txn *t, long offset, size_t size) {
+	size_t z;
+	int found;
+
+	if (!may_overlap(t, offset, size)) return 0;
+
+	found = 0;
+	for (z = 0; !found && z != t->count; z++) {
+		found = t->records[z].offset < offset + (long) size
+			&& offset < t->records[z].offset + (long) t->records[z].size;
+	}
+
+	return found;
+}
+
+/*
+ * Copies the records (the committed ones only, or all of them) over size
+ * bytes at offset, the last logged wins
+ */
+static void overlay(struct txn *t, long offset, void *buf, size_t size, int committed_only) {
+	const struct txn_record *r;
+	long from, to;
+	size_t z;
+
+	for (z = 0; z != t->count; z++) {
+		r = &t->records[z];
+		if (committed_only && !r->committed) continue;
+
+		from = r->offset > offset ? r->offset : offset;
+		to = r->offset + (long) r->size < offset + (long) size ? r->offset + (long) r->size : offset + (long) size;
+
+		if (from < to)
+			memcpy((char *) buf + (from - offset), r->data + (from - r->offset), to - from);
+	}
+}
+
+/*
+ * Copies the pending records over size bytes read at offset
+ */
+void txn_overlay(struct txn *t, long offset, void *buf, size_t size) {
+	if (may_overlap(t, offset, size))
+		overlay(t, offset, buf, size, 0);
+}
+
+/*
+ * Orders the records by offset
+ */
+static int by_offset(const void *a, const void *b) {
+	const struct txn_record *ra, *rb;
+
+	ra = *(const struct txn_record * const *) a;
+	rb = *(const struct txn_record * const *) b;
+
+	return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+/**
+ * Writes the records (the committed ones only, or all of them) in place
+ * by offset and forgets them, a run of records that touch or overlap is
+ * one write
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (out of memory, write error)
+ */
+int txn_apply(struct fs *fs, int committed_only) {
+	struct txn *t;
+	struct txn_record **sorted;
+	char *span;
+	long from, to;
+	size_t z, k, count;
+	int rst;
+
+	t = &fs->txn;
+	if (t->count == 0) return EXIT_SUCCESS;
+
+	sorted = (struct txn_record **) malloc(t->count * sizeof(struct txn_record *));
+	if (sorted == NULL) return EXIT_FAILURE;
+
+	count = 0;
+	for (z = 0; z != t->count; z++) {
+		if (!committed_only || t->records[z].committed)
+			sorted[count++] = &t->records[z];
+	}
+	qsort(sorted, count, sizeof(struct txn_record *), by_offset);
+
+	rst = EXIT_SUCCESS;
+	for (z = 0; rst == EXIT_SUCCESS && z != count; z = k) {
+		from = sorted[z]->offset;
+		to = from + (long) sorted[z]->size;
+		for (k = z + 1; k != count && sorted[k]->offset <= to; k++) {
+			if (sorted[k]->offset + (long) sorted[k]->size > to)
+				to = sorted[k]->offset + (long) sorted[k]->size;
+		}
+
+		span = (char *) malloc(to - from);
+		if (span == NULL) {
+			rst = EXIT_FAILURE;
+		} else {
+			overlay(t, from, span, to - from, committed_only);
+			rst = disk_write_through(fs, from, span, to - from);
+			t->writes++;
+		}
+		free(span);
+	}
+
+	free(sorted);
+	if (rst != EXIT_SUCCESS) return EXIT_FAILURE;
+
+	/* the records left keep their order */
+	count = 0;
+	for (z = 0; z != t->count; z++) {
+		if (!committed_only || t->records[z].committed)
+			free(t->records[z].data);
+		else
+			t->records[count++] = t->records[z];
+	}
+	t->count = count;
+	recount_pages(t);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Closes the open transaction. The outermost one writes the dirty cached
+ * inodes and blocs and the dirty superblock back and commits every logged
+ * write (see journal_commit).
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no open transaction, write error)
+ */
+int txn_commit(struct fs *fs) {
+	int rst;
+
+	if (fs->txn.depth == 0) return EXIT_FAILURE;
+	if (fs->txn.depth > 1) {
+		fs->txn.depth--;
+		return durable_end(fs, EXIT_SUCCESS);
+	}
+
+	/* the write backs are logged with the rest */
+	rst = icache_flush(fs);
+	if (bcache_flush(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+	if (fs->sb_dirty && write_superblock(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+
+	fs->txn.depth = 0;
+	if (journal_commit(fs) != EXIT_SUCCESS)
+		rst = EXIT_FAILURE;
+	fs->txn.commits++;
+
+	/* the journal is durable once it's synced (see durable_end) */
+	return durable_end(fs, rst);
+}
+
+/**
+ * Closes the outermost transaction without committing it, its writes are
+ * dropped: the disk stays as the commits before left it
+ * What the caller changed in memory is to load again (see refresh_disk).
+ *
+ * on success : returns EXIT_SUCCESS
+ * on failure : returns EXIT_FAILURE (no open transaction, a nested one)
+ */
+int txn_abort(struct fs *fs) {
+	if (fs->txn.depth != 1) return EXIT_FAILURE;
+
+	fs->txn.depth = 0;
+	txn_discard(&fs->txn);
+
+	return durable_end(fs, EXIT_SUCCESS);
+}
+
+/*
+ * Drops the records not committed, of a transaction the journal refused
+ * (see journal_commit) or aborted
+ */
+void txn_discard(struct txn *t) {
+	size_t z, kept;
+
+	kept = 0;
+	for (z = 0; z != t->count; z++) {
+		if (t->records[z].committed)
+			t->records[kept++] = t->records[z];
+		else
+			free(t->records[z].data);
+	}
+	t->count = kept;
+	recount_pages(t);
+}
+
+/*
+ * Releases the records of a transaction
+ */
+void txn_free(struct txn *t) {
+	size_t z;
+
+	for (z = 0; z != t->count; z++)
+		free(t->records[z].data);
+	free(t->records);
+	memset(t, 0, sizeof(struct txn));
+}
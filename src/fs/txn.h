@@ -0,0 +1,61 @@
+#ifndef TXN_H
+#define TXN_H
+
+#include <stdlib.h>
+#include <string.h>
+
+/* the records are counted by page of the disk, hashed in TXN_PAGES counters */
+#define TXN_PAGE (512)
+#define TXN_PAGES (1024)
+
+/*
+ * A write of a transaction: size bytes of data to write at offset
+ * committed once it's in the journal (see journal_commit)
+ */
+struct txn_record {
+	long offset;
+	size_t size;
+	char *data;
+	int committed;
+};
+
+/*
+ * The writes of the metadata operations on a mounted disk not applied in
+ * place yet
+ *
+ * While a transaction is open (txn_begin), disk_write logs the writes here
+ * instead of doing them, disk_read sees them. txn_commit writes the dirty
+ * cached inodes and blocs back and puts the transaction in the journal,
+ * its records stay here until a checkpoint applies them to the disk in
+ * one pass by offset: the records that touch are one write (see
+ * txn_apply). A write outside a transaction over a pending record is
+ * logged too, so it lands after it.
+ * pages counts the records over each page (by hash): a read or a mapping
+ * of pages no record covers skips the records.
+ * Transactions nest, the outermost commit commits the writes of all.
+ */
+struct txn {
+	int depth;
+	struct txn_record *records;
+	size_t count;
+	size_t capacity;
+	unsigned int pages[TXN_PAGES];
+
+	unsigned long commits;
+	unsigned long logged;
+	unsigned long writes;
+};
+
+struct fs;
+
+int txn_abort(struct fs *fs);
+int txn_apply(struct fs *fs, int committed_only);
+int txn_begin(struct fs *fs);
+int txn_commit(struct fs *fs);
+int txn_log(struct txn *t, long offset, const void *buf, size_t size);
+int txn_overlaps(struct txn *t, long offset, size_t size);
+void txn_discard(struct txn *t);
+void txn_free(struct txn *t);
+void txn_overlay(struct txn *t, long offset, void *buf, size_t size);
+
+#endif
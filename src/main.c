@@ -29,28 +29,57 @@ int main(int argc, char const *argv[]) {
 
 	//--------
 
+	struct fs fs;
 	struct stat buffer;
-	if (stat (DISK, &buffer) == 0)
-		g_working_directory = get_inode_by_id(ROOT_ID);
+	char snapshot[SNAPSHOT_NAME_MAX + 1];
+
+	handleArgs(argc, argv);
+
+	/* the idle shell polls stdin (see prompt): no line may wait in a buffer */
+	setvbuf(stdin, NULL, _IONBF, 0);
+
+	if (disk_version(DISK) == 1) {
+		printf("Upgrading %s to the v%d format\n", DISK, DISK_VERSION);
+		if (convert_disk(DISK) != EXIT_SUCCESS)
+			fprintf(stderr, "Failed to upgrade %s\n", DISK);
+	}
+
+	/* the disk stays mounted for the whole session */
+	if (stat (DISK, &buffer) == 0) {
+		/* a disk that exists is never formatted, even if it doesn't mount */
+		if (mount_disk(&fs, DISK) != EXIT_SUCCESS) {
+			if (mount_option_text("snapshot", snapshot, sizeof(snapshot)))
+				fprintf(stderr, "Can't mount the snapshot %s of %s\n", snapshot, DISK);
+			else
+				fprintf(stderr, "Can't mount %s, it is left as it is\n", DISK);
+			return -1;
+		}
+		g_working_directory = get_inode_by_id(&fs, ROOT_ID);
+	}
+	else if (mount_option_text("snapshot", snapshot, sizeof(snapshot))) {
+		/* never format a disk over a snapshot asked for */
+		fprintf(stderr, "Can't mount the snapshot %s of %s\n", snapshot, DISK);
+		return -1;
+	}
 	else
-		g_working_directory = create_disk();
+		g_working_directory = create_disk(&fs);
 	ch_dir(ROOT_ID);
 
 	if(DEBUG)
-		printf("FS created : root @ %s", get_dirname(&g_working_directory));
+		printf("FS created : root @ %s", get_dirname(&fs, &g_working_directory));
 	//---------
 
-	handleArgs(argc, argv);
-
 	char ** sd_argv = 0;
 	int sd_argc = 0;
 
 	int cmd_status = 0;
 
 	clear();
+	if (fs.journal.replayed > 0)
+		printf("Replayed %lu transactions from the journal\n", fs.journal.replayed);
 
 	do {
-		sd_argv = prompt(&sd_argc, cmd_status, &g_working_directory);
+		sd_argv = prompt(&fs, &sd_argc, cmd_status, &g_working_directory);
 
 		if (DEBUG) {
 			printf("[SD LOG] %s : %d parameters\n", sd_argv[0], sd_argc -1);
@@ -59,6 +88,10 @@ int main(int argc, char const *argv[]) {
 			}
 		}
 
+		/* the command reads the disk from its own process */
+		flush_disk(&fs);
+		durable_tick(&fs);
+
 		if (sd_argc > 0)
 			cmd_status = execute(sd_argc, sd_argv);
 
@@ -67,11 +100,15 @@ int main(int argc, char const *argv[]) {
 		}
 		free(sd_argv);
 
-		g_working_directory = get_inode_by_id(get_pwd_id());
+		/* the command wrote the disk from its own process */
+		refresh_disk(&fs);
+		g_working_directory = get_inode_by_id(&fs, get_pwd_id());
 		if (DEBUG)
 			printf("[SD] current directory @%u (%s)\n", g_working_directory.id, getenv("SYSD_CURDIR"));
 	} while ( cmd_status != 154 );
 
+	unmount_disk(&fs);
+
 	return 0;
 }
 
@@ -83,6 +120,8 @@ int main(int argc, char const *argv[]) {
  * Appelée au lancement du programme par la fonction main
  * options :
  * 	> --debug
+ * 	> --mmap : maps the disk in memory (for the commands too)
+ * 	> --snapshot NAME : mounts the snapshot NAME read-only (see `snapshot`)
  *
  * @param argc int : nombre de paramètres du programme
  * @param argv char*[]: tableau des paramètres
@@ -99,6 +138,15 @@ void handleArgs(int argc, char const *options[]) {
 				DEBUG = 1;
 				printf("DEBUG LOG ENABLED (%d)\n", DEBUG);
 			}
+
+			if ( strcmp(options[i], "--mmap") == 0 )
+				add_mount_option("mmap");
+
+			if ( strcmp(options[i], "--snapshot") == 0 && i + 1 < argc ) {
+				char option[SNAPSHOT_NAME_MAX + sizeof("snapshot=")];
+				snprintf(option, sizeof(option), "snapshot=%s", options[++i]);
+				add_mount_option(option);
+			}
 		}
 	}
 	return;
@@ -1,12 +1,29 @@
 #include "shell.h"
 #include <errno.h>
+#include <poll.h>
 
-char ** prompt( int * argc, int cmd_status, struct inode * pwd ) {
+/*
+ * Compacts the disk a tick at a time until a key is pressed (see
+ * compact_tick), the key waits for one tick at most
+ */
+static void idle(struct fs * fs) {
+	struct pollfd in;
+
+	in.fd = STDIN_FILENO;
+	in.events = POLLIN;
+	fflush(stdout);
+
+	while (poll(&in, 1, COMPACT_IDLE_MS) == 0 && compact_tick(fs));
+}
+
+char ** prompt( struct fs * fs, int * argc, int cmd_status, struct inode * pwd ) {
 	char * input = 0;
 	char ** argv = 0;
 	char *filename;
 
-	filename = get_dirname(pwd);
+	filename = inode_path(fs, pwd);
+	if (filename == NULL)
+		filename = get_dirname(fs, pwd);
 
 	if(cmd_status == 0 ) {
 		printf("\033[1;35m┌─[\033[1;36muser\033[0;35m@\033[1;36mSYSTEMD\033[1;35m]─[%s]\n└──╼ \033[0;35m$\033[0m ", filename);
@@ -15,6 +32,7 @@ char ** prompt( int * argc, int cmd_status, struct inode * pwd ) {
 		printf("\033[1;35m┌─[✗]─[\033[1;36muser\033[0;35m@\033[1;36mSYSTEMD\033[1;35m]─[%s]\n└──╼ \033[0;35m$\033[0m ",  filename);
 	}
 
+	idle(fs);
 	input = readInput();
 	argv = parseInput(input, argc);
 
@@ -15,4 +15,4 @@
 char* readInput();
 char ** parseInput( char * line, int * argc );
 void clear();
-char ** prompt( int * argc, int cmd_status, struct inode * pwd );
\ No newline at end of file
+char ** prompt( struct fs * fs, int * argc, int cmd_status, struct inode * pwd );
\ No newline at end of file
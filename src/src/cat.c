@@ -14,6 +14,9 @@ char ** handleArgs(int argc, char const *argv[]) {
 }
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	initFS();
 
@@ -21,23 +24,34 @@ int main(int argc, char const *argv[]) {
 	arg = handleArgs(argc, argv);
 
 	struct file f;
-	struct inode cur_dir = get_inode_by_id(get_pwd_id());
+	struct inode cur_dir = get_inode_by_id(&fs, get_pwd_id());
+
+	char name[FILENAME_COUNT];
+	struct inode dir = resolve_parent(&fs, &cur_dir, arg[0], name);
+
+	if (dir.id == DELETED) {
+		printf("cat : %s : no such file\n", arg[0]);
+		unmount_disk(&fs);
+		return -1;
+	}
 
-	f = iopen(&cur_dir, arg[0], O_RDWR);
+	f = iopen(&fs, &dir, name, O_RDWR);
 
 	if (f.inode.type != DIRECTORY){
 		char * buf;
-		buf = malloc(sizeof(char) * (get_total_strlen(&f.inode) + 1));
+		buf = malloc(sizeof(char) * (get_total_strlen(&fs, &f.inode) + 1));
 
-		iread(&f, buf, get_total_strlen(&f.inode));
+		iread(&fs, &f, buf, get_total_strlen(&fs, &f.inode));
 		printf("%s\n", buf);
 	}
 	else{
 		printf("cat : %s is not a file", arg[0]);
+		unmount_disk(&fs);
 		return -1;
 	}
 	
 	
 
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
@@ -15,6 +15,9 @@ char ** handleArgs(int argc, char const *argv[]) {
 }
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	char ** arg = NULL;
 	arg = handleArgs(argc, argv);
@@ -23,13 +26,14 @@ int main(int argc, char const *argv[]) {
 		update_path(ROOT_ID);
 
 	else {
-		struct inode cur_dir = get_inode_by_id(get_pwd_id());
-		struct inode target = get_inode_by_filename(&cur_dir, arg[0]);
+		struct inode cur_dir = get_inode_by_id(&fs, get_pwd_id());
+		struct inode target = resolve_path(&fs, &cur_dir, arg[0]);
 		if (target.type == DIRECTORY || target.type == SYMBOLIC_LINK)
 			update_path(target.id);
 		else
 			printf("cd : %s is not a directory\n", arg[0]);
 	}
 
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
@@ -4,7 +4,10 @@
 
 int main(int argc, char const *argv[]) {
 
-	clean_disk();
+	struct fs fs;
+
+	fs.mounted = 0;
+	clean_disk(&fs);
 	
 	return 666;
 }
\ No newline at end of file
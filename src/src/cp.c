@@ -14,14 +14,19 @@ char ** handleArgs(int argc, char const *argv[]) {
 }
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
+
 	initFS();
 
 	char ** arg = NULL;
 	arg = handleArgs(argc, argv);
 
-	struct inode cur_dir = get_inode_by_id(get_pwd_id());
+	struct inode cur_dir = get_inode_by_id(&fs, get_pwd_id());
 
-	copy_file(&cur_dir, arg[0], arg[1]);
+	copy_file(&fs, &cur_dir, arg[0], arg[1]);
 
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../fs/fs.h"
+
+static void progress(unsigned int done, unsigned int total) {
+	if (done == total || done % 16 == 0) {
+		printf("\r	%u/%u files rewritten (%u%%)", done, total, done * 100 / total);
+		fflush(stdout);
+	}
+}
+
+static void print_stats(const char *name, size_t before, size_t after) {
+	printf("%-16s %12lu %12lu\n", name, (unsigned long) before, (unsigned long) after);
+}
+
+int main(int argc, char const *argv[]) {
+	struct defrag_stats before, after;
+	unsigned int pwd;
+
+	initFS();
+	pwd = get_pwd_id();
+
+	printf("Defragmenting %s\n", DISK);
+	if (defrag_disk(DISK, &pwd, &before, &after, progress) != EXIT_SUCCESS) {
+		printf("\n! defrag failed, %s is left as it was\n", DISK);
+		return -1;
+	}
+
+	/* the inodes were numbered again, the shell follows */
+	update_path(pwd);
+
+	printf("\n\n%-16s %12s %12s\n", "", "before", "after");
+	print_stats("image bytes", before.size, after.size);
+	print_stats("inodes in use", before.inodes, after.inodes);
+	print_stats("blocs in use", before.blocs, after.blocs);
+	print_stats("inode high", before.inode_high, after.inode_high);
+	print_stats("bloc high", before.bloc_high, after.bloc_high);
+	print_stats("extents", before.extents, after.extents);
+
+	return 0;
+}
\ No newline at end of file
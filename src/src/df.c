@@ -3,18 +3,22 @@
 #include "../fs/fs.h"
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	unsigned int blocs, inodes;
 	size_t bytes;
 
 	initFS();
 	
-	disk_free(&blocs, &inodes, &bytes);
+	disk_free(&fs, &blocs, &inodes, &bytes);
 	printf("blocs available %lu\n", blocs);
 	printf("inodes available %lu\n", inodes);
 	printf("bytes available %lu\n", bytes);
 
 	printf("\n	See `diskimg` for a detailed look of the file system (related)\n");
 	
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
@@ -3,8 +3,12 @@
 #include "../fs/fs.h"
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
-	print_disk();
+	print_disk(&fs);
 	
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
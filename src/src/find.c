@@ -10,59 +10,47 @@ char * handleArgs(int argc, char const *argv[]) {
 	}
 }
 
-char * rec(struct inode * inode, char * name){
-	char * tmp = 0;
-	if ( inode->type == DIRECTORY ){
-
-		int *subid;
-		struct bloc b;
-		struct inode ** sub;
-		b = get_bloc_by_id(inode->bloc_ids[0]);
-		int sub_len = strsplt(b.content, &subid, ',');
-		sub = malloc(sizeof(struct inode *) * sub_len);
-
-		for (int i = 0; i < sub_len; i++) {
-			struct inode tmpinode = get_inode_by_id(subid[i]);
-			sub[i] = (struct inode *) malloc(sizeof(struct inode *));
-			memcpy(sub[i], &tmpinode, sizeof(struct inode));
-
-			char * tmp = rec(sub[i], name);
-
-			if (tmp){
-				char * ret = malloc(sizeof(char) * (strlen(get_filename_for_inode(inode))+ strlen(tmp))+1);
-				memcpy(ret, get_filename_for_inode(inode), strlen(get_filename_for_inode(inode)));
-				ret[strlen(get_filename_for_inode(inode))] = '/';
-				memcpy(ret+strlen(get_filename_for_inode(inode))+1, tmp, strlen(tmp));
-				free(tmp);
-
-				if (inode->id == ROOT_ID){
-					printf("%s\n", ret);
-					exit(0);
-				}
-				return ret;
-			}
-			else{
-				return 0;
-			}
-			
-		}
-	}
-	else{
-		if (strcmp( get_filename_for_inode(inode), name) == 0){
-			return get_filename_for_inode(inode);
+/*
+ * Prints the path of every file named name under dir
+ * The type hints of the entries tell the directories apart, the inodes
+ * of the other files are never read
+ */
+void rec(struct fs * fs, struct inode * dir, char * path, char * name){
+	struct dir_iter it;
+	struct inode sub;
+	char * subpath;
+
+	dir_iter_init(fs, &it, dir);
+	while (dir_iter_next(&it)) {
+		if (strcmp(it.name, ".") == 0 || strcmp(it.name, "..") == 0)
+			continue;
+
+		subpath = malloc(sizeof(char) * (strlen(path) + it.name_len + 2));
+		sprintf(subpath, "%s/%s", path, it.name);
+
+		if (strcmp(it.name, name) == 0)
+			printf("%s\n", subpath);
+
+		if (it.type == DIRECTORY) {
+			sub = get_inode_by_id(fs, it.id);
+			rec(fs, &sub, subpath, name);
 		}
+
+		free(subpath);
 	}
-	
-	return 0;
 }
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	char * name = handleArgs(argc, argv);
 
-	struct inode root = get_inode_by_id(ROOT_ID);
+	struct inode root = get_inode_by_id(&fs, ROOT_ID);
 
-	rec(&root, name);
+	rec(&fs, &root, "", name);
 
+	unmount_disk(&fs);
 	return 0;
 }
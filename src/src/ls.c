@@ -17,6 +17,9 @@ char * handleArgs(int argc, char const *argv[]) {
 }
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	char * path = NULL;
 
@@ -24,9 +27,9 @@ int main(int argc, char const *argv[]) {
 
 	int filecount;
 	char ** files;
-	struct inode wd = get_inode_by_id(get_pwd_id());
+	struct inode wd = get_inode_by_id(&fs, get_pwd_id());
 
-	files = list_files(&wd, &filecount);
+	files = list_files(&fs, &wd, &filecount);
 	for (int i = 0; i < filecount; i++){
 		printf("%s	", files[i]);
 		free(files[i]);
@@ -35,5 +38,6 @@ int main(int argc, char const *argv[]) {
 		printf("\n");
 	free(files);
 
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
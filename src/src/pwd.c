@@ -3,31 +3,22 @@
 #include "../fs/fs.h"
 
 int main(int argc, char const *argv[]) {
-	unsigned int cur_dir = get_pwd_id();
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
+	struct inode cur = get_inode_by_id(&fs, get_pwd_id());
+	char * path = inode_path(&fs, &cur);
 
-	struct inode cur = get_inode_by_id(cur_dir);
-	struct inode inodelist[100];
-	int count = 0, *subid;
-	struct bloc b;
-
-	inodelist[0] = cur;
-
-	while( inodelist[count].id != ROOT_ID ){
-		count++;
-		b = get_bloc_by_id(inodelist[count-1].bloc_ids[0]);
-		strsplt(b.content, &subid, ',');
-		
-		inodelist[count] = get_inode_by_id(subid[1]);
-		printf("%d : %d\n", count, inodelist[count].id);	
+	if (path == NULL) {
+		printf("pwd : the working directory is not linked to /\n");
+		unmount_disk(&fs);
+		return -1;
 	}
 
-	for (int i = count; i > -1; i--){
-		printf("%s", get_dirname_by_id(inodelist[i].id));
-	}
-	
-	
-	printf("\n");
+	printf("%s\n", path);
+	free(path);
 
+	unmount_disk(&fs);
 	return 0;
 }
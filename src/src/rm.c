@@ -12,6 +12,9 @@ char ** handleArgs(int argc, char const *argv[]) {
 }
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	initFS();
 
@@ -20,15 +23,19 @@ int main(int argc, char const *argv[]) {
 
 	printf("Removing files :\n");
 
-	struct inode cur_dir = get_inode_by_id(get_pwd_id());
+	struct inode cur_dir = get_inode_by_id(&fs, get_pwd_id());
+	char name[FILENAME_COUNT];
 
 	for (int i = 0; i < argc-1; i++) {
 		printf("%s	", files_list[i]);
 
-		remove_file(&cur_dir, files_list[i], REGULAR_FILE);
+		struct inode dir = resolve_parent(&fs, &cur_dir, files_list[i], name);
+		if (dir.id != DELETED)
+			remove_file(&fs, &dir, name, REGULAR_FILE);
 	}
 
 	printf("\n");
 
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
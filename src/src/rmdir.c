@@ -13,6 +13,9 @@ char ** handleArgs(int argc, char const *argv[]) {
 
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	initFS();
 
@@ -21,15 +24,16 @@ int main(int argc, char const *argv[]) {
 
 	printf("Removing directories :\n");
 
-	struct inode cur_dir = get_inode_by_id(get_pwd_id());
+	struct inode cur_dir = get_inode_by_id(&fs, get_pwd_id());
 
 	for (int i = 0; i < argc-1; i++) {
 		printf("%s	", files_list[i]);
 
-		remove_empty_directory(&cur_dir, files_list[i]);
+		remove_empty_directory(&fs, &cur_dir, files_list[i]);
 	}
 
 	printf("\n");
 
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file
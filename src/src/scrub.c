@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../fs/fs.h"
+
+static void report(unsigned int id) {
+	printf("! bloc %u is corrupted\n", id);
+}
+
+/*
+ * scrub : checks every bloc of the disk against its checksum
+ * scrub -j N : with N threads (one a processor by default)
+ */
+int main(int argc, char const *argv[]) {
+	struct fs fs;
+	struct scrub_stats stats;
+	unsigned int threads = 0;
+
+	if (argc == 3 && strcmp(argv[1], "-j") == 0)
+		threads = (unsigned int) atoi(argv[2]);
+	else if (argc != 1) {
+		printf("usage: scrub [-j threads]\n");
+		return -1;
+	}
+
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
+
+	initFS();
+
+	printf("Scrubbing %s (%s)\n", DISK, crc32c_kernel());
+	if (scrub_disk(&fs, threads, &stats, report) != EXIT_SUCCESS) {
+		printf("! scrub failed\n");
+		unmount_disk(&fs);
+		return -1;
+	}
+
+	printf("%u blocs checked by %u threads, %u without checksum, %u corrupted\n",
+			stats.checked, stats.threads, stats.unsealed, stats.corrupted);
+
+	unmount_disk(&fs);
+	return stats.corrupted == 0 ? 0 : -1;
+}
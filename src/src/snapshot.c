@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../fs/fs.h"
+
+/*
+ * snapshot : lists the snapshots
+ * snapshot NAME : takes a snapshot
+ * snapshot -r NAME : rolls back to a snapshot
+ * snapshot -d NAME : drops a snapshot
+ */
+int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
+
+	int rst = EXIT_SUCCESS;
+
+	initFS();
+
+	if (argc == 1) {
+		for (size_t i = 0; i < fs.snapshots.count; i++) {
+			struct snapshot *s = &fs.snapshots.list[i];
+			char date[32];
+
+			strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&s->head.created));
+			printf("%s	%s	%lu records copied\n", s->head.name, date, (unsigned long) s->exceptions.count);
+		}
+	}
+	else if (argc == 3 && strcmp(argv[1], "-r") == 0) {
+		rst = snapshot_rollback(&fs, argv[2]);
+		if (rst == EXIT_SUCCESS)
+			printf("Rolled back to %s\n", argv[2]);
+	}
+	else if (argc == 3 && strcmp(argv[1], "-d") == 0) {
+		rst = snapshot_drop(&fs, argv[2]);
+		if (rst == EXIT_SUCCESS)
+			printf("Dropped %s\n", argv[2]);
+	}
+	else if (argc == 2) {
+		rst = snapshot_take(&fs, argv[1]);
+		if (rst == EXIT_SUCCESS)
+			printf("Took %s\n", argv[1]);
+	}
+	else {
+		printf("! usage: snapshot [[-r|-d] name]\n");
+		rst = EXIT_FAILURE;
+	}
+
+	unmount_disk(&fs);
+	return rst == EXIT_SUCCESS ? 0 : -1;
+}
\ No newline at end of file
@@ -14,6 +14,9 @@ char ** handleArgs(int argc, char const *argv[]) {
 }
 
 int main(int argc, char const *argv[]) {
+	struct fs fs;
+	if (mount_disk(&fs, DISK) != EXIT_SUCCESS)
+		return -1;
 
 	initFS();
 
@@ -21,12 +24,13 @@ int main(int argc, char const *argv[]) {
 	arg = handleArgs(argc, argv);
 
 	struct file f;
-	struct inode cur_dir = get_inode_by_id(get_pwd_id());
+	struct inode cur_dir = get_inode_by_id(&fs, get_pwd_id());
 
 	printf("Writing \"%s\" in %s\n", arg[0], arg[1]);
 
-	f = iopen(&cur_dir, arg[1], O_WRONLY);
-	iwrite(&f, arg[0], strlen(arg[0])+1);
+	f = iopen(&fs, &cur_dir, arg[1], O_WRONLY | O_TRUNC);
+	iwrite(&fs, &f, arg[0], strlen(arg[0]));
 
+	unmount_disk(&fs);
 	return 0;
 }
\ No newline at end of file